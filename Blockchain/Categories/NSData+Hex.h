@@ -7,4 +7,7 @@
 /// Returns the hexadecimal representation of this NSData. Empty string if data is empty.
 - (NSString *)hexadecimalString;
 
+/// Returns the bytes written in hexadecimal (of either case) by hexString. Nil if it has an odd length or any other characters.
++ (NSData *)dataWithHexadecimalString:(NSString *)hexString;
+
 @end
@@ -1,22 +1,53 @@
 // Copyright © Blockchain Luxembourg S.A. All rights reserved.
 
 #import "NSData+Hex.h"
+#import "hexify.h"
 
 @implementation NSData (Hex)
 
 - (NSString *)hexadecimalString {
-    const unsigned char *dataBuffer = (const unsigned char *)[self bytes];
+    const uint8_t *dataBuffer = (const uint8_t *)[self bytes];
+    NSUInteger dataLength = self.length;
 
-    if (!dataBuffer) {
+    if (!dataBuffer || dataLength == 0) {
         return [NSString string];
     }
-    NSUInteger dataLength = self.length;
-    NSMutableString *hexString = [NSMutableString stringWithCapacity:(dataLength * 2)];
+    if (dataLength > (NSUIntegerMax - 1) / 2) {
+        return nil;
+    }
+
+    // Encode straight into the string's storage, which it frees when done.
+    char *hexBuffer = malloc(dataLength * 2 + 1);
+    if (!hexBuffer) {
+        return nil;
+    }
+    hexify(dataBuffer, hexBuffer, dataLength);
+    return [[NSString alloc] initWithBytesNoCopy:hexBuffer length:(dataLength * 2) encoding:NSASCIIStringEncoding freeWhenDone:YES];
+}
 
-    for (int i = 0; i < dataLength; ++i) {
-        [hexString appendString:[NSString stringWithFormat:@"%02x", (unsigned int)dataBuffer[i]]];
++ (NSData *)dataWithHexadecimalString:(NSString *)hexString {
+    const char *hexChars = [hexString UTF8String];
+
+    if (!hexChars) {
+        return nil;
+    }
+    size_t hexLength = strlen(hexChars);
+    if (hexLength % 2 != 0) {
+        return nil;
+    }
+    if (hexLength == 0) {
+        return [NSData data];
+    }
+
+    uint8_t *dataBuffer = malloc(hexLength / 2);
+    if (!dataBuffer) {
+        return nil;
+    }
+    if (unhexify(hexChars, dataBuffer, hexLength / 2)) {
+        free(dataBuffer);
+        return nil;
     }
-    return [NSString stringWithString:hexString];
+    return [NSData dataWithBytesNoCopy:dataBuffer length:(hexLength / 2) freeWhenDone:YES];
 }
 
 @end
@@ -97,28 +97,39 @@ MyWallet.decryptAndInitializeWallet = function (success, error, decryptSuccess)
     };
 };
 
+// MARK: - Typed array helpers
+
+// The Obj-C key derivation bridges read the bytes of typed arrays in place; a Buffer already is one
+function toUint8Array (bytes) {
+    return bytes instanceof Uint8Array ? bytes : new Uint8Array(bytes);
+}
+
+// Wraps a Uint8Array returned by an Obj-C bridge without copying it
+function fromUint8Array (bytes) {
+    return Buffer.from(bytes.buffer, bytes.byteOffset, bytes.length);
+}
+
 // MARK: - WalletCrypto overrides
 
 WalletCrypto.scrypt = function(passwd, salt, N, r, p, dkLen, callback) {
     if (typeof(passwd) !== 'string') {
-        passwd = passwd.toJSON().data;
+        passwd = toUint8Array(passwd);
     }
 
     if (typeof(salt) !== 'string') {
-        salt = salt.toJSON().data;
+        salt = toUint8Array(salt);
     }
 
-    objc_crypto_scrypt_salt_n_r_p_dkLen(passwd, salt, N, r, p, dkLen, function(buffer) {
-      var bytes = new Buffer(buffer, 'hex');
-      callback(bytes);
+    objc_crypto_scrypt_salt_n_r_p_dkLen(passwd, salt, N, r, p, dkLen, function(bytes) {
+      callback(fromUint8Array(bytes));
     }, function(e) {
       error(''+e);
     });
 };
 
 WalletCrypto.stretchPassword = function (password, salt, iterations, keylen) {
-    var retVal = objc_sjcl_misc_pbkdf2(password, salt.toJSON().data, iterations, (keylen || 256) / 8);
-    return new Buffer(retVal, 'hex');
+    var retVal = objc_sjcl_misc_pbkdf2(password, toUint8Array(salt), iterations, (keylen || 256) / 8);
+    return fromUint8Array(retVal);
 }
 
 // MARK: - BIP39 overrides
@@ -127,7 +138,7 @@ BIP39.mnemonicToSeed = function(mnemonic, enteredPassword) {
     var mnemonicBuffer = new Buffer(mnemonic, 'utf8')
     var saltBuffer = new Buffer(BIP39.salt(enteredPassword), 'utf8');
     var retVal = objc_pbkdf2_sync(mnemonicBuffer, saltBuffer, 2048, 64);
-    return new Buffer(retVal, 'hex');
+    return fromUint8Array(retVal);
 }
 
 BIP39.mnemonicToSeedHex = function(mnemonic, enteredPassword) {
@@ -100,6 +100,8 @@
 
 - (BOOL)needsSecondPassword;
 - (BOOL)validateSecondPassword:(NSString *)secondPassword;
+// Stops any scrypt derivation started from JS, e.g. when the user backs out of the second password prompt
+- (void)cancelScrypt;
 
 - (void)getHistory;
 - (void)getHistoryForAllAssets;
@@ -12,24 +12,61 @@
 #import "BTCAddress.h"
 #import "BTCData.h"
 #import "BTCKey.h"
+#import "crypto_keycache.h"
 #import "crypto_scrypt.h"
+#import "crypto_scrypt_sched.h"
+#import "insecure_memzero.h"
 #import "KeychainItemWrapper+Credentials.h"
 #import "ModuleXMLHttpRequest.h"
 #import "NSArray+EncodedJSONString.h"
 #import "NSData+Hex.h"
 #import "NSNumberFormatter+Currencies.h"
 #import "NSString+JSONParser_NSString.h"
+#import "sha1.h"
+#import "sha512.h"
 
 #define DICTIONARY_KEY_CURRENCY @"currency"
 
+// Upper bound on the scratch memory used by all scrypt derivations in progress
+#define SCRYPT_MAX_MEMORY (128 * 1024 * 1024)
+// Number of scrypt derivations which may run at once, memory permitting
+#define SCRYPT_MAX_JOBS 2
+// Seconds for which a derived key is remembered, so that repeated second password prompts don't derive it again
+#define DERIVED_KEY_CACHE_TTL (5 * 60)
+// Number of derived keys remembered at once
+#define DERIVED_KEY_CACHE_ENTRIES 8
+
 NSString * const kAccountInvitations = @"invited";
 
+// State handed to scrypt_progress() by _internal_crypto_scrypt
+struct scrypt_progress_cookie {
+    __unsafe_unretained Wallet *wallet;
+    NSUInteger generation;
+    int percent;
+};
+
+static int scrypt_progress(void *cookie, uint64_t done, uint64_t total);
+static struct crypto_scrypt_sched *scrypt_scheduler(void);
+static void scrypt_run(void *cookie, size_t maxmem);
+static struct crypto_keycache *derived_key_cache(void);
+static void derived_key_cache_put(uint64_t epoch, const uint8_t *cacheID, const uint8_t *key, size_t length);
+static BOOL js_bytes(JSValue *value, const uint8_t **bytes, size_t *length);
+static JSValue *js_uint8_array(JSContext *context, uint8_t *bytes, size_t length);
+
 @interface Wallet ()
 
 @property (nonatomic, strong) JSContext *context;
 @property (nonatomic, assign) BOOL isSettingDefaultAccount;
 @property (nonatomic, strong) NSMutableDictionary *timers;
 @property (nonatomic, copy) NSDictionary *bitcoinCashExchangeRates;
+// Bumped by cancelScrypt and suspendScrypt; derivations started under an older value stop early
+@property (atomic, assign) NSUInteger scryptGeneration;
+// The generation suspendScrypt last moved on to; derivations it stopped keep their checkpoints
+@property (atomic, assign) NSUInteger scryptSuspendedGeneration;
+// State of the last resumable scrypt derivation which was stopped part way through, from
+// crypto_scrypt_checkpoint_alloc so that it is locked and zeroed like the cached keys; NULL if there is none
+@property (nonatomic, assign) uint8_t *scryptCheckpoint;
+@property (nonatomic, assign) size_t scryptCheckpointLength;
 
 @end
 
@@ -49,6 +86,11 @@ NSString * const kAccountInvitations = @"invited";
     return self;
 }
 
+- (void)dealloc
+{
+    crypto_scrypt_checkpoint_free(_scryptCheckpoint, _scryptCheckpointLength);
+}
+
 - (NSString *)getJSSource
 {
     NSString *walletJSPath = [[NSBundle mainBundle] pathForResource:JAVASCRIPTCORE_RESOURCE_MY_WALLET ofType:JAVASCRIPTCORE_TYPE_JS];
@@ -179,6 +221,9 @@ NSString * const kAccountInvitations = @"invited";
 }
 
 - (void)loadJS {
+    // Derivations for the old context can't deliver their results; checkpoint them so the new one can resume
+    [self suspendScrypt];
+
     self.context = [[JSContext alloc] init];
 
     [self.context evaluateScriptCheckIsOnMainQueue:[self getConsoleScript]];
@@ -210,47 +255,64 @@ NSString * const kAccountInvitations = @"invited";
     };
 
     self.context[@"objc_message_verify"] = ^(NSString *address, NSString *signature, NSString *message) {
-        NSData *signatureData = BTCDataFromHex(signature);
+        NSData *signatureData = [NSData dataWithHexadecimalString:signature];
         NSData *messageData = [message dataUsingEncoding:NSUTF8StringEncoding];
         BTCKey *key = [BTCKey verifySignature:signatureData forBinaryMessage:messageData];
         return [key.address.string isEqualToString:address];
     };
     
-    self.context[@"objc_pbkdf2_sync"] = ^(NSString *mnemonicBuffer, NSString *saltBuffer, int iterations, int keylength) {
-        return [JSCrypto derivePBKDF2SHA512HexStringWithPassword:mnemonicBuffer
-                                                            salt:saltBuffer
-                                                      iterations:iterations
-                                                    keySizeBytes:keylength];
+    self.context[@"objc_pbkdf2_sync"] = ^JSValue *(JSValue *mnemonicBuffer, JSValue *saltBuffer, int iterations, int keylength) {
+        const uint8_t *passwordBytes, *saltBytes;
+        size_t passwordLength, saltLength;
+        if (iterations < 1 || keylength < 1 || !js_bytes(mnemonicBuffer, &passwordBytes, &passwordLength) || !js_bytes(saltBuffer, &saltBytes, &saltLength)) {
+            return nil;
+        }
+        uint8_t *seed = malloc(keylength);
+        if (!seed) {
+            return nil;
+        }
+        PBKDF2_SHA512(passwordBytes, passwordLength, saltBytes, saltLength, iterations, seed, keylength);
+        return js_uint8_array([JSContext currentContext], seed, keylength);
     };
 
-    self.context[@"objc_sjcl_misc_pbkdf2"] = ^(NSString *_password, id _salt, int iterations, int keylength) {
-        uint8_t * _saltBuff = NULL;
-        size_t _saltBuffLen = 0;
-
-        if ([_salt isKindOfClass:[NSArray class]]) {
-            _saltBuff = alloca([_salt count]);
-            _saltBuffLen = [_salt count];
+    self.context[@"objc_sjcl_misc_pbkdf2"] = ^JSValue *(JSValue *_password, JSValue *_salt, int iterations, int keylength) {
+        const uint8_t *passwordBytes, *saltBytes;
+        size_t passwordLength, saltLength;
+        if (iterations < 1 || keylength < 1) {
+            return nil;
+        }
+        if (!js_bytes(_password, &passwordBytes, &passwordLength) || !js_bytes(_salt, &saltBytes, &saltLength)) {
+            DLog(@"PBKDF2 password or salt unsupported type");
+            return nil;
+        }
+        uint8_t *key = malloc(keylength);
+        if (!key) {
+            return nil;
+        }
 
-            {
-                int ii = 0;
-                for (NSNumber * number in _salt) {
-                    _saltBuff[ii] = [number unsignedCharValue];
-                    ++ii;
-                }
+        // Each second password prompt stretches the same password with the same salt again
+        struct crypto_keycache *cache = derived_key_cache();
+        uint64_t params[] = { (uint64_t)iterations, (uint64_t)keylength };
+        uint8_t cacheID[32];
+        uint64_t epoch = 0;
+        if (cache) {
+            crypto_keycache_id(cache, "pbkdf2-sha1", params, 2, passwordBytes, passwordLength, saltBytes, saltLength, cacheID);
+            epoch = crypto_keycache_epoch(cache);
+        }
+        NSUInteger generation = weakSelf.scryptGeneration;
+        if (!cache || crypto_keycache_get(cache, cacheID, key, keylength) == -1) {
+            PBKDF2_SHA1(passwordBytes, passwordLength, saltBytes, saltLength, iterations, key, keylength);
+            // A cancel or logout while this ran means the key is no longer wanted
+            if (weakSelf.scryptGeneration != generation) {
+                insecure_memzero(key, keylength);
+                free(key);
+                return nil;
+            }
+            if (cache) {
+                derived_key_cache_put(epoch, cacheID, key, keylength);
             }
-        } else if ([_salt isKindOfClass:[NSString class]]) {
-            _saltBuff = (uint8_t*)[_salt UTF8String];
-            _saltBuffLen = [_salt length];
-        } else {
-            DLog(@"Scrypt salt unsupported type");
-            return [[NSData new] hexadecimalString];
         }
-        
-        NSData * _Nonnull saltData = [NSData dataWithBytes:_saltBuff length:_saltBuffLen];
-        return [JSCrypto derivePBKDF2SHA1HexStringWithPassword:_password
-                                                      saltData:saltData
-                                                    iterations:iterations
-                                                  keySizeBytes:keylength];
+        return js_uint8_array([JSContext currentContext], key, keylength);
     };
 
     self.context[@"objc_on_error_creating_new_account"] = ^(NSString *error) {
@@ -348,8 +410,18 @@ NSString * const kAccountInvitations = @"invited";
         return [data hexadecimalString];
     };
 
-    self.context[@"objc_crypto_scrypt_salt_n_r_p_dkLen"] = ^(id _password, id salt, NSNumber *N, NSNumber *r, NSNumber *p, NSNumber *derivedKeyLen, JSValue *success, JSValue *error) {
-        [weakSelf crypto_scrypt:_password salt:salt n:N r:r p:p dkLen:derivedKeyLen success:success error:error];
+    self.context[@"objc_crypto_scrypt_salt_n_r_p_dkLen"] = ^(JSValue *_password, JSValue *salt, NSNumber *N, NSNumber *r, NSNumber *p, NSNumber *derivedKeyLen, JSValue *success, JSValue *error) {
+        const uint8_t *passwordBytes, *saltBytes;
+        size_t passwordLength, saltLength;
+        if (!js_bytes(_password, &passwordBytes, &passwordLength) || !js_bytes(salt, &saltBytes, &saltLength)) {
+            DLog(@"Scrypt password or salt unsupported type");
+            [error callWithArguments:@[@"Scrypt Error"]];
+            return;
+        }
+        // The derivation runs on the scheduler's threads, which must not touch JS memory, so copy the inputs once here
+        NSMutableData *passwordData = [NSMutableData dataWithBytes:passwordBytes length:passwordLength];
+        NSData *saltData = [NSData dataWithBytes:saltBytes length:saltLength];
+        [weakSelf crypto_scrypt:passwordData salt:saltData n:N r:r p:p dkLen:derivedKeyLen success:success error:error];
     };
 
     self.context[@"objc_loading_start_new_account"] = ^() {
@@ -1621,84 +1693,319 @@ NSString * const kAccountInvitations = @"invited";
 - (void)logging_out
 {
     DLog(@"logging_out");
+
+    [self cancelScrypt];
+
+    struct crypto_keycache *cache = derived_key_cache();
+    if (cache) {
+        crypto_keycache_flush(cache);
+    }
 }
 
 # pragma mark - Cyrpto helpers, called from JS
 
-- (void)crypto_scrypt:(id)_password salt:(id)salt n:(NSNumber*)N r:(NSNumber*)r p:(NSNumber*)p dkLen:(NSNumber*)derivedKeyLen success:(JSValue *)_success error:(JSValue *)_error
+- (void)cancelScrypt
+{
+    // Nobody wants this derivation any more, so nothing it has done so far is worth keeping
+    @synchronized (self) {
+        self.scryptGeneration++;
+        [self keepScryptCheckpoint:NULL length:0];
+    }
+}
+
+- (void)suspendScrypt
+{
+    @synchronized (self) {
+        self.scryptSuspendedGeneration = ++self.scryptGeneration;
+    }
+}
+
+// Hands over the kept checkpoint if it has the right size, or else a fresh one; NULL if none can be allocated
+- (uint8_t *)takeScryptCheckpointWithN:(uint64_t)N r:(uint32_t)r p:(uint32_t)p
 {
+    @synchronized (self) {
+        uint8_t *checkpoint = self.scryptCheckpoint;
+        size_t length = self.scryptCheckpointLength;
+        self.scryptCheckpoint = NULL;
+        self.scryptCheckpointLength = 0;
+        if (checkpoint && length == crypto_scrypt_checkpoint_size(N, r, p)) {
+            return checkpoint;
+        }
+        crypto_scrypt_checkpoint_free(checkpoint, length);
+    }
+    return crypto_scrypt_checkpoint_alloc(N, r, p);
+}
+
+// Takes ownership of the checkpoint, zeroing and freeing the one it replaces
+- (void)keepScryptCheckpoint:(uint8_t *)checkpoint length:(size_t)length
+{
+    @synchronized (self) {
+        crypto_scrypt_checkpoint_free(self.scryptCheckpoint, self.scryptCheckpointLength);
+        self.scryptCheckpoint = checkpoint;
+        self.scryptCheckpointLength = length;
+    }
+}
+
+- (void)scryptStopped:(uint8_t *)checkpoint length:(size_t)length generation:(NSUInteger)generation
+{
+    @synchronized (self) {
+        // Only a derivation stopped by the latest suspend, with nothing cancelled since, is worth resuming
+        if (self.scryptSuspendedGeneration == generation + 1 && self.scryptGeneration == generation + 1) {
+            DLog(@"Scrypt suspended");
+            [self keepScryptCheckpoint:checkpoint length:length];
+            return;
+        }
+    }
+    DLog(@"Scrypt cancelled");
+    crypto_scrypt_checkpoint_free(checkpoint, length);
+}
+
+- (void)crypto_scrypt:(NSMutableData *)_password salt:(NSData *)salt n:(NSNumber*)N r:(NSNumber*)r p:(NSNumber*)p dkLen:(NSNumber*)derivedKeyLen success:(JSValue *)_success error:(JSValue *)_error
+{
+    // Decrypting the same private key again derives the same key, so there may be no need to wait for scrypt
+    struct crypto_keycache *cache = derived_key_cache();
+    uint64_t params[] = { [N unsignedLongLongValue], [r unsignedIntValue], [p unsignedIntValue], [derivedKeyLen unsignedIntValue] };
+    NSMutableData *cacheID = [NSMutableData dataWithLength:32];
+    if (cache) {
+        crypto_keycache_id(cache, "scrypt", params, 4, _password.bytes, _password.length, salt.bytes, salt.length, cacheID.mutableBytes);
+        size_t keyLength = [derivedKeyLen unsignedIntValue];
+        uint8_t *keyBytes = malloc(keyLength);
+        if (keyBytes && crypto_keycache_get(cache, cacheID.bytes, keyBytes, keyLength) == 0) {
+            [_password resetBytesInRange:NSMakeRange(0, _password.length)];
+            JSValue *key = js_uint8_array(_success.context, keyBytes, keyLength);
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (key) {
+                    [_success callWithArguments:@[key]];
+                } else {
+                    [_error callWithArguments:@[@"Scrypt Error"]];
+                }
+            });
+            return;
+        }
+        free(keyBytes);
+    }
+
     dispatch_async(dispatch_get_main_queue(), ^{
         [LoadingViewPresenter.shared showWith:BC_STRING_DECRYPTING_PRIVATE_KEY];
     });
 
-    dispatch_async(dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        NSData * data = [self _internal_crypto_scrypt:_password salt:salt n:[N unsignedLongLongValue] r:[r unsignedIntValue] p:[p unsignedIntValue] dkLen:[derivedKeyLen unsignedIntValue]];
+    NSUInteger generation = self.scryptGeneration;
+    uint64_t epoch = cache ? crypto_keycache_epoch(cache) : 0;
+    void (^job)(size_t) = ^(size_t maxmem) {
+#ifdef DEBUG
+        struct crypto_scrypt_sched_stats stats;
+        crypto_scrypt_sched_stats(scrypt_scheduler(), &stats);
+        DLog(@"Scrypt admitted with %zu bytes: %zu running (%zu bytes, peak %zu), %zu interactive and %zu background queued, interactive wait %.1f ms mean / %.1f ms max",
+             maxmem, stats.running, stats.inuse, stats.inuse_peak, stats.queued[CRYPTO_SCRYPT_PRIO_INTERACTIVE], stats.queued[CRYPTO_SCRYPT_PRIO_BACKGROUND],
+             stats.wait_ns[CRYPTO_SCRYPT_PRIO_INTERACTIVE] / 1e6 / stats.started[CRYPTO_SCRYPT_PRIO_INTERACTIVE], stats.wait_max_ns[CRYPTO_SCRYPT_PRIO_INTERACTIVE] / 1e6);
+#endif
+        NSData * data = [self _internal_crypto_scrypt:_password salt:salt n:[N unsignedLongLongValue] r:[r unsignedIntValue] p:[p unsignedIntValue] dkLen:[derivedKeyLen unsignedIntValue] maxmem:maxmem generation:generation];
+        [_password resetBytesInRange:NSMakeRange(0, _password.length)];
+        // A derivation which finishes after a cancel or logout has nobody to give its key to; the epoch keeps
+        // the key out of the cache even if the logout comes between this check and the put
+        if (data && cache && self.scryptGeneration == generation) {
+            derived_key_cache_put(epoch, cacheID.bytes, data.bytes, data.length);
+        }
 
         dispatch_async(dispatch_get_main_queue(), ^{
-            if (data) {
-                [_success callWithArguments:@[[data hexadecimalString]]];
+            uint8_t *keyBytes = (data && self.scryptGeneration == generation) ? malloc(data.length) : NULL;
+            JSValue *key = nil;
+            if (keyBytes) {
+                memcpy(keyBytes, data.bytes, data.length);
+                key = js_uint8_array(_success.context, keyBytes, data.length);
+            }
+            if (key) {
+                [_success callWithArguments:@[key]];
             } else {
                 [LoadingViewPresenter.shared hide];
                 [_error callWithArguments:@[@"Scrypt Error"]];
             }
         });
-    });
+    };
+
+    // Someone is watching the loading view, so this goes ahead of any background derivations
+    uint32_t threads = (uint32_t)[[NSProcessInfo processInfo] activeProcessorCount];
+    size_t need = crypto_scrypt_sched_need([N unsignedLongLongValue], [r unsignedIntValue], [p unsignedIntValue], threads);
+    if ([p unsignedIntValue] == 1) {
+        // The checkpoint is locked into memory alongside V
+        need += crypto_scrypt_checkpoint_size([N unsignedLongLongValue], [r unsignedIntValue], 1);
+    }
+    struct crypto_scrypt_sched *scheduler = scrypt_scheduler();
+    void *cookie = (__bridge_retained void *)job;
+    if (scheduler == NULL || crypto_scrypt_sched_submit(scheduler, need, CRYPTO_SCRYPT_PRIO_INTERACTIVE, scrypt_run, cookie) == -1) {
+        CFBridgingRelease(cookie);
+        [_password resetBytesInRange:NSMakeRange(0, _password.length)];
+        [LoadingViewPresenter.shared hide];
+        [_error callWithArguments:@[@"Scrypt Error"]];
+    }
 }
 
-- (NSData*)_internal_crypto_scrypt:(id)_password salt:(id)_salt n:(uint64_t)N r:(uint32_t)r p:(uint32_t)p dkLen:(uint32_t)derivedKeyLen
+- (NSData*)_internal_crypto_scrypt:(NSData *)_password salt:(NSData *)_salt n:(uint64_t)N r:(uint32_t)r p:(uint32_t)p dkLen:(uint32_t)derivedKeyLen maxmem:(size_t)maxmem generation:(NSUInteger)generation
 {
-    uint8_t * _passwordBuff = NULL;
-    size_t _passwordBuffLen = 0;
-    if ([_password isKindOfClass:[NSArray class]]) {
-        _passwordBuff = alloca([_password count]);
-        _passwordBuffLen = [_password count];
+    const uint8_t * _passwordBuff = _password.bytes;
+    size_t _passwordBuffLen = _password.length;
+    const uint8_t * _saltBuff = _salt.bytes;
+    size_t _saltBuffLen = _salt.length;
 
-        {
-            int ii = 0;
-            for (NSNumber * number in _password) {
-                _passwordBuff[ii] = [number shortValue];
-                ++ii;
-            }
+    uint8_t * derivedBytes = malloc(derivedKeyLen);
+
+    uint32_t threads = (uint32_t)[[NSProcessInfo processInfo] activeProcessorCount];
+    struct scrypt_progress_cookie progress = { self, generation, -1 };
+
+    if (p == 1) {
+        // A single SMix instance can't be spread over threads, so nothing is lost by running it resumably:
+        // if it is suspended part way through, the work done so far is kept for the next attempt.  Without a
+        // checkpoint it can still run, but only from the start
+        size_t checkpointLength = crypto_scrypt_checkpoint_size(N, r, p);
+        uint8_t *checkpoint = [self takeScryptCheckpointWithN:N r:r p:p];
+        int rc = crypto_scrypt_resumable((uint8_t*)_passwordBuff, _passwordBuffLen, (uint8_t*)_saltBuff, _saltBuffLen, N, r, p, derivedBytes, derivedKeyLen, checkpoint, checkpoint ? checkpointLength : 0, scrypt_progress, &progress);
+        if (rc == -1 && errno == EAGAIN) {
+            [self scryptStopped:checkpoint length:checkpointLength generation:generation];
+        } else {
+            crypto_scrypt_checkpoint_free(checkpoint, checkpointLength);
         }
-    } else if ([_password isKindOfClass:[NSString class]]) {
-        const char *passwordUTF8String = [_password UTF8String];
-        _passwordBuff = (uint8_t*)passwordUTF8String;
-        _passwordBuffLen = strlen(passwordUTF8String);
-    } else {
-        DLog(@"Scrypt password unsupported type");
+        if (rc == -1) {
+            free(derivedBytes);
+            return nil;
+        }
+        return [NSData dataWithBytesNoCopy:derivedBytes length:derivedKeyLen];
+    }
+
+    struct crypto_scrypt_stats *statsp = NULL;
+#ifdef DEBUG
+    // Break the time down by phase so it can be read alongside the loading_start_* events
+    struct crypto_scrypt_stats stats;
+    statsp = &stats;
+#endif
+    if (crypto_scrypt_progress((uint8_t*)_passwordBuff, _passwordBuffLen, (uint8_t*)_saltBuff, _saltBuffLen, N, r, p, derivedBytes, derivedKeyLen, threads, maxmem, statsp, scrypt_progress, &progress) == -1) {
+        if (errno == ECANCELED) {
+            DLog(@"Scrypt cancelled");
+        }
+        free(derivedBytes);
         return nil;
     }
+#ifdef DEBUG
+    DLog(@"Scrypt N=%llu r=%u p=%u: %.1f ms total (alloc %.1f, pbkdf2 %.1f + %.1f, smix fill %.1f, smix mix %.1f, free %.1f; smix summed over %u threads), %zu bytes, V backing %d, %llu page faults",
+         N, r, p, stats.total_ns / 1e6, stats.alloc_ns / 1e6, stats.pbkdf2_in_ns / 1e6, stats.pbkdf2_out_ns / 1e6, stats.smix1_ns / 1e6, stats.smix2_ns / 1e6, stats.free_ns / 1e6, stats.nthreads, stats.mem, stats.vbacking, stats.faults);
+#endif
 
-    uint8_t * _saltBuff = NULL;
-    size_t _saltBuffLen = 0;
+    return [NSData dataWithBytesNoCopy:derivedBytes length:derivedKeyLen];
+}
 
-    if ([_salt isKindOfClass:[NSArray class]]) {
-        _saltBuff = alloca([_salt count]);
-        _saltBuffLen = [_salt count];
+// Shared by all wallets so that SCRYPT_MAX_MEMORY holds across them
+static struct crypto_scrypt_sched *scrypt_scheduler(void)
+{
+    static struct crypto_scrypt_sched *scheduler;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        scheduler = crypto_scrypt_sched_init(SCRYPT_MAX_MEMORY, SCRYPT_MAX_JOBS);
+    });
+    return scheduler;
+}
 
-        {
-            int ii = 0;
-            for (NSNumber * number in _salt) {
-                _saltBuff[ii] = [number shortValue];
-                ++ii;
-            }
-        }
-    } else if ([_salt isKindOfClass:[NSString class]]) {
-        const char *saltUTF8String = [_salt UTF8String];
-        _saltBuff = (uint8_t*)saltUTF8String;
-        _saltBuffLen = strlen(saltUTF8String);
-    } else {
-        DLog(@"Scrypt salt unsupported type");
-        return nil;
+// Shared by all wallets like the scheduler, and emptied whenever one logs out; NULL if its memory can't be locked
+static struct crypto_keycache *derived_key_cache(void)
+{
+    static struct crypto_keycache *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = crypto_keycache_init(DERIVED_KEY_CACHE_ENTRIES, DERIVED_KEY_CACHE_TTL);
+    });
+    return cache;
+}
+
+// Remembers a key derived since the cache's epoch was read, and makes sure it is wiped once DERIVED_KEY_CACHE_TTL is
+// up even if the cache isn't used again
+static void derived_key_cache_put(uint64_t epoch, const uint8_t *cacheID, const uint8_t *key, size_t length)
+{
+    struct crypto_keycache *cache = derived_key_cache();
+
+    crypto_keycache_put(cache, epoch, cacheID, key, length);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)((DERIVED_KEY_CACHE_TTL + 1) * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        crypto_keycache_expire(cache);
+    });
+}
+
+// Called by the scheduler's threads once a job from crypto_scrypt: has been given its memory
+static void scrypt_run(void *cookie, size_t maxmem)
+{
+    @autoreleasepool {
+        void (^job)(size_t) = (__bridge_transfer void (^)(size_t))cookie;
+        job(maxmem);
     }
+}
 
-    uint8_t * derivedBytes = malloc(derivedKeyLen);
+// Called by crypto_scrypt_progress/crypto_scrypt_resumable from the scrypt worker threads, one at a time
+static int scrypt_progress(void *cookie, uint64_t done, uint64_t total)
+{
+    struct scrypt_progress_cookie *progress = cookie;
 
-    if (crypto_scrypt((uint8_t*)_passwordBuff, _passwordBuffLen, (uint8_t*)_saltBuff, _saltBuffLen, N, r, p, derivedBytes, derivedKeyLen) == -1) {
-        return nil;
+    if (progress->wallet.scryptGeneration != progress->generation) {
+        return 1;
     }
 
-    return [NSData dataWithBytesNoCopy:derivedBytes length:derivedKeyLen];
+    int percent = (int)(done * 100 / total);
+    if (percent != progress->percent) {
+        progress->percent = percent;
+        [LoadingViewPresenter.shared showWith:[NSString stringWithFormat:@"%@ %d%%", BC_STRING_DECRYPTING_PRIVATE_KEY, percent]];
+    }
+
+    return 0;
+}
+
+// Points *bytes at the contents of a typed array, or at the UTF-8 encoding of a string, without copying either.
+// They are only valid until control returns to JS. Returns NO for any other kind of value.
+static BOOL js_bytes(JSValue *value, const uint8_t **bytes, size_t *length)
+{
+    JSGlobalContextRef ctx = value.context.JSGlobalContextRef;
+    JSValueRef exception = NULL;
+
+    if ([value isString]) {
+        const char *utf8 = [[value toString] UTF8String];
+        *bytes = (const uint8_t *)utf8;
+        *length = strlen(utf8);
+        return YES;
+    }
+    if (!JSValueIsObject(ctx, value.JSValueRef)) {
+        return NO;
+    }
+
+    JSObjectRef object = JSValueToObject(ctx, value.JSValueRef, &exception);
+    JSTypedArrayType type = exception ? kJSTypedArrayTypeNone : JSValueGetTypedArrayType(ctx, object, &exception);
+    if (exception || type == kJSTypedArrayTypeNone || type == kJSTypedArrayTypeArrayBuffer) {
+        return NO;
+    }
+
+    // This points at the start of the whole buffer, which the GC can no longer move, not at the start of the view:
+    // small Buffers are slices of a shared pool, so the view's offset is rarely 0
+    uint8_t *buffer = JSObjectGetTypedArrayBytesPtr(ctx, object, &exception);
+    size_t offset = JSObjectGetTypedArrayByteOffset(ctx, object, &exception);
+    *length = JSObjectGetTypedArrayByteLength(ctx, object, &exception);
+    if (exception || (buffer == NULL && *length != 0)) {
+        return NO;
+    }
+    *bytes = buffer ? buffer + offset : NULL;
+    return YES;
+}
+
+// Deallocator for the bytes of typed arrays made by js_uint8_array; the context is their length
+static void js_free_bytes(void *bytes, void *length)
+{
+    insecure_memzero(bytes, (size_t)length);
+    free(bytes);
+}
+
+// Returns a Uint8Array of the malloc'd bytes without copying them. From then on JS owns them: they are zeroed and
+// freed when the array is collected, or straight away if it can't be made.
+static JSValue *js_uint8_array(JSContext *context, uint8_t *bytes, size_t length)
+{
+    JSValueRef exception = NULL;
+    JSObjectRef array = JSObjectMakeTypedArrayWithBytesNoCopy(context.JSGlobalContextRef, kJSTypedArrayTypeUint8Array, bytes, length, js_free_bytes, (void *)length, &exception);
+
+    if (!array || exception) {
+        return nil;
+    }
+    return [JSValue valueWithJSValueRef:array inContext:context];
 }
 
 @end
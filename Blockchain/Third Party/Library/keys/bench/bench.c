@@ -0,0 +1,917 @@
+#include <sys/types.h>
+
+#include <err.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "crypto_keycache.h"
+#include "crypto_scrypt.h"
+#include "hexify.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "sha512.h"
+
+/* Hardware counters read around each timed operation. */
+#define NCOUNTERS 3
+static const char * counter_names[NCOUNTERS] = {
+	"cycles",
+	"llc_misses",
+	"dtlb_misses"
+};
+
+/* The perf_event descriptors, or -1 if a counter is unavailable. */
+static int counter_fds[NCOUNTERS] = { -1, -1, -1 };
+
+/* A scrypt known-answer test. */
+static const struct scrypt_kat {
+	const char * passwd;
+	const char * salt;
+	uint64_t N;
+	uint32_t r;
+	uint32_t p;
+	const char * result;
+} scrypt_kats[] = {
+	/* RFC 7914 section 12. */
+	{ "", "", 16, 1, 1,
+	    "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+	    "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906" },
+	{ "password", "NaCl", 1024, 8, 16,
+	    "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+	    "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640" },
+	{ "pleaseletmein", "SodiumChloride", 16384, 8, 1,
+	    "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+	    "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887" }
+};
+
+/* A PBKDF2-HMAC-SHA256 known-answer test. */
+static const struct pbkdf2_kat {
+	const char * passwd;
+	size_t passwdlen;
+	const char * salt;
+	size_t saltlen;
+	uint64_t c;
+	const char * result;
+} pbkdf2_kats[] = {
+	/* RFC 7914 section 11. */
+	{ "passwd", 6, "salt", 4, 1,
+	    "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+	    "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783" },
+	{ "Password", 8, "NaCl", 4, 80000,
+	    "4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56"
+	    "a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d" },
+
+	/* The RFC 6070 inputs, with SHA256 in place of SHA1. */
+	{ "password", 8, "salt", 4, 1,
+	    "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b" },
+	{ "password", 8, "salt", 4, 2,
+	    "ae4d0c95af6b46d32d0adff928f06dd02a303f8ef3c251dfd6e2d85a95474c43" },
+	{ "password", 8, "salt", 4, 4096,
+	    "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a" },
+	{ "passwordPASSWORDpassword", 24,
+	    "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+	    "348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1"
+	    "c635518c7dac47e9" },
+	{ "pass\0word", 9, "sa\0lt", 5, 4096,
+	    "89b69d0516f829893c696226650a8687" }
+};
+
+/* PBKDF2-HMAC-SHA512 known-answer tests, in the same format. */
+static const struct pbkdf2_kat pbkdf2_sha512_kats[] = {
+	/* The RFC 6070 inputs, with SHA512 in place of SHA1. */
+	{ "password", 8, "salt", 4, 1,
+	    "867f70cf1ade02cff3752599a3a53dc4af34c7a669815ae5d513554e1c8cf252"
+	    "c02d470a285a0501bad999bfe943c08f050235d7d68b1da55e63f73b60a57fce" },
+	{ "password", 8, "salt", 4, 2,
+	    "e1d9c16aa681708a45f5c7c4e215ceb66e011a2e9f0040713f18aefdb866d53c"
+	    "f76cab2868a39b9f7840edce4fef5a82be67335c77a6068e04112754f27ccf4e" },
+	{ "password", 8, "salt", 4, 4096,
+	    "d197b1b33db0143e018b12f3d1d1479e6cdebdcc97c5c0f87f6902e072f457b5"
+	    "143f30602641b3d55cd335988cb36b84376060ecd532e039b742a239434af2d5" },
+	{ "passwordPASSWORDpassword", 24,
+	    "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+	    "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71"
+	    "115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8" },
+	{ "pass\0word", 9, "sa\0lt", 5, 4096,
+	    "9d9e9c4cd21fe4be24d5b8244c759665f39d98fc12a9ca759bb021db3cfadf34"
+	    "5844aebe70dd8b2f6966f25f3613e1187bbd24ed2ca43ed13b246e4675be7ab9"
+	    "ce5cb1e9bd865e2240eecd4ec012b1f9fac4dac0bb23098255831bda380c05ac"
+	    "44534b869e811cb80625853cfdf018de9d0b4925f4ff6b0dddae5213f94386ae" },
+
+	/* BIP39 seed from the Trezor test vectors, passphrase "TREZOR". */
+	{ "abandon abandon abandon abandon abandon abandon abandon abandon "
+	    "abandon abandon abandon about", 93, "mnemonicTREZOR", 14, 2048,
+	    "c55257c360c07c72029aebc1b53c05ed0362ada38ead3e3e9efa3708e5349553"
+	    "1f09a6987599d18264c1e1c92f2cf141630c7a3c4ab7c81b2f001698e7463b04" }
+};
+
+/* PBKDF2-HMAC-SHA1 known-answer tests, in the same format. */
+static const struct pbkdf2_kat pbkdf2_sha1_kats[] = {
+	/* RFC 6070, less the 2^24 iteration test. */
+	{ "password", 8, "salt", 4, 1,
+	    "0c60c80f961f0e71f3a9b524af6012062fe037a6" },
+	{ "password", 8, "salt", 4, 2,
+	    "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957" },
+	{ "password", 8, "salt", 4, 4096,
+	    "4b007901b765489abead49d926f721d065a429c1" },
+	{ "passwordPASSWORDpassword", 24,
+	    "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+	    "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038" },
+	{ "pass\0word", 9, "sa\0lt", 5, 4096,
+	    "56fa6aa75548099dcc37d7f03425e0c3" },
+
+	/* A wallet payload key: 16 bytes of IV as salt, 5000 iterations. */
+	{ "correct horse battery staple", 28,
+	    "\x00\x01\x02\x03\x04\x05\x06\x07"
+	    "\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f", 16, 5000,
+	    "03ae758c13841f856880c1007c83893430738b68793eba3d997a6bc029940918" }
+};
+
+/* An HMAC-SHA256 known-answer test from RFC 4231. */
+static const struct hmac_kat {
+	const char * key;
+	const char * msg;
+	const char * result;
+} hmac_kats[] = {
+	{ "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
+	    "4869205468657265",
+	    "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+	{ "4a656665",
+	    "7768617420646f2079612077616e7420666f72206e6f7468696e673f",
+	    "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+	{ "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+	    "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+	    "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+	    "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+	    "aaaaaa",
+	    "54657374205573696e67204c6172676572205468616e20426c6f636b2d53697a"
+	    "65204b6579202d2048617368204b6579204669727374",
+	    "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" }
+};
+
+/* The benchmark grids; the quick grid is used with -q. */
+static const struct scrypt_params {
+	uint64_t N;
+	uint32_t r;
+	uint32_t p;
+} scrypt_grid[] = {
+	{ 1024, 1, 1 }, { 16384, 1, 1 }, { 131072, 1, 1 },
+	{ 1024, 8, 1 }, { 16384, 8, 1 }, { 16384, 8, 2 }, { 16384, 8, 4 },
+	{ 65536, 8, 1 }, { 1024, 16, 1 }, { 8192, 16, 1 }, { 8192, 16, 2 }
+}, scrypt_quick[] = {
+	{ 1024, 8, 1 }, { 16384, 8, 1 }
+};
+static const uint64_t pbkdf2_iters[] = { 1, 1000, 10000, 100000 };
+static const uint64_t pbkdf2_quick_iters[] = { 1, 1000 };
+static const size_t pbkdf2_dklens[] = { 32, 64, 128, 1024 };
+static const uint64_t pbkdf2_threads_iters[] = { 10000 };
+static const size_t pbkdf2_threads_dklens[] = { 1024 };
+static const uint64_t pbkdf2_sha1_iters[] = { 5000 };
+static const size_t pbkdf2_sha1_dklens[] = { 32 };
+static const uint64_t pbkdf2_sha512_iters[] = { 2048 };
+static const size_t pbkdf2_sha512_dklens[] = { 64, 256 };
+static const size_t hmac_msglens[] = { 0, 64, 1024, 16384, 1048576 };
+static const size_t hmac_batch_msglens[] = { 0, 64, 1024, 16384 };
+static const size_t hex_lens[] = { 32, 1024, 16384, 1048576 };
+
+/* Number of messages in each HMAC_SHA256_Batch call. */
+#define HMAC_BATCH	8
+
+/* Per-operation measurements. */
+struct result {
+	uint64_t min_ns;
+	uint64_t median_ns;
+	int have_counters;
+	uint64_t counters[NCOUNTERS];
+};
+
+/* Whether a JSON result object has been printed yet. */
+static int first_result = 1;
+
+/**
+ * unhex(s, buf, buflen):
+ * Decode the hex string ${s} into ${buf}, which has room for ${buflen}
+ * bytes, and return the number of bytes written.
+ */
+static size_t
+unhex(const char * s, uint8_t * buf, size_t buflen)
+{
+	size_t i;
+	unsigned int x;
+
+	for (i = 0; (i < buflen) && (s[2 * i] != '\0'); i++) {
+		if (sscanf(&s[2 * i], "%2x", &x) != 1)
+			errx(1, "bad hex string in known-answer test");
+		buf[i] = (uint8_t)x;
+	}
+	return (i);
+}
+
+/**
+ * stop_once(cookie, done, total):
+ * Progress callback which asks crypto_scrypt_resumable() to stop the first
+ * time it is called, and counts the calls in the int ${cookie}.
+ */
+static int
+stop_once(void * cookie, uint64_t done, uint64_t total)
+{
+	int * calls = cookie;
+
+	(void)done; /* UNUSED */
+	(void)total; /* UNUSED */
+
+	return ((*calls)++ == 0);
+}
+
+/**
+ * selftest(void):
+ * Check crypto_scrypt (resumed or not), PBKDF2_SHA256 (threaded or not),
+ * PBKDF2_SHA1, PBKDF2_SHA512 and HMAC_SHA256 against the known answers
+ * above, hexify and unhexify against printf and on input which is not hex,
+ * and that the key cache returns what was put in it only when asked with the
+ * same inputs.
+ * Return the number of failures.
+ */
+static int
+selftest(void)
+{
+	const struct scrypt_kat * S;
+	const struct pbkdf2_kat * P;
+	const struct hmac_kat * H;
+	struct crypto_keycache * C;
+	HMAC_SHA256_CTX ctx;
+	uint8_t key[256], msg[256];
+	uint8_t expected[128], buf[128];
+	uint8_t id[2][32];
+	uint64_t params[2] = { 5000, 32 };
+	uint64_t epoch;
+	uint8_t * ckpt;
+	char hex[257], ref[257];
+	size_t keylen, msglen, len, ckptlen;
+	size_t i, j;
+	int calls;
+	int failures = 0;
+
+	for (i = 0; i < sizeof(scrypt_kats) / sizeof(scrypt_kats[0]); i++) {
+		S = &scrypt_kats[i];
+		len = unhex(S->result, expected, sizeof(expected));
+		if (crypto_scrypt((const uint8_t *)S->passwd, strlen(S->passwd),
+		    (const uint8_t *)S->salt, strlen(S->salt), S->N, S->r, S->p,
+		    buf, len) || memcmp(buf, expected, len)) {
+			warnx("scrypt test vector %zu failed", i);
+			failures++;
+		}
+
+		/* Stop part way through, then carry on from the checkpoint. */
+		ckptlen = crypto_scrypt_checkpoint_size(S->N, S->r, S->p);
+		if ((ckpt = crypto_scrypt_checkpoint_alloc(S->N, S->r,
+		    S->p)) == NULL) {
+			warn("crypto_scrypt_checkpoint_alloc");
+			failures++;
+			continue;
+		}
+		calls = 0;
+		if ((crypto_scrypt_resumable((const uint8_t *)S->passwd,
+		    strlen(S->passwd), (const uint8_t *)S->salt,
+		    strlen(S->salt), S->N, S->r, S->p, buf, len, ckpt, ckptlen,
+		    stop_once, &calls) != -1) || (errno != EAGAIN) ||
+		    crypto_scrypt_resumable((const uint8_t *)S->passwd,
+		    strlen(S->passwd), (const uint8_t *)S->salt,
+		    strlen(S->salt), S->N, S->r, S->p, buf, len, ckpt, ckptlen,
+		    stop_once, &calls) || memcmp(buf, expected, len)) {
+			warnx("scrypt test vector %zu failed resumed", i);
+			failures++;
+		}
+		crypto_scrypt_checkpoint_free(ckpt, ckptlen);
+	}
+
+	for (i = 0; i < sizeof(pbkdf2_kats) / sizeof(pbkdf2_kats[0]); i++) {
+		P = &pbkdf2_kats[i];
+		len = unhex(P->result, expected, sizeof(expected));
+		PBKDF2_SHA256((const uint8_t *)P->passwd, P->passwdlen,
+		    (const uint8_t *)P->salt, P->saltlen, P->c, buf, len);
+		if (memcmp(buf, expected, len)) {
+			warnx("PBKDF2-SHA256 test vector %zu failed", i);
+			failures++;
+		}
+		PBKDF2_SHA256_threads((const uint8_t *)P->passwd,
+		    P->passwdlen, (const uint8_t *)P->salt, P->saltlen, P->c,
+		    buf, len, 4);
+		if (memcmp(buf, expected, len)) {
+			warnx("PBKDF2-SHA256 test vector %zu failed threaded",
+			    i);
+			failures++;
+		}
+	}
+
+	for (i = 0; i < sizeof(pbkdf2_sha1_kats) /
+	    sizeof(pbkdf2_sha1_kats[0]); i++) {
+		P = &pbkdf2_sha1_kats[i];
+		len = unhex(P->result, expected, sizeof(expected));
+		PBKDF2_SHA1((const uint8_t *)P->passwd, P->passwdlen,
+		    (const uint8_t *)P->salt, P->saltlen, P->c, buf, len);
+		if (memcmp(buf, expected, len)) {
+			warnx("PBKDF2-SHA1 test vector %zu failed", i);
+			failures++;
+		}
+	}
+
+	for (i = 0; i < sizeof(pbkdf2_sha512_kats) /
+	    sizeof(pbkdf2_sha512_kats[0]); i++) {
+		P = &pbkdf2_sha512_kats[i];
+		len = unhex(P->result, expected, sizeof(expected));
+		PBKDF2_SHA512((const uint8_t *)P->passwd, P->passwdlen,
+		    (const uint8_t *)P->salt, P->saltlen, P->c, buf, len);
+		if (memcmp(buf, expected, len)) {
+			warnx("PBKDF2-SHA512 test vector %zu failed", i);
+			failures++;
+		}
+	}
+
+	for (i = 0; i < sizeof(hmac_kats) / sizeof(hmac_kats[0]); i++) {
+		H = &hmac_kats[i];
+		keylen = unhex(H->key, key, sizeof(key));
+		msglen = unhex(H->msg, msg, sizeof(msg));
+		len = unhex(H->result, expected, sizeof(expected));
+		HMAC_SHA256_Init(&ctx, key, keylen);
+		HMAC_SHA256_Update(&ctx, msg, msglen);
+		HMAC_SHA256_Final(buf, &ctx);
+		if (memcmp(buf, expected, len)) {
+			warnx("HMAC-SHA256 test vector %zu failed", i);
+			failures++;
+		}
+	}
+
+	/* Every length up to a few SIMD blocks, so the tails are covered. */
+	for (len = 0; len <= 128; len++) {
+		for (i = 0; i < len; i++) {
+			msg[i] = (uint8_t)(i * 37 + len);
+			snprintf(&ref[2 * i], 3, "%02x", msg[i]);
+		}
+		ref[2 * len] = '\0';
+		hexify(msg, hex, len);
+		if (strcmp(hex, ref)) {
+			warnx("hexify failed on %zu bytes", len);
+			failures++;
+		}
+
+		/* Decode it with every other letter in upper case. */
+		for (i = 0; i < 2 * len; i += 2) {
+			if ((hex[i] >= 'a') && (hex[i] <= 'f'))
+				hex[i] = (char)(hex[i] - 'a' + 'A');
+		}
+		if (unhexify(hex, buf, len) || memcmp(buf, msg, len)) {
+			warnx("unhexify failed on %zu bytes", len);
+			failures++;
+		}
+
+		/* Characters either side of the hex ranges must be caught. */
+		for (i = 0; i < 2 * len; i++) {
+			for (j = 0; j < 8; j++) {
+				ref[0] = hex[i];
+				hex[i] = "/:@G`g\x80\xff"[j];
+				if (unhexify(hex, buf, len) != -1) {
+					warnx("unhexify accepted '\\x%02x' "
+					    "on %zu bytes", (uint8_t)hex[i],
+					    len);
+					failures++;
+				}
+				hex[i] = ref[0];
+			}
+		}
+	}
+
+	/* Keys are found under the same inputs, and nothing else. */
+	if ((C = crypto_keycache_init(4, 60)) == NULL) {
+		warn("crypto_keycache_init");
+		failures++;
+	} else {
+		crypto_keycache_id(C, "pbkdf2-sha1", params, 2,
+		    (const uint8_t *)"password", 8, (const uint8_t *)"salt", 4,
+		    id[0]);
+		crypto_keycache_id(C, "pbkdf2-sha1", params, 2,
+		    (const uint8_t *)"passwor", 7, (const uint8_t *)"dsalt", 5,
+		    id[1]);
+		for (i = 0; i < 32; i++)
+			msg[i] = (uint8_t)i;
+		crypto_keycache_put(C, crypto_keycache_epoch(C), id[0], msg,
+		    32);
+		if (crypto_keycache_get(C, id[0], buf, 32) ||
+		    memcmp(buf, msg, 32) ||
+		    (crypto_keycache_get(C, id[1], buf, 32) != -1) ||
+		    (crypto_keycache_get(C, id[0], buf, 16) != -1)) {
+			warnx("key cache lookups failed");
+			failures++;
+		}
+		crypto_keycache_flush(C);
+		if (crypto_keycache_get(C, id[0], buf, 32) != -1) {
+			warnx("key cache flush failed");
+			failures++;
+		}
+
+		/* A key still being derived when the cache is flushed... */
+		epoch = crypto_keycache_epoch(C);
+		crypto_keycache_flush(C);
+
+		/* ... is kept out once it's done. */
+		crypto_keycache_put(C, epoch, id[0], msg, 32);
+		if (crypto_keycache_get(C, id[0], buf, 32) != -1) {
+			warnx("key cache took a key from before a flush");
+			failures++;
+		}
+		crypto_keycache_free(C);
+	}
+
+	return (failures);
+}
+
+/**
+ * counters_open(void):
+ * Open whichever of the hardware counters the kernel and CPU provide.
+ */
+static void
+counters_open(void)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+	int i;
+
+	for (i = 0; i < NCOUNTERS; i++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		switch (i) {
+		case 0:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case 1:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_LL |
+			    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			break;
+		case 2:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_DTLB |
+			    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			break;
+		}
+		counter_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0,
+		    -1, -1, 0);
+		if (counter_fds[i] == -1)
+			warn("%s counter unavailable", counter_names[i]);
+	}
+#else
+	warnx("hardware counters are only supported on Linux");
+#endif
+}
+
+/**
+ * counters_start(void):
+ * Reset and start the open counters.
+ */
+static void
+counters_start(void)
+{
+#ifdef __linux__
+	int i;
+
+	for (i = 0; i < NCOUNTERS; i++) {
+		if (counter_fds[i] == -1)
+			continue;
+		ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+/**
+ * counters_stop(values):
+ * Stop the open counters and add their values to ${values}.  Return
+ * non-zero if no counters are open.
+ */
+static int
+counters_stop(uint64_t values[NCOUNTERS])
+{
+	int have = 0;
+#ifdef __linux__
+	uint64_t v;
+	int i;
+
+	for (i = 0; i < NCOUNTERS; i++) {
+		if (counter_fds[i] == -1)
+			continue;
+		ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(counter_fds[i], &v, sizeof(v)) == sizeof(v))
+			values[i] += v;
+		have = 1;
+	}
+#else
+	(void)values; /* UNUSED */
+#endif
+
+	return (!have);
+}
+
+/**
+ * now_ns(void):
+ * Return the monotonic clock in nanoseconds.
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		err(1, "clock_gettime");
+	return ((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+}
+
+static int
+cmp_u64(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * measure(op, cookie, reps, R):
+ * Run op(cookie) once to warm up, then ${reps} more times, and store the
+ * minimum and median time and the mean counter values per run in ${R}.
+ */
+static void
+measure(void (*op)(void *), void * cookie, int reps, struct result * R)
+{
+	uint64_t * t;
+	uint64_t t0;
+	int i, j;
+
+	if ((t = malloc(reps * sizeof(uint64_t))) == NULL)
+		err(1, "malloc");
+	memset(R, 0, sizeof(struct result));
+	R->have_counters = 1;
+
+	/* Warm up caches, page tables, and the smix kernel selection. */
+	op(cookie);
+
+	for (i = 0; i < reps; i++) {
+		counters_start();
+		t0 = now_ns();
+		op(cookie);
+		t[i] = now_ns() - t0;
+		if (counters_stop(R->counters))
+			R->have_counters = 0;
+	}
+
+	qsort(t, reps, sizeof(uint64_t), cmp_u64);
+	R->min_ns = t[0];
+	R->median_ns = t[reps / 2];
+	for (j = 0; j < NCOUNTERS; j++)
+		R->counters[j] /= reps;
+	free(t);
+}
+
+/**
+ * print_result(name, params, R):
+ * Print a JSON object for the result ${R} of benchmarking ${name}, where
+ * ${params} holds the JSON members describing the parameters.
+ */
+static void
+print_result(const char * name, const char * params, const struct result * R)
+{
+	int i;
+
+	printf("%s\n    {\"function\": \"%s\", %s, \"min_ns\": %llu, "
+	    "\"median_ns\": %llu", first_result ? "" : ",", name, params,
+	    (unsigned long long)R->min_ns, (unsigned long long)R->median_ns);
+	for (i = 0; R->have_counters && (i < NCOUNTERS); i++) {
+		if (counter_fds[i] == -1)
+			printf(", \"%s\": null", counter_names[i]);
+		else
+			printf(", \"%s\": %llu", counter_names[i],
+			    (unsigned long long)R->counters[i]);
+	}
+	printf("}");
+	first_result = 0;
+}
+
+/* Benchmark operations. */
+struct scrypt_op {
+	const struct scrypt_params * P;
+	uint8_t buf[64];
+};
+
+static void
+scrypt_run(void * cookie)
+{
+	struct scrypt_op * S = cookie;
+
+	if (crypto_scrypt((const uint8_t *)"password", 8,
+	    (const uint8_t *)"salt", 4, S->P->N, S->P->r, S->P->p,
+	    S->buf, sizeof(S->buf)))
+		err(1, "crypto_scrypt");
+}
+
+struct pbkdf2_op {
+	uint64_t c;
+	uint8_t * buf;
+	size_t dklen;
+	uint32_t nthreads;
+};
+
+static void
+pbkdf2_run(void * cookie)
+{
+	struct pbkdf2_op * P = cookie;
+
+	PBKDF2_SHA256((const uint8_t *)"password", 8,
+	    (const uint8_t *)"salt", 4, P->c, P->buf, P->dklen);
+}
+
+static void
+pbkdf2_threads_run(void * cookie)
+{
+	struct pbkdf2_op * P = cookie;
+
+	PBKDF2_SHA256_threads((const uint8_t *)"password", 8,
+	    (const uint8_t *)"salt", 4, P->c, P->buf, P->dklen, P->nthreads);
+}
+
+static void
+pbkdf2_sha1_run(void * cookie)
+{
+	struct pbkdf2_op * P = cookie;
+
+	PBKDF2_SHA1((const uint8_t *)"password", 8,
+	    (const uint8_t *)"salt", 4, P->c, P->buf, P->dklen);
+}
+
+static void
+pbkdf2_sha512_run(void * cookie)
+{
+	struct pbkdf2_op * P = cookie;
+
+	PBKDF2_SHA512((const uint8_t *)"password", 8,
+	    (const uint8_t *)"salt", 4, P->c, P->buf, P->dklen);
+}
+
+struct hmac_op {
+	const uint8_t * msg;
+	size_t msglen;
+	uint8_t buf[32];
+};
+
+static void
+hmac_run(void * cookie)
+{
+	struct hmac_op * H = cookie;
+	HMAC_SHA256_CTX ctx;
+
+	HMAC_SHA256_Init(&ctx, "key", 3);
+	HMAC_SHA256_Update(&ctx, H->msg, H->msglen);
+	HMAC_SHA256_Final(H->buf, &ctx);
+}
+
+struct hex_op {
+	uint8_t * buf;
+	char * hex;
+	size_t len;
+};
+
+static void
+hexify_run(void * cookie)
+{
+	struct hex_op * X = cookie;
+
+	hexify(X->buf, X->hex, X->len);
+}
+
+static void
+unhexify_run(void * cookie)
+{
+	struct hex_op * X = cookie;
+
+	if (unhexify(X->hex, X->buf, X->len))
+		errx(1, "unhexify");
+}
+
+struct hmac_batch_op {
+	const uint8_t * msg[HMAC_BATCH];
+	size_t msglen[HMAC_BATCH];
+	uint8_t buf[32 * HMAC_BATCH];
+};
+
+static void
+hmac_batch_run(void * cookie)
+{
+	struct hmac_batch_op * H = cookie;
+	HMAC_SHA256_CTX ctx;
+
+	HMAC_SHA256_Init(&ctx, "key", 3);
+	HMAC_SHA256_Batch(&ctx, H->msg, H->msglen, HMAC_BATCH, H->buf);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "usage: scrypt-bench [-cq] [-n reps]\n");
+	exit(1);
+}
+
+int
+main(int argc, char * argv[])
+{
+	const struct scrypt_params * grid = scrypt_grid;
+	size_t ngrid = sizeof(scrypt_grid) / sizeof(scrypt_grid[0]);
+	const uint64_t * iters = pbkdf2_iters;
+	size_t niters = sizeof(pbkdf2_iters) / sizeof(pbkdf2_iters[0]);
+	struct scrypt_op S;
+	struct pbkdf2_op P;
+	struct hmac_op H;
+	struct hmac_batch_op HB;
+	struct hex_op X;
+	struct result R;
+	uint64_t vbacking[CRYPTO_SCRYPT_V_NTYPES];
+	uint8_t * msg;
+	char params[128];
+	size_t i, j;
+	long ncpus;
+	int reps = 5;
+	int counters = 0;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "cn:q")) != -1) {
+		switch (ch) {
+		case 'c':
+			counters = 1;
+			break;
+		case 'n':
+			if ((reps = atoi(optarg)) < 1)
+				usage();
+			break;
+		case 'q':
+			grid = scrypt_quick;
+			ngrid = sizeof(scrypt_quick) / sizeof(scrypt_quick[0]);
+			iters = pbkdf2_quick_iters;
+			niters = sizeof(pbkdf2_quick_iters) /
+			    sizeof(pbkdf2_quick_iters[0]);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+
+	/* Timings of wrong code are worthless; check the answers first. */
+	if (selftest())
+		errx(1, "known-answer tests failed; not benchmarking");
+
+	if (counters)
+		counters_open();
+
+	printf("{\n  \"selftest\": \"ok\",\n  \"reps\": %d,\n  \"results\": [",
+	    reps);
+
+	/* scrypt. */
+	for (i = 0; i < ngrid; i++) {
+		S.P = &grid[i];
+		measure(scrypt_run, &S, reps, &R);
+		snprintf(params, sizeof(params),
+		    "\"N\": %llu, \"r\": %u, \"p\": %u, \"dkLen\": %zu",
+		    (unsigned long long)S.P->N, S.P->r, S.P->p, sizeof(S.buf));
+		print_result("crypto_scrypt", params, &R);
+	}
+
+	/* PBKDF2. */
+	for (i = 0; i < niters; i++) {
+		for (j = 0; j < sizeof(pbkdf2_dklens) / sizeof(size_t); j++) {
+			P.c = iters[i];
+			P.dklen = pbkdf2_dklens[j];
+			if ((P.buf = malloc(P.dklen)) == NULL)
+				err(1, "malloc");
+			measure(pbkdf2_run, &P, reps, &R);
+			snprintf(params, sizeof(params),
+			    "\"c\": %llu, \"dkLen\": %zu",
+			    (unsigned long long)P.c, P.dklen);
+			print_result("PBKDF2_SHA256", params, &R);
+			free(P.buf);
+		}
+	}
+	if ((ncpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		ncpus = 1;
+	for (i = 0; i < sizeof(pbkdf2_threads_iters) / sizeof(uint64_t);
+	    i++) {
+		for (j = 0; j < sizeof(pbkdf2_threads_dklens) / sizeof(size_t);
+		    j++) {
+			P.c = pbkdf2_threads_iters[i];
+			P.dklen = pbkdf2_threads_dklens[j];
+			P.nthreads = (uint32_t)ncpus;
+			if ((P.buf = malloc(P.dklen)) == NULL)
+				err(1, "malloc");
+			measure(pbkdf2_threads_run, &P, reps, &R);
+			snprintf(params, sizeof(params),
+			    "\"c\": %llu, \"dkLen\": %zu, \"nthreads\": %u",
+			    (unsigned long long)P.c, P.dklen, P.nthreads);
+			print_result("PBKDF2_SHA256_threads", params, &R);
+			free(P.buf);
+		}
+	}
+	for (i = 0; i < sizeof(pbkdf2_sha1_iters) / sizeof(uint64_t); i++) {
+		for (j = 0; j < sizeof(pbkdf2_sha1_dklens) / sizeof(size_t);
+		    j++) {
+			P.c = pbkdf2_sha1_iters[i];
+			P.dklen = pbkdf2_sha1_dklens[j];
+			if ((P.buf = malloc(P.dklen)) == NULL)
+				err(1, "malloc");
+			measure(pbkdf2_sha1_run, &P, reps, &R);
+			snprintf(params, sizeof(params),
+			    "\"c\": %llu, \"dkLen\": %zu",
+			    (unsigned long long)P.c, P.dklen);
+			print_result("PBKDF2_SHA1", params, &R);
+			free(P.buf);
+		}
+	}
+	for (i = 0; i < sizeof(pbkdf2_sha512_iters) / sizeof(uint64_t); i++) {
+		for (j = 0; j < sizeof(pbkdf2_sha512_dklens) / sizeof(size_t);
+		    j++) {
+			P.c = pbkdf2_sha512_iters[i];
+			P.dklen = pbkdf2_sha512_dklens[j];
+			if ((P.buf = malloc(P.dklen)) == NULL)
+				err(1, "malloc");
+			measure(pbkdf2_sha512_run, &P, reps, &R);
+			snprintf(params, sizeof(params),
+			    "\"c\": %llu, \"dkLen\": %zu",
+			    (unsigned long long)P.c, P.dklen);
+			print_result("PBKDF2_SHA512", params, &R);
+			free(P.buf);
+		}
+	}
+
+	/* HMAC. */
+	if ((msg = calloc(1, hmac_msglens[sizeof(hmac_msglens) /
+	    sizeof(size_t) - 1])) == NULL)
+		err(1, "calloc");
+	for (i = 0; i < sizeof(hmac_msglens) / sizeof(size_t); i++) {
+		H.msg = msg;
+		H.msglen = hmac_msglens[i];
+		measure(hmac_run, &H, reps, &R);
+		snprintf(params, sizeof(params), "\"msglen\": %zu", H.msglen);
+		print_result("HMAC_SHA256", params, &R);
+	}
+	for (i = 0; i < sizeof(hmac_batch_msglens) / sizeof(size_t); i++) {
+		for (j = 0; j < HMAC_BATCH; j++) {
+			HB.msg[j] = msg;
+			HB.msglen[j] = hmac_batch_msglens[i];
+		}
+		measure(hmac_batch_run, &HB, reps, &R);
+		snprintf(params, sizeof(params),
+		    "\"msglen\": %zu, \"nmsgs\": %d", HB.msglen[0],
+		    HMAC_BATCH);
+		print_result("HMAC_SHA256_Batch", params, &R);
+	}
+	free(msg);
+
+	/* Hex. */
+	for (i = 0; i < sizeof(hex_lens) / sizeof(size_t); i++) {
+		X.len = hex_lens[i];
+		if (((X.buf = calloc(1, X.len)) == NULL) ||
+		    ((X.hex = malloc(2 * X.len + 1)) == NULL))
+			err(1, "malloc");
+		measure(hexify_run, &X, reps, &R);
+		snprintf(params, sizeof(params), "\"len\": %zu", X.len);
+		print_result("hexify", params, &R);
+		measure(unhexify_run, &X, reps, &R);
+		print_result("unhexify", params, &R);
+		free(X.hex);
+		free(X.buf);
+	}
+
+	/* How the V arrays were backed. */
+	crypto_scrypt_vbacking(vbacking);
+	printf("\n  ],\n  \"vbacking\": {\"malloc\": %llu, \"pages\": %llu, "
+	    "\"thp\": %llu, \"hugetlb\": %llu}\n}\n",
+	    (unsigned long long)vbacking[CRYPTO_SCRYPT_V_MALLOC],
+	    (unsigned long long)vbacking[CRYPTO_SCRYPT_V_PAGES],
+	    (unsigned long long)vbacking[CRYPTO_SCRYPT_V_THP],
+	    (unsigned long long)vbacking[CRYPTO_SCRYPT_V_HUGETLB]);
+
+	return (0);
+}
@@ -16,3 +16,44 @@
 #define dprintf fdprintf
 #define mlock(...) (0)
 #endif
+
+/*
+ * Enable CPU-specific code when the compiler can generate it; the code is
+ * only used if the CPU we end up running on supports it (see cpusupport.h).
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define CPUSUPPORT_X86_CPUID 1
+#if defined(__SSE2__)
+#define CPUSUPPORT_X86_SSE2 1
+#endif
+
+/*
+ * SSSE3, AVX2 and SHA extensions code is compiled with a target attribute
+ * rather than for the whole build, so all it needs is a compiler which
+ * understands those.
+ */
+#if defined(__GNUC__)
+#define CPUSUPPORT_X86_SSSE3 1
+#define CPUSUPPORT_X86_AVX2 1
+#define CPUSUPPORT_X86_SHANI 1
+#endif
+#endif
+
+/*
+ * The ARMv8 SHA1 and SHA256 instructions are used if the compiler targets
+ * CPUs which have them, as it does for every 64-bit Apple device; likewise
+ * the ARMv8.2 SHA512 instructions, which only newer CPUs have.
+ */
+#if defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define CPUSUPPORT_ARM_SHA1 1
+#define CPUSUPPORT_ARM_SHA256 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_SHA512)
+#define CPUSUPPORT_ARM_SHA512 1
+#endif
+
+/* Every 64-bit ARM CPU has the Advanced SIMD (NEON) instructions. */
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define CPUSUPPORT_ARM_NEON 1
+#endif
@@ -0,0 +1,61 @@
+#ifndef _CPUSUPPORT_H_
+#define _CPUSUPPORT_H_
+
+#include "scrypt_platform.h"
+
+/*
+ * CPU feature detection.  Each cpusupport_<arch>_<feature>() function
+ * returns non-zero if the code is running on a CPU which supports the
+ * feature and the feature was enabled at compile time (see config.h);
+ * otherwise, it returns zero.
+ */
+
+#ifdef CPUSUPPORT_X86_SSE2
+int cpusupport_x86_sse2(void);
+#else
+#define cpusupport_x86_sse2() (0)
+#endif
+
+#ifdef CPUSUPPORT_X86_SSSE3
+int cpusupport_x86_ssse3(void);
+#else
+#define cpusupport_x86_ssse3() (0)
+#endif
+
+#ifdef CPUSUPPORT_X86_AVX2
+int cpusupport_x86_avx2(void);
+#else
+#define cpusupport_x86_avx2() (0)
+#endif
+
+#ifdef CPUSUPPORT_X86_SHANI
+int cpusupport_x86_shani(void);
+#else
+#define cpusupport_x86_shani() (0)
+#endif
+
+#ifdef CPUSUPPORT_ARM_NEON
+int cpusupport_arm_neon(void);
+#else
+#define cpusupport_arm_neon() (0)
+#endif
+
+#ifdef CPUSUPPORT_ARM_SHA1
+int cpusupport_arm_sha1(void);
+#else
+#define cpusupport_arm_sha1() (0)
+#endif
+
+#ifdef CPUSUPPORT_ARM_SHA256
+int cpusupport_arm_sha256(void);
+#else
+#define cpusupport_arm_sha256() (0)
+#endif
+
+#ifdef CPUSUPPORT_ARM_SHA512
+int cpusupport_arm_sha512(void);
+#else
+#define cpusupport_arm_sha512() (0)
+#endif
+
+#endif /* !_CPUSUPPORT_H_ */
@@ -0,0 +1,83 @@
+#ifndef _CRYPTO_KEYCACHE_H_
+#define _CRYPTO_KEYCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longest derived key which can be cached. */
+#define CRYPTO_KEYCACHE_MAXKEY	64
+
+/* Opaque cache; see crypto_keycache_init(). */
+struct crypto_keycache;
+
+/**
+ * crypto_keycache_init(nentries, ttl):
+ * Create a cache which holds up to ${nentries} derived keys, each for at most
+ * ${ttl} seconds after it was added.  The keys live in memory which is locked
+ * so that it is never swapped out, and are zeroed when they expire, are
+ * evicted, or are flushed.  Return NULL if the memory cannot be locked.
+ */
+struct crypto_keycache * crypto_keycache_init(size_t, double);
+
+/**
+ * crypto_keycache_id(C, alg, params, nparams, passwd, passwdlen, salt,
+ *     saltlen, id):
+ * Compute in ${id} the identifier in ${C} of the key derived by the algorithm
+ * named ${alg} with the parameters params[0 .. ${nparams} - 1] from
+ * ${passwd} and ${salt}.  This is a hash keyed with a secret random value
+ * which belongs to ${C}, so it reveals nothing about the password.
+ */
+void crypto_keycache_id(struct crypto_keycache *, const char *,
+    const uint64_t *, size_t, const uint8_t *, size_t, const uint8_t *, size_t,
+    uint8_t[32]);
+
+/**
+ * crypto_keycache_get(C, id, buf, buflen):
+ * If ${C} holds a ${buflen}-byte key with the identifier ${id} which has not
+ * expired, copy it into ${buf}.
+ *
+ * Return 0 if the key was found; or -1 otherwise.
+ */
+int crypto_keycache_get(struct crypto_keycache *, const uint8_t[32],
+    uint8_t *, size_t);
+
+/**
+ * crypto_keycache_epoch(C):
+ * Return the number of times ${C} has been flushed.  A caller which reads
+ * this before it derives a key and passes it to crypto_keycache_put() can't
+ * add the key to the cache after a flush which was meant to get rid of it.
+ */
+uint64_t crypto_keycache_epoch(struct crypto_keycache *);
+
+/**
+ * crypto_keycache_put(C, epoch, id, buf, buflen):
+ * Add the ${buflen}-byte key ${buf} to ${C} with the identifier ${id},
+ * replacing any key it already holds with that identifier, or else an
+ * expired key, or else the key which would expire first.  Keys longer than
+ * CRYPTO_KEYCACHE_MAXKEY bytes are not cached, and nor are keys if ${C} has
+ * been flushed since crypto_keycache_epoch() returned ${epoch}.
+ */
+void crypto_keycache_put(struct crypto_keycache *, uint64_t,
+    const uint8_t[32], const uint8_t *, size_t);
+
+/**
+ * crypto_keycache_expire(C):
+ * Zero the keys in ${C} which have expired.  Expired keys are never returned
+ * in any case, but are only zeroed when the cache is next used or this is
+ * called.
+ */
+void crypto_keycache_expire(struct crypto_keycache *);
+
+/**
+ * crypto_keycache_flush(C):
+ * Zero all of the keys in ${C}, and keep out any which were being derived.
+ */
+void crypto_keycache_flush(struct crypto_keycache *);
+
+/**
+ * crypto_keycache_free(C):
+ * Zero all of the keys in ${C} and free it.
+ */
+void crypto_keycache_free(struct crypto_keycache *);
+
+#endif /* !_CRYPTO_KEYCACHE_H_ */
@@ -29,6 +29,7 @@
 #ifndef _CRYPTO_SCRYPT_H_
 #define _CRYPTO_SCRYPT_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -43,4 +44,189 @@
 int crypto_scrypt(const uint8_t *, size_t, const uint8_t *, size_t, uint64_t,
     uint32_t, uint32_t, uint8_t *, size_t);
 
+/**
+ * crypto_scrypt_threads(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, nthreads, maxmem):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt() does, but run
+ * the p instances of SMix on up to nthreads threads.  Each thread uses its
+ * own 128rN-byte V array; if maxmem is non-zero, fewer threads are used if
+ * necessary to keep the memory used within maxmem bytes (but one thread is
+ * always used, even if that alone exceeds maxmem).  If maxmem leaves room for
+ * it, each thread interleaves two SMix instances to hide memory latency.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_threads(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t, uint32_t, size_t);
+
+/**
+ * crypto_scrypt_memory(N, r, p):
+ * Return the number of bytes of memory which crypto_scrypt() allocates when
+ * called with the parameters N, r, and p; or 0 if it would reject them.
+ */
+size_t crypto_scrypt_memory(uint64_t, uint32_t, uint32_t);
+
+/* Ways in which the V array of an SMix computation can be backed. */
+#define CRYPTO_SCRYPT_V_MALLOC	0	/* malloc or posix_memalign */
+#define CRYPTO_SCRYPT_V_PAGES	1	/* mmap of normal pages */
+#define CRYPTO_SCRYPT_V_THP	2	/* mmap with transparent huge pages */
+#define CRYPTO_SCRYPT_V_HUGETLB	3	/* mmap from the reserved huge pages */
+#define CRYPTO_SCRYPT_V_NTYPES	4
+
+/**
+ * crypto_scrypt_vbacking(counts):
+ * Store in counts[t] the number of V arrays which have been allocated with
+ * backing t (one of the CRYPTO_SCRYPT_V_* values) since the program started.
+ * Huge pages are used when the system provides them and the array is large
+ * enough; otherwise allocation silently falls back to normal pages.
+ */
+void crypto_scrypt_vbacking(uint64_t[CRYPTO_SCRYPT_V_NTYPES]);
+
+/* Where the time and memory went in a crypto_scrypt_stats() computation. */
+struct crypto_scrypt_stats {
+	uint64_t alloc_ns;	/* Allocating B, V, and XY. */
+	uint64_t pbkdf2_in_ns;	/* Step 1: PBKDF2 of password and salt. */
+	uint64_t smix1_ns;	/* SMix loop filling V, summed over threads. */
+	uint64_t smix2_ns;	/* SMix loop reading V, summed over threads. */
+	uint64_t pbkdf2_out_ns;	/* Step 5: PBKDF2 producing the output. */
+	uint64_t free_ns;	/* Freeing B, V, and XY. */
+	uint64_t total_ns;	/* The whole computation. */
+	uint64_t faults;	/* Page faults taken by the process. */
+	size_t mem;		/* Bytes allocated, summed over threads. */
+	int vbacking;		/* CRYPTO_SCRYPT_V_* backing of our V. */
+	uint32_t nthreads;	/* Threads which ran SMix. */
+};
+
+/**
+ * crypto_scrypt_stats(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     nthreads, maxmem, stats):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt_threads() does,
+ * and record in ${stats} how long each phase of the computation took, how
+ * much memory was allocated, and how V was backed.  The other functions here
+ * never read the clock.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_stats(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t, uint32_t, size_t,
+    struct crypto_scrypt_stats *);
+
+/**
+ * crypto_scrypt_progress(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, nthreads, maxmem, stats, callback, cookie):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt_threads() does,
+ * calling callback(cookie, done, total) every so often to report that ${done}
+ * of the ${total} SMix iterations have been completed.  The callback may be
+ * called from any of the threads, but never concurrently.  If it returns
+ * non-zero, stop as soon as possible and free the memory used.  If ${stats}
+ * is not NULL, fill it in as crypto_scrypt_stats() does.
+ *
+ * Return 0 on success; or -1 on error, with errno set to ECANCELED if the
+ * callback cancelled the computation.
+ */
+int crypto_scrypt_progress(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t, uint32_t, size_t,
+    struct crypto_scrypt_stats *, int (*)(void *, uint64_t, uint64_t),
+    void *);
+
+/**
+ * crypto_scrypt_tmto(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     maxmem):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt() does, using
+ * no more than ${maxmem} bytes of memory.  Only every kth block of V is kept
+ * and the others are recomputed in the second loop of SMix, where k is the
+ * smallest power of 2 for which everything fits; this takes about (k + 3) / 4
+ * times as long as keeping all of V.  If ${maxmem} is zero, all of V is kept.
+ *
+ * Return 0 on success; or -1 on error, with errno set to ENOMEM if the
+ * computation cannot be done within ${maxmem} bytes.
+ */
+int crypto_scrypt_tmto(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t, size_t);
+
+/* Opaque scrypt context; see crypto_scrypt_ctx_init(). */
+struct crypto_scrypt_ctx;
+
+/**
+ * crypto_scrypt_ctx_init(N, r, p):
+ * Allocate a context holding the B, XY and V arrays needed to compute scrypt
+ * with parameters N, r, and p, locking them into memory if possible.  The
+ * context can then be used by crypto_scrypt_ctx_run() for any parameters
+ * which need no more memory than these.
+ *
+ * Return the context on success; or NULL on error.
+ */
+struct crypto_scrypt_ctx * crypto_scrypt_ctx_init(uint64_t, uint32_t,
+    uint32_t);
+
+/**
+ * crypto_scrypt_ctx_run(ctx, passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) as crypto_scrypt() does, using the memory held by ${ctx} instead
+ * of allocating it.  The parameters must not need more memory than those
+ * passed to crypto_scrypt_ctx_init().  The memory is zeroed before returning.
+ * A context must not be used by more than one thread at once.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_ctx_run(struct crypto_scrypt_ctx *, const uint8_t *, size_t,
+    const uint8_t *, size_t, uint64_t, uint32_t, uint32_t, uint8_t *, size_t);
+
+/**
+ * crypto_scrypt_ctx_free(ctx):
+ * Zero and free the memory held by ${ctx}.
+ */
+void crypto_scrypt_ctx_free(struct crypto_scrypt_ctx *);
+
+/**
+ * crypto_scrypt_checkpoint_size(N, r, p):
+ * Return the size of the buffer which crypto_scrypt_resumable() needs to
+ * hold a checkpoint of a computation with parameters N, r, and p; or 0 if
+ * crypto_scrypt() would reject them.
+ */
+size_t crypto_scrypt_checkpoint_size(uint64_t, uint32_t, uint32_t);
+
+/**
+ * crypto_scrypt_checkpoint_alloc(N, r, p):
+ * Allocate a zeroed buffer of crypto_scrypt_checkpoint_size(N, r, p) bytes
+ * to hold a checkpoint for crypto_scrypt_resumable().  It is kept out of
+ * core dumps and, if resource limits allow, locked into memory, since it
+ * holds state derived from the password.  Return NULL on error.
+ */
+uint8_t * crypto_scrypt_checkpoint_alloc(uint64_t, uint32_t, uint32_t);
+
+/**
+ * crypto_scrypt_checkpoint_free(ckpt, ckptlen):
+ * Zero and free the ${ckptlen}-byte buffer ${ckpt}, which must have been
+ * allocated by crypto_scrypt_checkpoint_alloc().
+ */
+void crypto_scrypt_checkpoint_free(uint8_t *, size_t);
+
+/**
+ * crypto_scrypt_resumable(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, ckpt, ckptlen, callback, cookie):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt() does, calling
+ * callback(cookie, done, total) as crypto_scrypt_progress() does.  If ${ckpt}
+ * holds a checkpoint of this same computation, carry on from where it was
+ * taken instead of starting over.  If the callback returns non-zero, stop;
+ * then, if ${ckpt} is not NULL, save the state of the computation in it and
+ * set errno to EAGAIN, or otherwise set errno to ECANCELED.  The buffer
+ * ${ckpt} must be ${ckptlen} >= crypto_scrypt_checkpoint_size(N, r, p) bytes
+ * long; if it holds a checkpoint, of this or any other computation, it is
+ * zeroed when the computation completes, but otherwise it is not touched.  A
+ * checkpoint can only be resumed by the same build of this code on the same
+ * CPU, and reveals as much as the derived key does.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_resumable(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t, uint8_t *, size_t,
+    int (*)(void *, uint64_t, uint64_t), void *);
+
 #endif /* !_CRYPTO_SCRYPT_H_ */
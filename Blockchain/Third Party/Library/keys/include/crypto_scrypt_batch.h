@@ -0,0 +1,54 @@
+#ifndef _CRYPTO_SCRYPT_BATCH_H_
+#define _CRYPTO_SCRYPT_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* One scrypt computation in a batch. */
+struct crypto_scrypt_job {
+	/* Inputs, as for crypto_scrypt(). */
+	const uint8_t * passwd;
+	size_t passwdlen;
+	const uint8_t * salt;
+	size_t saltlen;
+	uint64_t N;
+	uint32_t r;
+	uint32_t p;
+	uint8_t * buf;
+	size_t buflen;
+
+	/* Outputs: 0 or -1 as returned by crypto_scrypt(), and errno. */
+	int rc;
+	int err;
+};
+
+/**
+ * crypto_scrypt_batch(jobs, njobs, nthreads, maxmem, callback, cookie):
+ * Compute each of the ${njobs} scrypt computations described by ${jobs},
+ * using up to ${nthreads} threads (including the calling thread).  Jobs are
+ * spread over per-thread queues and idle threads steal work from the others;
+ * a thread runs two jobs with the same N and r together, interleaving their
+ * SMix computations, when the memory budget allows.
+ * If ${maxmem} is non-zero, jobs are only started while the memory needed by
+ * all running jobs stays within ${maxmem} bytes; a job which needs more than
+ * that on its own is run with no other jobs in progress.  As each job
+ * completes, its rc and err fields are filled in and, if ${callback} is not
+ * NULL, callback(cookie, job) is invoked; it may be called from any of the
+ * threads, including concurrently.
+ *
+ * Return 0 once every job has been run (whether or not it succeeded); or -1
+ * if the batch could not be started, in which case no jobs were run.
+ */
+int crypto_scrypt_batch(struct crypto_scrypt_job *, size_t, uint32_t, size_t,
+    void (*)(void *, struct crypto_scrypt_job *), void *);
+
+/**
+ * crypto_scrypt_jobs(jobs, njobs):
+ * Run the scrypt computations *jobs[0 .. njobs - 1] on this thread, filling
+ * in their rc and err fields.  If the jobs share the same N and r, their SMix
+ * instances are interleaved; the memory used is then no more than the sum of
+ * crypto_scrypt_memory() for the jobs.  The value njobs must be at most 2.
+ */
+void crypto_scrypt_jobs(struct crypto_scrypt_job **, size_t);
+
+#endif /* !_CRYPTO_SCRYPT_BATCH_H_ */
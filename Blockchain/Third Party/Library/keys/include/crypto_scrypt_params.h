@@ -0,0 +1,33 @@
+#ifndef _CRYPTO_SCRYPT_PARAMS_H_
+#define _CRYPTO_SCRYPT_PARAMS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * crypto_scrypt_calibrate(opps, memavail):
+ * Store in ${opps} the number of salsa20/8 cores per second which one thread
+ * on this host computes within scrypt, and in ${memavail} the amount of
+ * memory which this process could use.  The first call measures these, which
+ * takes about a tenth of a second; later calls return the cached results.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_calibrate(double *, size_t *);
+
+/**
+ * crypto_scrypt_pickparams(maxmem, maxtime, N, r, p):
+ * Store in ${N}, ${r}, and ${p} the most expensive scrypt parameters which
+ * crypto_scrypt() on one thread of this host can compute in no more than
+ * ${maxtime} seconds with V taking no more than ${maxmem} bytes, or half of
+ * the memory available if ${maxmem} is zero or larger than that.  The memory
+ * cost is raised first; p is only raised beyond 1 once memory runs out.
+ * However slow or small the host, at least 2^15 salsa20/8 cores' worth of
+ * work and 1 MiB of memory are used.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int crypto_scrypt_pickparams(size_t, double, uint64_t *, uint32_t *,
+    uint32_t *);
+
+#endif /* !_CRYPTO_SCRYPT_PARAMS_H_ */
@@ -0,0 +1,80 @@
+#ifndef _CRYPTO_SCRYPT_SCHED_H_
+#define _CRYPTO_SCRYPT_SCHED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Job priorities, most urgent first. */
+#define CRYPTO_SCRYPT_PRIO_INTERACTIVE	0	/* Someone is waiting for it. */
+#define CRYPTO_SCRYPT_PRIO_BACKGROUND	1	/* Imports, prefetching, etc. */
+#define CRYPTO_SCRYPT_NPRIO		2
+
+/* Opaque scheduler; see crypto_scrypt_sched_init(). */
+struct crypto_scrypt_sched;
+
+/* A snapshot of a scheduler's state, from crypto_scrypt_sched_stats(). */
+struct crypto_scrypt_sched_stats {
+	/* Jobs submitted but not yet started, by priority. */
+	size_t queued[CRYPTO_SCRYPT_NPRIO];
+
+	/* Jobs running now, and the memory reserved for them. */
+	size_t running;
+	size_t inuse;
+
+	/* Most memory reserved at once since the scheduler was created. */
+	size_t inuse_peak;
+
+	/* Jobs started so far, and their time spent queued, by priority. */
+	uint64_t started[CRYPTO_SCRYPT_NPRIO];
+	uint64_t wait_ns[CRYPTO_SCRYPT_NPRIO];
+	uint64_t wait_max_ns[CRYPTO_SCRYPT_NPRIO];
+};
+
+/**
+ * crypto_scrypt_sched_init(maxmem, nworkers):
+ * Create a scheduler which runs scrypt computations on ${nworkers} threads
+ * of its own, starting them only while the memory reserved by all running
+ * jobs stays within ${maxmem} bytes.  A job which needs more than that is
+ * given ${maxmem} bytes and run with no other jobs in progress.  Waiting jobs
+ * are started in order of priority and then of submission; a job never
+ * overtakes one of higher priority, even if it would fit in the budget and
+ * the other won't.  If ${maxmem} is zero, jobs are limited only by the number
+ * of threads.
+ */
+struct crypto_scrypt_sched * crypto_scrypt_sched_init(size_t, uint32_t);
+
+/**
+ * crypto_scrypt_sched_need(N, r, p, nthreads):
+ * Return the number of bytes of memory which crypto_scrypt_threads() uses
+ * when called with the parameters N, r, p and ${nthreads}, and no limit on
+ * memory; or 0 if it would reject the parameters.
+ */
+size_t crypto_scrypt_sched_need(uint64_t, uint32_t, uint32_t, uint32_t);
+
+/**
+ * crypto_scrypt_sched_submit(S, need, prio, run, cookie):
+ * Queue a job needing ${need} bytes of memory with priority ${prio} (one of
+ * the CRYPTO_SCRYPT_PRIO_* values) on the scheduler ${S}.  Once it has been
+ * admitted, run(cookie, maxmem) is invoked on one of the scheduler's threads;
+ * it should pass ${maxmem}, which is the number of bytes reserved for it (no
+ * more than ${need}, and no more than the scheduler's budget), as the memory
+ * limit of the scrypt computation it performs.
+ */
+int crypto_scrypt_sched_submit(struct crypto_scrypt_sched *, size_t, int,
+    void (*)(void *, size_t), void *);
+
+/**
+ * crypto_scrypt_sched_stats(S, stats):
+ * Fill in ${stats} with the current state of the scheduler ${S}.
+ */
+void crypto_scrypt_sched_stats(struct crypto_scrypt_sched *,
+    struct crypto_scrypt_sched_stats *);
+
+/**
+ * crypto_scrypt_sched_free(S):
+ * Wait for every job submitted to ${S} to finish, then stop its threads and
+ * free it.
+ */
+void crypto_scrypt_sched_free(struct crypto_scrypt_sched *);
+
+#endif /* !_CRYPTO_SCRYPT_SCHED_H_ */
@@ -0,0 +1,191 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#ifndef _CRYPTO_SCRYPT_SMIX_H_
+#define _CRYPTO_SCRYPT_SMIX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Maximum number of computations crypto_scrypt_smix1_multi() interleaves. */
+#define SMIX_MULTI_MAX 4
+
+/*
+ * An SMix implementation, split into its two loops so that the caller can
+ * tell how long each takes, and taking a range of iterations of each loop so
+ * that the caller can report progress or stop part way through.  If r is
+ * non-zero, the functions only work for that value of r; if it is zero, they
+ * work for any r.
+ */
+struct smix_kernel {
+	size_t r;
+	void (*smix1)(uint8_t *, size_t, uint64_t, uint64_t, uint64_t,
+	    void *, void *);
+	void (*smix2)(uint8_t *, size_t, uint64_t, uint64_t, uint64_t,
+	    void *, void *);
+	void (*smix1_multi)(uint8_t **, size_t, size_t, uint64_t, uint64_t,
+	    uint64_t, void **, void **);
+	void (*smix2_multi)(uint8_t **, size_t, size_t, uint64_t, uint64_t,
+	    uint64_t, void **, void **);
+	void (*smix_tmto)(uint8_t *, size_t, uint64_t, uint64_t, void *,
+	    void *);
+};
+
+/*
+ * Force the building blocks of SMix to be inlined, so that the copies made
+ * by SMIX_FIXED_R have their loops over r and their block lengths fixed at
+ * compile time.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define SMIX_INLINE inline __attribute__((always_inline))
+#else
+#define SMIX_INLINE inline
+#endif
+
+/**
+ * SMIX_FIXED_R(R):
+ * Define static functions smix1_r${R}, smix2_r${R}, smix1_multi_r${R},
+ * smix2_multi_r${R} and smix_tmto_r${R} which call the inline functions
+ * smix1, smix2, smix1_multi, smix2_multi and smix_tmto with r fixed to ${R}.
+ */
+#define SMIX_FIXED_R(R)							\
+static void								\
+smix1_r##R(uint8_t * B, size_t r, uint64_t N, uint64_t i0, uint64_t i1,	\
+    void * V, void * XY)						\
+{									\
+									\
+	(void)r; /* UNUSED */						\
+	smix1(B, R, N, i0, i1, V, XY);					\
+}									\
+									\
+static void								\
+smix2_r##R(uint8_t * B, size_t r, uint64_t N, uint64_t i0, uint64_t i1,	\
+    void * V, void * XY)						\
+{									\
+									\
+	(void)r; /* UNUSED */						\
+	smix2(B, R, N, i0, i1, V, XY);					\
+}									\
+									\
+static void								\
+smix1_multi_r##R(uint8_t ** B, size_t n, size_t r, uint64_t N,		\
+    uint64_t i0, uint64_t i1, void ** V, void ** XY)			\
+{									\
+									\
+	(void)r; /* UNUSED */						\
+	smix1_multi(B, n, R, N, i0, i1, V, XY);				\
+}									\
+									\
+static void								\
+smix2_multi_r##R(uint8_t ** B, size_t n, size_t r, uint64_t N,		\
+    uint64_t i0, uint64_t i1, void ** V, void ** XY)			\
+{									\
+									\
+	(void)r; /* UNUSED */						\
+	smix2_multi(B, n, R, N, i0, i1, V, XY);				\
+}									\
+									\
+static void								\
+smix_tmto_r##R(uint8_t * B, size_t r, uint64_t N, uint64_t k, void * V,	\
+    void * XY)								\
+{									\
+									\
+	(void)r; /* UNUSED */						\
+	smix_tmto(B, R, N, k, V, XY);					\
+}
+
+/* The struct smix_kernel for the functions defined by SMIX_FIXED_R(R). */
+#define SMIX_KERNEL_R(R)						\
+	{ R, smix1_r##R, smix2_r##R, smix1_multi_r##R,			\
+	    smix2_multi_r##R, smix_tmto_r##R }
+
+/*
+ * SMix kernels using only portable C: copies specialized for r = 1, 8, and
+ * 16, followed by the generic crypto_scrypt_smix{1,2}{,_multi} with r = 0.
+ */
+extern const struct smix_kernel crypto_scrypt_smix_kernels[];
+
+/**
+ * crypto_scrypt_smix1(B, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the first loop of SMix_r(B, N),
+ * filling V_{i0} ... V_{i1 - 1}.  X is read from B if i0 is zero, and is
+ * otherwise the one left in the first 128r bytes of XY by the previous call;
+ * it is left there in turn for the next call or crypto_scrypt_smix2().  The
+ * input B must be 128r bytes in length; the temporary storage V must be
+ * 128rN bytes in length; the temporary storage XY must be 256r + 64 bytes in
+ * length.  The value N must be a power of 2 greater than 1, and i0 and i1
+ * must be even with i0 < i1 <= N.  The arrays B, V, and XY must be aligned
+ * to a multiple of 64 bytes.
+ */
+void crypto_scrypt_smix1(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+
+/**
+ * crypto_scrypt_smix2(B, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the second loop of SMix_r(B, N),
+ * continuing from the V and XY left by crypto_scrypt_smix1() or by the
+ * previous call, and write the result to B if i1 is N.
+ */
+void crypto_scrypt_smix2(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+
+/**
+ * crypto_scrypt_smix1_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the first loop of SMix_r(B[k], N) for
+ * k = 0 ... n - 1, where V[k] and XY[k] are the temporary storage for B[k]
+ * as described for crypto_scrypt_smix1().  The n computations are
+ * interleaved one BlockMix at a time.  The value n must be between 1 and
+ * SMIX_MULTI_MAX.
+ */
+void crypto_scrypt_smix1_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+
+/**
+ * crypto_scrypt_smix2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the second loop of SMix_r(B[k], N)
+ * for k = 0 ... n - 1, continuing from the V[k] and XY[k] left by
+ * crypto_scrypt_smix1_multi() or by the previous call, and write the results
+ * to B[k] if i1 is N.  The n computations are interleaved one BlockMix at a
+ * time, and the V_j block each computation needs next is prefetched as soon
+ * as j is known, so the memory latency of one computation is hidden behind
+ * the others' work.
+ */
+void crypto_scrypt_smix2_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+
+/**
+ * crypto_scrypt_smix_tmto(B, r, N, k, V, XY):
+ * Compute B = SMix_r(B, N), keeping only every ${k}th block of V and
+ * recomputing the others as they are needed.  The temporary storage V must
+ * be 128r(N/k + 2) bytes in length; the value k must be a power of 2 no
+ * greater than N; the other requirements are those of crypto_scrypt_smix1().
+ */
+void crypto_scrypt_smix_tmto(uint8_t *, size_t, uint64_t, uint64_t, void *,
+    void *);
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_H_ */
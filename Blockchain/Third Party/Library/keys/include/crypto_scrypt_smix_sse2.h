@@ -0,0 +1,97 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#ifndef _CRYPTO_SCRYPT_SMIX_SSE2_H_
+#define _CRYPTO_SCRYPT_SMIX_SSE2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crypto_scrypt_smix.h"
+
+/**
+ * crypto_scrypt_smix1_sse2(B, r, N, i0, i1, V, XY):
+ * Compute part of the first loop of SMix_r(B, N), as crypto_scrypt_smix1()
+ * does.  The X left in XY is in a different layout from the one which
+ * crypto_scrypt_smix1() leaves, so the computation must be continued by
+ * crypto_scrypt_smix1_sse2() and crypto_scrypt_smix2_sse2().
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void crypto_scrypt_smix1_sse2(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+
+/**
+ * crypto_scrypt_smix2_sse2(B, r, N, i0, i1, V, XY):
+ * Compute part of the second loop of SMix_r(B, N), as crypto_scrypt_smix2()
+ * does, continuing from the V and XY left by crypto_scrypt_smix1_sse2() or
+ * by the previous call.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void crypto_scrypt_smix2_sse2(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+
+/**
+ * crypto_scrypt_smix1_sse2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute part of the first loop of SMix_r(B[k], N) for k = 0 ... n - 1, as
+ * crypto_scrypt_smix1_multi() does, leaving X in the layout which
+ * crypto_scrypt_smix2_sse2_multi() expects.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void crypto_scrypt_smix1_sse2_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+
+/**
+ * crypto_scrypt_smix2_sse2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute part of the second loop of SMix_r(B[k], N) for k = 0 ... n - 1,
+ * as crypto_scrypt_smix2_multi() does, continuing from the V[k] and XY[k]
+ * left by crypto_scrypt_smix1_sse2_multi() or by the previous call.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void crypto_scrypt_smix2_sse2_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+
+/**
+ * crypto_scrypt_smix_tmto_sse2(B, r, N, k, V, XY):
+ * Compute B = SMix_r(B, N), as crypto_scrypt_smix_tmto() does.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void crypto_scrypt_smix_tmto_sse2(uint8_t *, size_t, uint64_t, uint64_t,
+    void *, void *);
+
+/*
+ * SMix kernels using SSE2, laid out as crypto_scrypt_smix_kernels[] is.  The
+ * caller must check that the CPU supports SSE2.
+ */
+extern const struct smix_kernel crypto_scrypt_smix_sse2_kernels[];
+
+#endif /* !_CRYPTO_SCRYPT_SMIX_SSE2_H_ */
@@ -0,0 +1,23 @@
+#ifndef _HEXIFY_AVX2_H_
+#define _HEXIFY_AVX2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * hexify_avx2(in, out, nblocks):
+ * Convert ${nblocks} 32-byte blocks from ${in} into lower-case hexadecimal,
+ * writing 64 * ${nblocks} characters to ${out}, using AVX2.
+ */
+void hexify_avx2(const uint8_t *, char *, size_t);
+
+/**
+ * unhexify_avx2(in, out, nblocks):
+ * Convert 64 * ${nblocks} hexadecimal characters from ${in} to ${nblocks}
+ * 32-byte blocks and write them to ${out}, using AVX2.
+ *
+ * Return 0 on success; or -1 if any of the characters are not hexadecimal.
+ */
+int unhexify_avx2(const char *, uint8_t *, size_t);
+
+#endif /* !_HEXIFY_AVX2_H_ */
@@ -0,0 +1,23 @@
+#ifndef _HEXIFY_SSSE3_H_
+#define _HEXIFY_SSSE3_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * hexify_ssse3(in, out, nblocks):
+ * Convert ${nblocks} 16-byte blocks from ${in} into lower-case hexadecimal,
+ * writing 32 * ${nblocks} characters to ${out}, using SSSE3.
+ */
+void hexify_ssse3(const uint8_t *, char *, size_t);
+
+/**
+ * unhexify_ssse3(in, out, nblocks):
+ * Convert 32 * ${nblocks} hexadecimal characters from ${in} to ${nblocks}
+ * 16-byte blocks and write them to ${out}, using SSSE3.
+ *
+ * Return 0 on success; or -1 if any of the characters are not hexadecimal.
+ */
+int unhexify_ssse3(const char *, uint8_t *, size_t);
+
+#endif /* !_HEXIFY_SSSE3_H_ */
@@ -0,0 +1,15 @@
+#ifndef _INSECURE_MEMZERO_H_
+#define _INSECURE_MEMZERO_H_
+
+#include <stddef.h>
+
+/**
+ * insecure_memzero(buf, len):
+ * Zero ${len} bytes at ${buf} in a way which the compiler will not optimize
+ * away even if ${buf} is never read again.  This is "insecure" in that it
+ * makes no attempt to clear copies of the data held in registers, on the
+ * stack, or in swap.
+ */
+void insecure_memzero(void *, size_t);
+
+#endif /* !_INSECURE_MEMZERO_H_ */
@@ -0,0 +1,69 @@
+#ifndef _SHA1_H_
+#define _SHA1_H_
+
+#include <sys/types.h>
+
+#include <stdint.h>
+
+/*
+ * Use #defines in order to avoid namespace collisions with anyone else's
+ * SHA1 code (e.g., the code in OpenSSL, which the app also links).
+ */
+#define SHA1_Init keys_SHA1_Init
+#define SHA1_Update keys_SHA1_Update
+#define SHA1_Final keys_SHA1_Final
+#define SHA1_CTX keys_SHA1_CTX
+#define SHA1Context keys_SHA1Context
+
+typedef struct SHA1Context {
+	uint32_t state[5];
+	uint64_t count;
+	uint8_t buf[64];
+} SHA1_CTX;
+
+/**
+ * SHA1_Init(ctx):
+ * Initialize the SHA1 context ${ctx}.
+ */
+void	SHA1_Init(SHA1_CTX *);
+
+/**
+ * SHA1_Update(ctx, in, len):
+ * Input ${len} bytes from ${in} into the SHA1 context ${ctx}.
+ */
+void	SHA1_Update(SHA1_CTX *, const void *, size_t);
+
+/**
+ * SHA1_Final(digest, ctx):
+ * Output the SHA1 hash of the data input to the context ${ctx} into the
+ * buffer ${digest}, and clear the context state.
+ */
+void	SHA1_Final(unsigned char [20], SHA1_CTX *);
+
+typedef struct HMAC_SHA1Context {
+	SHA1_CTX ictx;
+	SHA1_CTX octx;
+} HMAC_SHA1_CTX;
+
+void	HMAC_SHA1_Init(HMAC_SHA1_CTX *, const void *, size_t);
+void	HMAC_SHA1_Update(HMAC_SHA1_CTX *, const void *, size_t);
+void	HMAC_SHA1_Final(unsigned char [20], HMAC_SHA1_CTX *);
+
+/**
+ * PBKDF2_SHA1(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA1 as the PRF, and
+ * write the output to buf.  The value dkLen must be at most 20 * (2^32 - 1).
+ */
+void	PBKDF2_SHA1(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t);
+
+/**
+ * PBKDF2_SHA1_Keyed(Pctx, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA1() does, where
+ * ${Pctx} is the result of HMAC_SHA1_Init(Pctx, passwd, passwdlen) with no
+ * data added yet.  ${Pctx} is not modified.
+ */
+void	PBKDF2_SHA1_Keyed(const HMAC_SHA1_CTX *, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t);
+
+#endif /* !_SHA1_H_ */
@@ -0,0 +1,13 @@
+#ifndef _SHA1_ARM_H_
+#define _SHA1_ARM_H_
+
+#include <stdint.h>
+
+/**
+ * SHA1_Transform_arm(state, block):
+ * Compress the 64-byte ${block} into the SHA1 ${state}, using the ARMv8
+ * cryptography extensions.
+ */
+void SHA1_Transform_arm(uint32_t[5], const uint8_t[64]);
+
+#endif /* !_SHA1_ARM_H_ */
@@ -0,0 +1,13 @@
+#ifndef _SHA1_SHANI_H_
+#define _SHA1_SHANI_H_
+
+#include <stdint.h>
+
+/**
+ * SHA1_Transform_shani(state, block):
+ * Compress the 64-byte ${block} into the SHA1 ${state}, using the x86 SHA
+ * extensions.
+ */
+void SHA1_Transform_shani(uint32_t[5], const uint8_t[64]);
+
+#endif /* !_SHA1_SHANI_H_ */
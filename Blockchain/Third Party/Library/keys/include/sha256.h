@@ -30,9 +30,44 @@
 #define _SHA256_H_
 
 #include <sys/types.h>
-#include <openssl/sha.h>
+
 #include <stdint.h>
 
+/*
+ * Use #defines in order to avoid namespace collisions with anyone else's
+ * SHA256 code (e.g., the code in OpenSSL, which the app also links).
+ */
+#define SHA256_Init keys_SHA256_Init
+#define SHA256_Update keys_SHA256_Update
+#define SHA256_Final keys_SHA256_Final
+#define SHA256_CTX keys_SHA256_CTX
+#define SHA256Context keys_SHA256Context
+
+typedef struct SHA256Context {
+	uint32_t state[8];
+	uint64_t count;
+	uint8_t buf[64];
+} SHA256_CTX;
+
+/**
+ * SHA256_Init(ctx):
+ * Initialize the SHA256 context ${ctx}.
+ */
+void	SHA256_Init(SHA256_CTX *);
+
+/**
+ * SHA256_Update(ctx, in, len):
+ * Input ${len} bytes from ${in} into the SHA256 context ${ctx}.
+ */
+void	SHA256_Update(SHA256_CTX *, const void *, size_t);
+
+/**
+ * SHA256_Final(digest, ctx):
+ * Output the SHA256 hash of the data input to the context ${ctx} into the
+ * buffer ${digest}, and clear the context state.
+ */
+void	SHA256_Final(unsigned char [32], SHA256_CTX *);
+
 typedef struct HMAC_SHA256Context {
 	SHA256_CTX ictx;
 	SHA256_CTX octx;
@@ -42,6 +77,17 @@ void	HMAC_SHA256_Init(HMAC_SHA256_CTX *, const void *, size_t);
 void	HMAC_SHA256_Update(HMAC_SHA256_CTX *, const void *, size_t);
 void	HMAC_SHA256_Final(unsigned char [32], HMAC_SHA256_CTX *);
 
+/**
+ * HMAC_SHA256_Batch(ctx, in, inlen, n, out):
+ * Compute HMAC-SHA256(K, in[i][0 .. inlen[i] - 1]) for each i < ${n}, where
+ * ${ctx} is the result of HMAC_SHA256_Init(ctx, K, Klen) with no data added
+ * yet, and write them to out[32 * i .. 32 * i + 31].  The messages are
+ * hashed side by side, several at a time if the CPU has SIMD instructions
+ * for it; this is fastest when they are about the same length.
+ */
+void	HMAC_SHA256_Batch(const HMAC_SHA256_CTX *, const uint8_t * const *,
+    const size_t *, size_t, uint8_t *);
+
 /**
  * PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
  * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA256 as the PRF, and
@@ -50,4 +96,26 @@ void	HMAC_SHA256_Final(unsigned char [32], HMAC_SHA256_CTX *);
 void	PBKDF2_SHA256(const uint8_t *, size_t, const uint8_t *, size_t,
     uint64_t, uint8_t *, size_t);
 
+/**
+ * PBKDF2_SHA256_Keyed(Pctx, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA256() does, where
+ * ${Pctx} is the result of HMAC_SHA256_Init(Pctx, passwd, passwdlen) with no
+ * data added yet.  This lets several computations with the same password
+ * share the work of keying HMAC.  ${Pctx} is not modified.
+ */
+void	PBKDF2_SHA256_Keyed(const HMAC_SHA256_CTX *, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t);
+
+/**
+ * PBKDF2_SHA256_threads(passwd, passwdlen, salt, saltlen, c, buf, dkLen,
+ *     nthreads):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA256() does, sharing
+ * the output blocks out among up to ${nthreads} threads; each thread hashes
+ * a whole vector of blocks at a time if the CPU has SIMD code for it.  The
+ * output is the same as PBKDF2_SHA256()'s.  If threads can't be started, the
+ * work is done in this thread.
+ */
+void	PBKDF2_SHA256_threads(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t, uint32_t);
+
 #endif /* !_SHA256_H_ */
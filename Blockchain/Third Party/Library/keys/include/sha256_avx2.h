@@ -0,0 +1,15 @@
+#ifndef _SHA256_AVX2_H_
+#define _SHA256_AVX2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * SHA256_Compress8_avx2(S, stride, blocks):
+ * Compress the 64-byte blocks blocks[0 .. 7] into 8 SHA256 states which
+ * are interleaved in ${S}: word w of the state for blocks[l] is at
+ * S[w * stride + l].
+ */
+void SHA256_Compress8_avx2(uint32_t *, size_t, const uint8_t * const *);
+
+#endif /* !_SHA256_AVX2_H_ */
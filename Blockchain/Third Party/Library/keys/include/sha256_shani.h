@@ -0,0 +1,13 @@
+#ifndef _SHA256_SHANI_H_
+#define _SHA256_SHANI_H_
+
+#include <stdint.h>
+
+/**
+ * SHA256_Transform_shani(state, block):
+ * Compress the 64-byte ${block} into the SHA256 ${state}, using the x86
+ * SHA extensions.
+ */
+void SHA256_Transform_shani(uint32_t[8], const uint8_t[64]);
+
+#endif /* !_SHA256_SHANI_H_ */
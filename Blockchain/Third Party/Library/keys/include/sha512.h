@@ -0,0 +1,69 @@
+#ifndef _SHA512_H_
+#define _SHA512_H_
+
+#include <sys/types.h>
+
+#include <stdint.h>
+
+/*
+ * Use #defines in order to avoid namespace collisions with anyone else's
+ * SHA512 code (e.g., the code in OpenSSL, which the app also links).
+ */
+#define SHA512_Init keys_SHA512_Init
+#define SHA512_Update keys_SHA512_Update
+#define SHA512_Final keys_SHA512_Final
+#define SHA512_CTX keys_SHA512_CTX
+#define SHA512Context keys_SHA512Context
+
+typedef struct SHA512Context {
+	uint64_t state[8];
+	uint64_t count[2];	/* Bits processed, low word first. */
+	uint8_t buf[128];
+} SHA512_CTX;
+
+/**
+ * SHA512_Init(ctx):
+ * Initialize the SHA512 context ${ctx}.
+ */
+void	SHA512_Init(SHA512_CTX *);
+
+/**
+ * SHA512_Update(ctx, in, len):
+ * Input ${len} bytes from ${in} into the SHA512 context ${ctx}.
+ */
+void	SHA512_Update(SHA512_CTX *, const void *, size_t);
+
+/**
+ * SHA512_Final(digest, ctx):
+ * Output the SHA512 hash of the data input to the context ${ctx} into the
+ * buffer ${digest}, and clear the context state.
+ */
+void	SHA512_Final(unsigned char [64], SHA512_CTX *);
+
+typedef struct HMAC_SHA512Context {
+	SHA512_CTX ictx;
+	SHA512_CTX octx;
+} HMAC_SHA512_CTX;
+
+void	HMAC_SHA512_Init(HMAC_SHA512_CTX *, const void *, size_t);
+void	HMAC_SHA512_Update(HMAC_SHA512_CTX *, const void *, size_t);
+void	HMAC_SHA512_Final(unsigned char [64], HMAC_SHA512_CTX *);
+
+/**
+ * PBKDF2_SHA512(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA512 as the PRF, and
+ * write the output to buf.  The value dkLen must be at most 64 * (2^32 - 1).
+ */
+void	PBKDF2_SHA512(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t);
+
+/**
+ * PBKDF2_SHA512_Keyed(Pctx, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA512() does, where
+ * ${Pctx} is the result of HMAC_SHA512_Init(Pctx, passwd, passwdlen) with no
+ * data added yet.  ${Pctx} is not modified.
+ */
+void	PBKDF2_SHA512_Keyed(const HMAC_SHA512_CTX *, const uint8_t *, size_t,
+    uint64_t, uint8_t *, size_t);
+
+#endif /* !_SHA512_H_ */
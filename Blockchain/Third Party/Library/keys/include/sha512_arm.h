@@ -0,0 +1,13 @@
+#ifndef _SHA512_ARM_H_
+#define _SHA512_ARM_H_
+
+#include <stdint.h>
+
+/**
+ * SHA512_Transform_arm(state, block):
+ * Compress the 128-byte ${block} into the SHA512 ${state}, using the ARMv8.2
+ * SHA512 instructions.
+ */
+void SHA512_Transform_arm(uint64_t[8], const uint8_t[128]);
+
+#endif /* !_SHA512_ARM_H_ */
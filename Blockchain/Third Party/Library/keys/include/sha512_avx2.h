@@ -0,0 +1,15 @@
+#ifndef _SHA512_AVX2_H_
+#define _SHA512_AVX2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * SHA512_Compress4_avx2(S, stride, blocks):
+ * Compress the 128-byte blocks blocks[0 .. 3] into 4 SHA512 states which
+ * are interleaved in ${S}: word w of the state for blocks[l] is at
+ * S[w * stride + l].
+ */
+void SHA512_Compress4_avx2(uint64_t *, size_t, const uint8_t * const *);
+
+#endif /* !_SHA512_AVX2_H_ */
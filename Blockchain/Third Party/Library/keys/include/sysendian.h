@@ -137,4 +137,96 @@ le64enc(void *pp, uint64_t x)
 }
 #endif /* !HAVE_SYS_ENDIAN_H */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Bulk conversions of ${n} 32-bit words between ${dst} and ${src}, which must
+ * not overlap.  Converting to or from the host's own byte order is a plain
+ * copy and the other order is a byte swap of each word, which compilers
+ * vectorize; so we pick one or the other at compile time if the compiler
+ * tells us the host's byte order, and otherwise go a word at a time.
+ */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SYSENDIAN_HOST_LE 1
+#elif defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define SYSENDIAN_HOST_BE 1
+#endif
+
+#if defined(SYSENDIAN_HOST_LE) || defined(SYSENDIAN_HOST_BE)
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static inline void
+sysendian_bswap32_vec(void * dst, const void * src, size_t n)
+{
+	uint8_t * d = (uint8_t *)dst;
+	const uint8_t * s = (const uint8_t *)src;
+	uint32_t x;
+	size_t i = 0;
+
+#if defined(__ARM_NEON)
+	for (; i + 4 <= n; i += 4)
+		vst1q_u8(&d[i * 4], vrev32q_u8(vld1q_u8(&s[i * 4])));
+#endif
+	for (; i < n; i++) {
+		memcpy(&x, &s[i * 4], 4);
+		x = __builtin_bswap32(x);
+		memcpy(&d[i * 4], &x, 4);
+	}
+}
+#endif
+
+static inline void
+le32dec_vec(uint32_t * dst, const void * src, size_t n)
+{
+#if defined(SYSENDIAN_HOST_LE)
+	memcpy(dst, src, n * 4);
+#elif defined(SYSENDIAN_HOST_BE)
+	sysendian_bswap32_vec(dst, src, n);
+#else
+	const uint8_t * p = (const uint8_t *)src;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = le32dec(&p[i * 4]);
+#endif
+}
+
+static inline void
+le32enc_vec(void * dst, const uint32_t * src, size_t n)
+{
+#if defined(SYSENDIAN_HOST_LE)
+	memcpy(dst, src, n * 4);
+#elif defined(SYSENDIAN_HOST_BE)
+	sysendian_bswap32_vec(dst, src, n);
+#else
+	uint8_t * p = (uint8_t *)dst;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		le32enc(&p[i * 4], src[i]);
+#endif
+}
+
+static inline void
+be32dec_vec(uint32_t * dst, const void * src, size_t n)
+{
+#if defined(SYSENDIAN_HOST_BE)
+	memcpy(dst, src, n * 4);
+#elif defined(SYSENDIAN_HOST_LE)
+	sysendian_bswap32_vec(dst, src, n);
+#else
+	const uint8_t * p = (const uint8_t *)src;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = be32dec(&p[i * 4]);
+#endif
+}
+
 #endif /* !_SYSENDIAN_H_ */
@@ -0,0 +1,109 @@
+#include "scrypt_platform.h"
+
+#include "cpusupport.h"
+
+#if defined(CPUSUPPORT_ARM_SHA1) || defined(CPUSUPPORT_ARM_SHA256) || \
+    defined(CPUSUPPORT_ARM_SHA512)
+#if defined(__linux__)
+#include <sys/auxv.h>
+
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#ifndef HWCAP_SHA512
+#define HWCAP_SHA512 (1 << 21)
+#endif
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+
+#include <stddef.h>
+#endif
+#endif
+
+#ifdef CPUSUPPORT_ARM_NEON
+/**
+ * cpusupport_arm_neon(void):
+ * Return non-zero if the CPU supports the Advanced SIMD (NEON) instructions.
+ */
+int
+cpusupport_arm_neon(void)
+{
+
+	/* They are a mandatory part of ARMv8-A. */
+	return (1);
+}
+#endif /* CPUSUPPORT_ARM_NEON */
+
+#ifdef CPUSUPPORT_ARM_SHA1
+/**
+ * cpusupport_arm_sha1(void):
+ * Return non-zero if the CPU supports the ARMv8 SHA1 instructions.
+ */
+int
+cpusupport_arm_sha1(void)
+{
+
+#if defined(__linux__)
+	/* Ask the kernel what the CPU can do. */
+	return ((getauxval(AT_HWCAP) & HWCAP_SHA1) ? 1 : 0);
+#else
+	/* As for SHA256, below. */
+	return (1);
+#endif
+}
+#endif /* CPUSUPPORT_ARM_SHA1 */
+
+#ifdef CPUSUPPORT_ARM_SHA256
+/**
+ * cpusupport_arm_sha256(void):
+ * Return non-zero if the CPU supports the ARMv8 SHA256 instructions.
+ */
+int
+cpusupport_arm_sha256(void)
+{
+
+#if defined(__linux__)
+	/* Ask the kernel what the CPU can do. */
+	return ((getauxval(AT_HWCAP) & HWCAP_SHA2) ? 1 : 0);
+#else
+	/*
+	 * Elsewhere (e.g., on Apple platforms) there is no portable way to
+	 * ask, but we only get here if the compiler was told that every CPU
+	 * we run on has them.
+	 */
+	return (1);
+#endif
+}
+#endif /* CPUSUPPORT_ARM_SHA256 */
+
+#ifdef CPUSUPPORT_ARM_SHA512
+/**
+ * cpusupport_arm_sha512(void):
+ * Return non-zero if the CPU supports the ARMv8.2 SHA512 instructions.
+ */
+int
+cpusupport_arm_sha512(void)
+{
+#if defined(__linux__)
+
+	/* Ask the kernel what the CPU can do. */
+	return ((getauxval(AT_HWCAP) & HWCAP_SHA512) ? 1 : 0);
+#elif defined(__APPLE__)
+	int val = 0;
+	size_t len = sizeof(val);
+
+	/* Ask the kernel what the CPU can do. */
+	if (sysctlbyname("hw.optional.armv8_2_sha512", &val, &len, NULL, 0))
+		return (0);
+	return (val ? 1 : 0);
+#else
+
+	/* The compiler was told that every CPU we run on has them. */
+	return (1);
+#endif
+}
+#endif /* CPUSUPPORT_ARM_SHA512 */
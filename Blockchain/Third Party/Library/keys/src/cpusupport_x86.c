@@ -0,0 +1,110 @@
+#include "scrypt_platform.h"
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_CPUID
+#include <cpuid.h>
+#include <stddef.h>
+
+#define CPUID_SSE2_BIT (1 << 26)
+#define CPUID_SSSE3_BIT (1 << 9)
+#define CPUID_OSXSAVE_BIT (1 << 27)
+#define CPUID_AVX_BIT (1 << 28)
+#define CPUID_AVX2_BIT (1 << 5)
+#define CPUID_SHANI_BIT (1 << 29)
+
+/* XCR0 bits saying that the OS saves the XMM and YMM registers. */
+#define XCR0_SSE_AVX (0x2 | 0x4)
+
+#ifdef CPUSUPPORT_X86_SSE2
+/**
+ * cpusupport_x86_sse2(void):
+ * Return non-zero if the CPU supports SSE2.
+ */
+int
+cpusupport_x86_sse2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* Check if CPUID supports the level we need. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return (0);
+
+	/* Return the relevant feature bit. */
+	return ((edx & CPUID_SSE2_BIT) ? 1 : 0);
+}
+#endif /* CPUSUPPORT_X86_SSE2 */
+
+#ifdef CPUSUPPORT_X86_SSSE3
+/**
+ * cpusupport_x86_ssse3(void):
+ * Return non-zero if the CPU supports SSSE3.
+ */
+int
+cpusupport_x86_ssse3(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* Check if CPUID supports the level we need. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return (0);
+
+	/* Return the relevant feature bit. */
+	return ((ecx & CPUID_SSSE3_BIT) ? 1 : 0);
+}
+#endif /* CPUSUPPORT_X86_SSSE3 */
+
+#ifdef CPUSUPPORT_X86_AVX2
+/**
+ * cpusupport_x86_avx2(void):
+ * Return non-zero if the CPU supports AVX2, and the OS preserves the YMM
+ * registers across context switches.
+ */
+int
+cpusupport_x86_avx2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* Check if CPUID supports the levels we need. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return (0);
+	if (__get_cpuid_max(0, NULL) < 7)
+		return (0);
+
+	/* We need AVX, and XGETBV to ask whether the OS supports it. */
+	if ((ecx & (CPUID_OSXSAVE_BIT | CPUID_AVX_BIT)) !=
+	    (CPUID_OSXSAVE_BIT | CPUID_AVX_BIT))
+		return (0);
+
+	/* Does the OS save the XMM and YMM registers? */
+	__asm__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	if ((eax & XCR0_SSE_AVX) != XCR0_SSE_AVX)
+		return (0);
+
+	/* Return the relevant feature bit. */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return ((ebx & CPUID_AVX2_BIT) ? 1 : 0);
+}
+#endif /* CPUSUPPORT_X86_AVX2 */
+
+#ifdef CPUSUPPORT_X86_SHANI
+/**
+ * cpusupport_x86_shani(void):
+ * Return non-zero if the CPU supports the SHA extensions.
+ */
+int
+cpusupport_x86_shani(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* Check if CPUID supports the level we need. */
+	if (__get_cpuid_max(0, NULL) < 7)
+		return (0);
+
+	/* Return the relevant feature bit. */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return ((ebx & CPUID_SHANI_BIT) ? 1 : 0);
+}
+#endif /* CPUSUPPORT_X86_SHANI */
+
+#endif /* CPUSUPPORT_X86_CPUID */
@@ -0,0 +1,387 @@
+#include "scrypt_platform.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "insecure_memzero.h"
+#include "sha256.h"
+#include "sysendian.h"
+
+#include "crypto_keycache.h"
+
+/* A cached key. */
+struct entry {
+	uint8_t id[32];
+	uint64_t expires_ns;	/* 0 if the entry is empty. */
+	size_t len;
+	uint8_t key[CRYPTO_KEYCACHE_MAXKEY];
+};
+
+/*
+ * Everything secret, i.e. the keys and the key which identifiers are hashed
+ * with, lives in the locked pages at ${locked}; the rest is ordinary memory.
+ */
+struct locked {
+	uint8_t hkey[32];
+	struct entry E[];
+};
+
+struct crypto_keycache {
+	pthread_mutex_t mtx;
+	struct locked * locked;
+	size_t lockedlen;
+	size_t nentries;
+	uint64_t ttl_ns;
+	uint64_t epoch;		/* Number of flushes so far. */
+};
+
+static uint64_t now_ns(void);
+static int readrandom(uint8_t *, size_t);
+static void expire(struct crypto_keycache *, uint64_t);
+
+/**
+ * now_ns(void):
+ * Return the time in nanoseconds according to a monotonic clock.
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return (0);
+	return ((uint64_t)(ts.tv_sec) * 1000000000 + (uint64_t)(ts.tv_nsec));
+}
+
+/**
+ * readrandom(buf, buflen):
+ * Fill ${buf} with ${buflen} random bytes from the kernel.
+ */
+static int
+readrandom(uint8_t * buf, size_t buflen)
+{
+	ssize_t lenread;
+	int fd;
+
+	/* Open the random device... */
+	if ((fd = open("/dev/urandom", O_RDONLY)) == -1)
+		goto err0;
+
+	/* ... and read until we have enough. */
+	while (buflen > 0) {
+		if ((lenread = read(fd, buf, buflen)) == -1) {
+			if (errno == EINTR)
+				continue;
+			goto err1;
+		}
+		if (lenread == 0)
+			goto err1;
+		buf += lenread;
+		buflen -= (size_t)lenread;
+	}
+
+	/* Clean up. */
+	close(fd);
+
+	/* Success! */
+	return (0);
+
+err1:
+	close(fd);
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * expire(C, now):
+ * Zero the entries in ${C} which had expired by ${now}.  Must be called with
+ * ${C}'s mutex held.
+ */
+static void
+expire(struct crypto_keycache * C, uint64_t now)
+{
+	struct entry * E;
+	size_t i;
+
+	for (i = 0; i < C->nentries; i++) {
+		E = &C->locked->E[i];
+		if ((E->expires_ns != 0) && (E->expires_ns <= now))
+			insecure_memzero(E, sizeof(struct entry));
+	}
+}
+
+/**
+ * crypto_keycache_init(nentries, ttl):
+ * Create a cache which holds up to ${nentries} derived keys, each for at most
+ * ${ttl} seconds after it was added.  The keys live in memory which is locked
+ * so that it is never swapped out, and are zeroed when they expire, are
+ * evicted, or are flushed.  Return NULL if the memory cannot be locked.
+ */
+struct crypto_keycache *
+crypto_keycache_init(size_t nentries, double ttl)
+{
+	struct crypto_keycache * C;
+	void * p;
+
+	/* Sanity-check the size. */
+	if ((nentries == 0) || (nentries >
+	    (SIZE_MAX - sizeof(struct locked)) / sizeof(struct entry))) {
+		errno = EINVAL;
+		goto err0;
+	}
+
+	/* Allocate the cache. */
+	if ((C = malloc(sizeof(struct crypto_keycache))) == NULL)
+		goto err0;
+	C->nentries = nentries;
+	C->ttl_ns = (uint64_t)(ttl * 1e9);
+	C->epoch = 0;
+	C->lockedlen = sizeof(struct locked) + nentries * sizeof(struct entry);
+
+	/*
+	 * Get pages of our own for the secrets, and lock them.  Anonymous
+	 * pages start out zeroed, i.e., with every entry empty.
+	 */
+	if ((p = mmap(NULL, C->lockedlen, PROT_READ | PROT_WRITE,
+#ifdef MAP_NOCORE
+	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
+#else
+	    MAP_ANON | MAP_PRIVATE,
+#endif
+	    -1, 0)) == MAP_FAILED)
+		goto err1;
+	C->locked = p;
+	if (mlock(C->locked, C->lockedlen))
+		goto err2;
+#ifdef MADV_DONTDUMP
+	(void)madvise(C->locked, C->lockedlen, MADV_DONTDUMP);
+#endif
+
+	/* Pick the key which identifiers are hashed with. */
+	if (readrandom(C->locked->hkey, sizeof(C->locked->hkey)))
+		goto err3;
+
+	if ((errno = pthread_mutex_init(&C->mtx, NULL)) != 0)
+		goto err3;
+
+	/* Success! */
+	return (C);
+
+err3:
+	insecure_memzero(C->locked, C->lockedlen);
+	munlock(C->locked, C->lockedlen);
+err2:
+	munmap(C->locked, C->lockedlen);
+err1:
+	free(C);
+err0:
+	/* Failure! */
+	return (NULL);
+}
+
+/**
+ * crypto_keycache_id(C, alg, params, nparams, passwd, passwdlen, salt,
+ *     saltlen, id):
+ * Compute in ${id} the identifier in ${C} of the key derived by the algorithm
+ * named ${alg} with the parameters params[0 .. ${nparams} - 1] from
+ * ${passwd} and ${salt}.  This is a hash keyed with a secret random value
+ * which belongs to ${C}, so it reveals nothing about the password.
+ */
+void
+crypto_keycache_id(struct crypto_keycache * C, const char * alg,
+    const uint64_t * params, size_t nparams, const uint8_t * passwd,
+    size_t passwdlen, const uint8_t * salt, size_t saltlen, uint8_t id[32])
+{
+	HMAC_SHA256_CTX ctx;
+	uint8_t lenbuf[8];
+	size_t i;
+
+	/*
+	 * Hash the name (with its NUL), then the parameters, password and
+	 * salt, each preceded by its length, so that no two different sets
+	 * of inputs are hashed as the same string.
+	 */
+	HMAC_SHA256_Init(&ctx, C->locked->hkey, sizeof(C->locked->hkey));
+	HMAC_SHA256_Update(&ctx, alg, strlen(alg) + 1);
+	be64enc(lenbuf, (uint64_t)nparams);
+	HMAC_SHA256_Update(&ctx, lenbuf, 8);
+	for (i = 0; i < nparams; i++) {
+		be64enc(lenbuf, params[i]);
+		HMAC_SHA256_Update(&ctx, lenbuf, 8);
+	}
+	be64enc(lenbuf, (uint64_t)passwdlen);
+	HMAC_SHA256_Update(&ctx, lenbuf, 8);
+	HMAC_SHA256_Update(&ctx, passwd, passwdlen);
+	be64enc(lenbuf, (uint64_t)saltlen);
+	HMAC_SHA256_Update(&ctx, lenbuf, 8);
+	HMAC_SHA256_Update(&ctx, salt, saltlen);
+	HMAC_SHA256_Final(id, &ctx);
+
+	/* Clean the stack. */
+	insecure_memzero(&ctx, sizeof(HMAC_SHA256_CTX));
+}
+
+/**
+ * crypto_keycache_get(C, id, buf, buflen):
+ * If ${C} holds a ${buflen}-byte key with the identifier ${id} which has not
+ * expired, copy it into ${buf}.
+ *
+ * Return 0 if the key was found; or -1 otherwise.
+ */
+int
+crypto_keycache_get(struct crypto_keycache * C, const uint8_t id[32],
+    uint8_t * buf, size_t buflen)
+{
+	struct entry * E;
+	size_t i;
+	int rc = -1;
+
+	pthread_mutex_lock(&C->mtx);
+
+	/* Get rid of anything stale, so that what's left is still valid. */
+	expire(C, now_ns());
+
+	/* Look for the key. */
+	for (i = 0; i < C->nentries; i++) {
+		E = &C->locked->E[i];
+		if ((E->expires_ns != 0) && (E->len == buflen) &&
+		    (memcmp(E->id, id, 32) == 0)) {
+			memcpy(buf, E->key, buflen);
+			rc = 0;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&C->mtx);
+
+	return (rc);
+}
+
+/**
+ * crypto_keycache_epoch(C):
+ * Return the number of times ${C} has been flushed.  A caller which reads
+ * this before it derives a key and passes it to crypto_keycache_put() can't
+ * add the key to the cache after a flush which was meant to get rid of it.
+ */
+uint64_t
+crypto_keycache_epoch(struct crypto_keycache * C)
+{
+	uint64_t epoch;
+
+	pthread_mutex_lock(&C->mtx);
+	epoch = C->epoch;
+	pthread_mutex_unlock(&C->mtx);
+
+	return (epoch);
+}
+
+/**
+ * crypto_keycache_put(C, epoch, id, buf, buflen):
+ * Add the ${buflen}-byte key ${buf} to ${C} with the identifier ${id},
+ * replacing any key it already holds with that identifier, or else an
+ * expired key, or else the key which would expire first.  Keys longer than
+ * CRYPTO_KEYCACHE_MAXKEY bytes are not cached, and nor are keys if ${C} has
+ * been flushed since crypto_keycache_epoch() returned ${epoch}.
+ */
+void
+crypto_keycache_put(struct crypto_keycache * C, uint64_t epoch,
+    const uint8_t id[32], const uint8_t * buf, size_t buflen)
+{
+	struct entry * E;
+	struct entry * victim = NULL;
+	uint64_t now;
+	size_t i;
+
+	/* Too long to fit? */
+	if (buflen > CRYPTO_KEYCACHE_MAXKEY)
+		return;
+
+	pthread_mutex_lock(&C->mtx);
+
+	/* Was the key derived before a flush? */
+	if (C->epoch != epoch)
+		goto done;
+
+	/* Expired entries become empty ones. */
+	expire(C, now = now_ns());
+
+	/* Use the entry with this identifier, or else the best to evict. */
+	for (i = 0; i < C->nentries; i++) {
+		E = &C->locked->E[i];
+		if ((E->expires_ns != 0) && (memcmp(E->id, id, 32) == 0)) {
+			victim = E;
+			break;
+		}
+		if ((victim == NULL) || (E->expires_ns < victim->expires_ns))
+			victim = E;
+	}
+
+	/* Replace it. */
+	insecure_memzero(victim, sizeof(struct entry));
+	memcpy(victim->id, id, 32);
+	memcpy(victim->key, buf, buflen);
+	victim->len = buflen;
+	victim->expires_ns = now + C->ttl_ns;
+
+done:
+	pthread_mutex_unlock(&C->mtx);
+}
+
+/**
+ * crypto_keycache_expire(C):
+ * Zero the keys in ${C} which have expired.  Expired keys are never returned
+ * in any case, but are only zeroed when the cache is next used or this is
+ * called.
+ */
+void
+crypto_keycache_expire(struct crypto_keycache * C)
+{
+
+	pthread_mutex_lock(&C->mtx);
+	expire(C, now_ns());
+	pthread_mutex_unlock(&C->mtx);
+}
+
+/**
+ * crypto_keycache_flush(C):
+ * Zero all of the keys in ${C}, and keep out any which were being derived.
+ */
+void
+crypto_keycache_flush(struct crypto_keycache * C)
+{
+
+	pthread_mutex_lock(&C->mtx);
+	insecure_memzero(C->locked->E, C->nentries * sizeof(struct entry));
+	C->epoch++;
+	pthread_mutex_unlock(&C->mtx);
+}
+
+/**
+ * crypto_keycache_free(C):
+ * Zero all of the keys in ${C} and free it.
+ */
+void
+crypto_keycache_free(struct crypto_keycache * C)
+{
+
+	/* Behave consistently with free(NULL). */
+	if (C == NULL)
+		return;
+
+	/* Zero everything, including the hash key, and give the pages back. */
+	insecure_memzero(C->locked, C->lockedlen);
+	munlock(C->locked, C->lockedlen);
+	munmap(C->locked, C->lockedlen);
+	pthread_mutex_destroy(&C->mtx);
+	free(C);
+}
@@ -0,0 +1,1830 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#include "scrypt_platform.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpusupport.h"
+#include "crypto_scrypt_smix.h"
+#include "crypto_scrypt_smix_sse2.h"
+#include "insecure_memzero.h"
+#include "sha256.h"
+
+#include "crypto_scrypt.h"
+#include "crypto_scrypt_batch.h"
+
+#define TESTLEN 64
+
+/*
+ * Number of SMix instances a thread interleaves when it has the memory for
+ * more than one.  Interleaving more than two thrashes the L1 and L2 caches.
+ */
+#define SMIX_INTERLEAVE 2
+
+/*
+ * Size of the huge pages we ask for when backing V.  Arrays smaller than
+ * this stay on normal pages, since a huge page would mostly go to waste.
+ */
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/*
+ * Number of iterations of an SMix loop between calls to a progress callback;
+ * a power of 2, so that it divides N if it is smaller.
+ */
+#define PROGRESS_INTERVAL 1024
+
+/* Scratch space used by one SMix invocation. */
+struct smix_scratch {
+	void * V0;
+	void * XY0;
+	uint32_t * V;
+	uint32_t * XY;
+	size_t Vlen;
+	size_t Vmaplen;
+	size_t XYlen;
+	int Vbacking;
+};
+
+/* Memory kept allocated across crypto_scrypt_ctx_run() calls. */
+struct crypto_scrypt_ctx {
+	void * B0;
+	uint8_t * B;
+	size_t Blen;
+	struct smix_scratch S;
+	int locked;
+};
+
+/* State shared by the threads computing the p instances of SMix. */
+struct smix_lanes {
+	pthread_mutex_t mtx;
+	const struct smix_kernel * K;
+	uint8_t * B;
+	size_t r;
+	uint64_t N;
+	uint32_t p;
+	uint32_t next;
+	size_t ninterleave;
+	struct crypto_scrypt_stats * stats;
+	struct smix_progress * P;
+};
+
+/*
+ * Header of a crypto_scrypt_resumable() checkpoint.  It is followed by B, by
+ * X as it stands after ${i} iterations of loop ${loop} of SMix for instance
+ * ${lane}, and by as much of that instance's V as has been filled in.  The
+ * first bytes produced by step 1 are kept in ${check}, so that a checkpoint
+ * for a different password or salt is not mistaken for this computation's.
+ */
+struct scrypt_checkpoint {
+	uint8_t magic[8];
+	uint64_t N;
+	uint64_t i;
+	uint32_t r;
+	uint32_t p;
+	uint32_t lane;
+	uint32_t loop;
+	uint32_t layout;
+	uint32_t zero;
+	uint8_t check[32];
+};
+
+/* Progress of a crypto_scrypt_progress() computation. */
+struct smix_progress {
+	pthread_mutex_t mtx;
+	int (*callback)(void *, uint64_t, uint64_t);
+	void * cookie;
+	uint64_t done;
+	uint64_t total;
+	int cancelled;
+};
+
+/* The SMix kernels picked by selectsmix(). */
+static const struct smix_kernel * smix_kernels = NULL;
+static pthread_once_t smix_once = PTHREAD_ONCE_INIT;
+
+/* Number of V arrays allocated with each backing. */
+static uint64_t vbacking_count[CRYPTO_SCRYPT_V_NTYPES];
+static pthread_mutex_t vbacking_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static int checkparams(uint64_t, uint32_t, uint32_t, size_t);
+static int scratch_valloc(struct smix_scratch *);
+static int scratch_alloc(struct smix_scratch *, size_t, uint64_t);
+static int scratch_free(struct smix_scratch *);
+static size_t scratch_alloc_n(struct smix_scratch *, size_t, size_t,
+    uint64_t);
+static void scratch_free_n(struct smix_scratch *, size_t);
+static uint64_t now_ns(void);
+static uint64_t faults_now(void);
+static int progress(struct smix_progress *, uint64_t);
+static int smix_group(const struct smix_kernel *, uint8_t **, size_t,
+    size_t, uint64_t, struct smix_scratch *, uint64_t *,
+    struct smix_progress *);
+static void smix_lanes_run(struct smix_lanes *, struct smix_scratch *,
+    size_t, uint64_t *);
+static void * smix_lanes_thread(void *);
+static int smix_all(uint8_t *, size_t, uint64_t, uint32_t,
+    struct smix_scratch *, size_t, const struct smix_kernel *, uint32_t,
+    struct crypto_scrypt_stats *, struct smix_progress *);
+static int _crypto_scrypt(const uint8_t *, size_t, const uint8_t *, size_t,
+    uint64_t, uint32_t, uint32_t, uint8_t *, size_t,
+    const struct smix_kernel *, uint32_t, size_t,
+    struct crypto_scrypt_stats *, struct smix_progress *);
+static uint64_t tmto_factor(uint64_t, uint32_t, uint32_t, size_t);
+static int _crypto_scrypt_tmto(const uint8_t *, size_t, const uint8_t *,
+    size_t, uint64_t, uint32_t, uint32_t, uint8_t *, size_t,
+    const struct smix_kernel *, uint64_t);
+static const struct smix_kernel * smix_lookup(const struct smix_kernel *,
+    size_t);
+static int testsmix(const struct smix_kernel *);
+static uint32_t smix_layout(void);
+static void selectsmix(void);
+
+/**
+ * checkparams(N, r, p, buflen):
+ * Check that the scrypt parameters are valid and that the memory they need
+ * can be addressed; set errno and return -1 if not.
+ */
+static int
+checkparams(uint64_t N, uint32_t r, uint32_t p, size_t buflen)
+{
+
+#if SIZE_MAX > UINT32_MAX
+	if (buflen > (((uint64_t)(1) << 32) - 1) * 32) {
+		errno = EFBIG;
+		return (-1);
+	}
+#else
+	(void)buflen; /* UNUSED */
+#endif
+	if ((uint64_t)(r) * (uint64_t)(p) >= (1 << 30)) {
+		errno = EFBIG;
+		return (-1);
+	}
+	if ((r == 0) || (p == 0) || ((N & (N - 1)) != 0) || (N < 2)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	if ((r > SIZE_MAX / 128 / p) ||
+#if SIZE_MAX / 256 <= UINT32_MAX
+	    (r > SIZE_MAX / 256) ||
+#endif
+	    (N > SIZE_MAX / 128 / r)) {
+		errno = ENOMEM;
+		return (-1);
+	}
+
+	return (0);
+}
+
+/**
+ * scratch_valloc(S):
+ * Allocate S->Vlen bytes for V, on huge pages if the system has any to give
+ * us and on normal pages otherwise, and record which in S->Vbacking.
+ */
+static int
+scratch_valloc(struct smix_scratch * S)
+{
+
+#ifdef MAP_ANON
+#ifdef MAP_HUGETLB
+	/* Try the pool of explicitly reserved huge pages. */
+	if (S->Vlen >= HUGEPAGE_SIZE) {
+		S->Vmaplen = (S->Vlen + HUGEPAGE_SIZE - 1) &
+		    ~(size_t)(HUGEPAGE_SIZE - 1);
+		if ((S->V0 = mmap(NULL, S->Vmaplen, PROT_READ | PROT_WRITE,
+		    MAP_ANON | MAP_PRIVATE | MAP_HUGETLB,
+		    -1, 0)) != MAP_FAILED) {
+			S->V = (uint32_t *)(S->V0);
+			S->Vbacking = CRYPTO_SCRYPT_V_HUGETLB;
+			return (0);
+		}
+	}
+#endif
+
+	/*
+	 * Map normal pages.  If transparent huge pages are available, map an
+	 * extra huge page so that V can start on a huge page boundary.
+	 */
+	S->Vmaplen = S->Vlen;
+#ifdef MADV_HUGEPAGE
+	if ((S->Vlen >= HUGEPAGE_SIZE) &&
+	    (S->Vlen <= SIZE_MAX - HUGEPAGE_SIZE))
+		S->Vmaplen = S->Vlen + HUGEPAGE_SIZE;
+#endif
+	if ((S->V0 = mmap(NULL, S->Vmaplen, PROT_READ | PROT_WRITE,
+#ifdef MAP_NOCORE
+	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
+#else
+	    MAP_ANON | MAP_PRIVATE,
+#endif
+	    -1, 0)) == MAP_FAILED)
+		return (-1);
+	S->V = (uint32_t *)(S->V0);
+	S->Vbacking = CRYPTO_SCRYPT_V_PAGES;
+#ifdef MADV_HUGEPAGE
+	if (S->Vmaplen != S->Vlen) {
+		S->V = (uint32_t *)(((uintptr_t)(S->V0) + HUGEPAGE_SIZE - 1) &
+		    ~ (uintptr_t)(HUGEPAGE_SIZE - 1));
+		if (madvise(S->V, S->Vlen, MADV_HUGEPAGE) == 0)
+			S->Vbacking = CRYPTO_SCRYPT_V_THP;
+	}
+#endif
+#elif defined(HAVE_POSIX_MEMALIGN)
+	if ((errno = posix_memalign(&S->V0, 64, S->Vlen)) != 0)
+		return (-1);
+	S->V = (uint32_t *)(S->V0);
+	S->Vbacking = CRYPTO_SCRYPT_V_MALLOC;
+#else
+	if ((S->V0 = malloc(S->Vlen + 63)) == NULL)
+		return (-1);
+	S->V = (uint32_t *)(((uintptr_t)(S->V0) + 63) & ~ (uintptr_t)(63));
+	S->Vbacking = CRYPTO_SCRYPT_V_MALLOC;
+#endif
+
+	/* Success! */
+	return (0);
+}
+
+/**
+ * scratch_alloc(S, r, N):
+ * Allocate the V and XY arrays needed to compute SMix_r with parameter N.
+ */
+static int
+scratch_alloc(struct smix_scratch * S, size_t r, uint64_t N)
+{
+
+	/* Allocate XY. */
+	S->XYlen = 256 * r + 64;
+#ifdef HAVE_POSIX_MEMALIGN
+	if ((errno = posix_memalign(&S->XY0, 64, S->XYlen)) != 0)
+		goto err0;
+	S->XY = (uint32_t *)(S->XY0);
+#else
+	if ((S->XY0 = malloc(S->XYlen + 63)) == NULL)
+		goto err0;
+	S->XY = (uint32_t *)(((uintptr_t)(S->XY0) + 63) & ~ (uintptr_t)(63));
+#endif
+
+	/* Allocate V. */
+	S->Vlen = 128 * r * N;
+	if (scratch_valloc(S))
+		goto err1;
+
+	/* Record how V is backed. */
+	pthread_mutex_lock(&vbacking_mtx);
+	vbacking_count[S->Vbacking]++;
+	pthread_mutex_unlock(&vbacking_mtx);
+
+	/* Success! */
+	return (0);
+
+err1:
+	free(S->XY0);
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * scratch_free(S):
+ * Free the arrays allocated by scratch_alloc().
+ */
+static int
+scratch_free(struct smix_scratch * S)
+{
+	int rc = 0;
+
+#ifdef MAP_ANON
+	if (munmap(S->V0, S->Vmaplen))
+		rc = -1;
+#else
+	free(S->V0);
+#endif
+	free(S->XY0);
+
+	return (rc);
+}
+
+/**
+ * scratch_alloc_n(S, n, r, N):
+ * Allocate up to ${n} sets of scratch space for SMix_r with parameter N,
+ * stopping at the first failure.  Return the number of sets allocated.
+ */
+static size_t
+scratch_alloc_n(struct smix_scratch * S, size_t n, size_t r, uint64_t N)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (scratch_alloc(&S[i], r, N))
+			break;
+	}
+
+	return (i);
+}
+
+/**
+ * scratch_free_n(S, n):
+ * Free ${n} sets of scratch space allocated by scratch_alloc_n().
+ */
+static void
+scratch_free_n(struct smix_scratch * S, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		scratch_free(&S[i]);
+}
+
+/**
+ * now_ns(void):
+ * Return the time in nanoseconds according to a monotonic clock.
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return (0);
+	return ((uint64_t)(ts.tv_sec) * 1000000000 + (uint64_t)(ts.tv_nsec));
+}
+
+/**
+ * faults_now(void):
+ * Return the number of page faults this process has taken so far.
+ */
+static uint64_t
+faults_now(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru))
+		return (0);
+	return ((uint64_t)(ru.ru_minflt) + (uint64_t)(ru.ru_majflt));
+}
+
+/**
+ * progress(P, n):
+ * Record that ${n} more SMix iterations have been completed and tell the
+ * progress callback of ${P}, if ${P} is not NULL.  Return non-zero if the
+ * computation has been cancelled.
+ */
+static int
+progress(struct smix_progress * P, uint64_t n)
+{
+	int cancelled;
+
+	/* Nobody is listening. */
+	if (P == NULL)
+		return (0);
+
+	pthread_mutex_lock(&P->mtx);
+	P->done += n;
+	if (!P->cancelled && (P->callback)(P->cookie, P->done, P->total))
+		P->cancelled = 1;
+	cancelled = P->cancelled;
+	pthread_mutex_unlock(&P->mtx);
+
+	return (cancelled);
+}
+
+/**
+ * smix_group(K, B, n, r, N, S, T, P):
+ * Compute B[k] <-- MF(B[k], N) for k = 0 ... n - 1 using the scratch space
+ * S[k], interleaving the computations if there is more than one.  If ${T} is
+ * not NULL, add the time taken by the two loops of SMix to T[0] and T[1].
+ * If ${P} is not NULL, report progress to it every PROGRESS_INTERVAL
+ * iterations, and stop and return -1 if the computation has been cancelled.
+ */
+static int
+smix_group(const struct smix_kernel * K, uint8_t ** B, size_t n, size_t r,
+    uint64_t N, struct smix_scratch * S, uint64_t * T,
+    struct smix_progress * P)
+{
+	void * V[SMIX_MULTI_MAX];
+	void * XY[SMIX_MULTI_MAX];
+	uint64_t step = N;
+	uint64_t t0 = 0, t1;
+	uint64_t i;
+	size_t k;
+
+	for (k = 0; k < n; k++) {
+		V[k] = S[k].V;
+		XY[k] = S[k].XY;
+	}
+
+	/* Run the loops in pieces if someone wants to hear about them. */
+	if ((P != NULL) && (N > PROGRESS_INTERVAL))
+		step = PROGRESS_INTERVAL;
+
+	if (T != NULL)
+		t0 = now_ns();
+
+	/* The plain kernel is a little faster for a single instance. */
+	for (i = 0; i < N; i += step) {
+		if (n == 1)
+			K->smix1(B[0], r, N, i, i + step, V[0], XY[0]);
+		else
+			K->smix1_multi(B, n, r, N, i, i + step, V, XY);
+		if (progress(P, n * step))
+			return (-1);
+	}
+
+	if (T != NULL) {
+		t1 = now_ns();
+		T[0] += t1 - t0;
+		t0 = t1;
+	}
+
+	for (i = 0; i < N; i += step) {
+		if (n == 1)
+			K->smix2(B[0], r, N, i, i + step, V[0], XY[0]);
+		else
+			K->smix2_multi(B, n, r, N, i, i + step, V, XY);
+		if (progress(P, n * step))
+			return (-1);
+	}
+
+	if (T != NULL)
+		T[1] += now_ns() - t0;
+
+	/* Success! */
+	return (0);
+}
+
+/**
+ * smix_lanes_run(L, S, nS, T):
+ * Compute SMix for each instance in ${L} which has not yet been claimed by
+ * another thread, up to ${nS} at once using the scratch space S[0 .. nS - 1].
+ * If ${T} is not NULL, add the time taken to it as smix_group() does.  Stop
+ * early if the computation is cancelled.
+ */
+static void
+smix_lanes_run(struct smix_lanes * L, struct smix_scratch * S, size_t nS,
+    uint64_t * T)
+{
+	uint8_t * B[SMIX_MULTI_MAX];
+	uint32_t i;
+	size_t n;
+
+	for (;;) {
+		/* Claim the next instances. */
+		pthread_mutex_lock(&L->mtx);
+		for (n = 0; (n < nS) && (L->next < L->p); n++) {
+			i = L->next++;
+			B[n] = &L->B[i * 128 * L->r];
+		}
+		pthread_mutex_unlock(&L->mtx);
+
+		/* Are we done? */
+		if (n == 0)
+			break;
+
+		/* 3: B_i <-- MF(B_i, N) */
+		if (smix_group(L->K, B, n, L->r, L->N, S, T, L->P))
+			break;
+	}
+}
+
+/**
+ * smix_lanes_thread(cookie):
+ * Worker thread for _crypto_scrypt(): allocate private scratch space and
+ * compute SMix instances until there are none left.
+ */
+static void *
+smix_lanes_thread(void * cookie)
+{
+	struct smix_lanes * L = cookie;
+	struct smix_scratch S[SMIX_MULTI_MAX];
+	uint64_t T[2] = {0, 0};
+	size_t nS, k;
+
+	/* If we can't get scratch space, leave the work to other threads. */
+	if ((nS = scratch_alloc_n(S, L->ninterleave, L->r, L->N)) == 0)
+		return (NULL);
+
+	/* Do our share of the work. */
+	smix_lanes_run(L, S, nS, (L->stats != NULL) ? T : NULL);
+
+	/* Report what we used. */
+	if (L->stats != NULL) {
+		pthread_mutex_lock(&L->mtx);
+		L->stats->smix1_ns += T[0];
+		L->stats->smix2_ns += T[1];
+		for (k = 0; k < nS; k++)
+			L->stats->mem += S[k].Vlen + S[k].XYlen;
+		L->stats->nthreads++;
+		pthread_mutex_unlock(&L->mtx);
+	}
+
+	/* Free our scratch space. */
+	scratch_free_n(S, nS);
+
+	return (NULL);
+}
+
+/**
+ * smix_all(B, r, N, p, S, nS, K, nthreads, stats, P):
+ * Compute B_i <-- MF(B_i, N) for each of the p blocks in ${B} using the
+ * kernel ${K}, on up to ${nthreads} threads, each of which interleaves up to
+ * ${nS} instances.  This thread uses the scratch space S[0 .. nS - 1]; any
+ * other threads allocate their own.  If ${stats} is not NULL, add the time
+ * spent in SMix, and the threads and memory used by other threads, to it.
+ * If ${P} is not NULL, report progress to it; if the computation is
+ * cancelled, set errno to ECANCELED and return -1.
+ */
+static int
+smix_all(uint8_t * B, size_t r, uint64_t N, uint32_t p,
+    struct smix_scratch * S, size_t nS, const struct smix_kernel * K,
+    uint32_t nthreads, struct crypto_scrypt_stats * stats,
+    struct smix_progress * P)
+{
+	struct smix_lanes L;
+	uint8_t * Bk[SMIX_MULTI_MAX];
+	pthread_t * threads;
+	uint64_t T[2] = {0, 0};
+	uint64_t * Tp = (stats != NULL) ? T : NULL;
+	uint32_t nspawned;
+	uint32_t i;
+	size_t k, n;
+
+	/* 2: for i = 0 to p - 1 do */
+	if (nthreads <= 1) {
+		for (i = 0; i < p; i += n) {
+			n = (p - i < nS) ? p - i : nS;
+			for (k = 0; k < n; k++)
+				Bk[k] = &B[(i + k) * 128 * r];
+
+			/* 3: B_i <-- MF(B_i, N) */
+			if (smix_group(K, Bk, n, r, N, S, Tp, P))
+				goto cancelled;
+		}
+		goto done;
+	}
+
+	/* Set up the shared state. */
+	if ((errno = pthread_mutex_init(&L.mtx, NULL)) != 0)
+		goto err0;
+	L.K = K;
+	L.B = B;
+	L.r = r;
+	L.N = N;
+	L.p = p;
+	L.next = 0;
+	L.ninterleave = nS;
+	L.stats = stats;
+	L.P = P;
+
+	/* Start helper threads; this thread does a share too. */
+	if ((threads = malloc((nthreads - 1) * sizeof(pthread_t))) == NULL)
+		goto err1;
+	for (nspawned = 0; nspawned < nthreads - 1; nspawned++) {
+		if (pthread_create(&threads[nspawned], NULL,
+		    smix_lanes_thread, &L))
+			break;
+	}
+	smix_lanes_run(&L, S, nS, Tp);
+
+	/* Wait for the helpers to finish. */
+	for (i = 0; i < nspawned; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	pthread_mutex_destroy(&L.mtx);
+
+	/* Did we finish? */
+	if ((P != NULL) && P->cancelled)
+		goto cancelled;
+
+done:
+	/* Add this thread's share of the time. */
+	if (stats != NULL) {
+		stats->smix1_ns += T[0];
+		stats->smix2_ns += T[1];
+		stats->nthreads++;
+	}
+
+	/* Success! */
+	return (0);
+
+cancelled:
+	errno = ECANCELED;
+	return (-1);
+
+err1:
+	pthread_mutex_destroy(&L.mtx);
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * _crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen, K,
+ *     nthreads, maxmem, stats, P):
+ * Perform the requested scrypt computation, using the SMix kernel ${K} and
+ * running the p instances of SMix on up to ${nthreads} threads, each with its
+ * own V and XY.  If ${maxmem} is non-zero, use fewer threads (but at least
+ * one) if needed to keep the total allocation within ${maxmem} bytes, and
+ * have each thread interleave two instances if that fits as well.  If
+ * ${stats} is not NULL, record where the time and memory went in it.  If
+ * ${P} is not NULL, report progress to it and stop if it cancels.
+ */
+static int
+_crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen, const struct smix_kernel * K,
+    uint32_t nthreads, size_t maxmem, struct crypto_scrypt_stats * stats,
+    struct smix_progress * P)
+{
+	struct smix_scratch S[SMIX_INTERLEAVE];
+	HMAC_SHA256_CTX Pctx;
+	size_t ninterleave = 1;
+	size_t nlanes;
+	size_t lanemem;
+	size_t nS, k;
+	void * B0;
+	uint8_t * B;
+	uint64_t t0 = 0, tstart = 0, f0 = 0;
+
+	/* Start the clocks. */
+	if (stats != NULL) {
+		memset(stats, 0, sizeof(struct crypto_scrypt_stats));
+		f0 = faults_now();
+		tstart = t0 = now_ns();
+	}
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, buflen))
+		goto err0;
+
+	/* Don't start more threads than there are SMix instances. */
+	if (nthreads > p)
+		nthreads = p;
+
+	/* Each concurrent SMix instance needs its own V and XY; B is shared. */
+	if ((maxmem != 0) && (p > 1)) {
+		lanemem = 128 * r * N + 256 * r + 64;
+		if ((lanemem < 128 * r * N) || (maxmem < 128 * r * p))
+			nlanes = 1;
+		else
+			nlanes = (maxmem - 128 * r * p) / lanemem;
+		if (nthreads > nlanes)
+			nthreads = (uint32_t)nlanes;
+
+		/* Interleave if every thread still has two instances to do. */
+		if ((nthreads > 0) && (p / nthreads >= SMIX_INTERLEAVE) &&
+		    (nlanes / nthreads >= SMIX_INTERLEAVE))
+			ninterleave = SMIX_INTERLEAVE;
+	}
+
+	/* We always have this thread. */
+	if (nthreads == 0)
+		nthreads = 1;
+
+	/* Allocate memory. */
+#ifdef HAVE_POSIX_MEMALIGN
+	if ((errno = posix_memalign(&B0, 64, 128 * r * p)) != 0)
+		goto err0;
+	B = (uint8_t *)(B0);
+#else
+	if ((B0 = malloc(128 * r * p + 63)) == NULL)
+		goto err0;
+	B = (uint8_t *)(((uintptr_t)(B0) + 63) & ~ (uintptr_t)(63));
+#endif
+	if ((nS = scratch_alloc_n(S, ninterleave, r, N)) == 0)
+		goto err1;
+	if (stats != NULL) {
+		stats->mem = 128 * r * p;
+		for (k = 0; k < nS; k++)
+			stats->mem += S[k].Vlen + S[k].XYlen;
+		stats->vbacking = S[0].Vbacking;
+		stats->alloc_ns = now_ns() - t0;
+		t0 = now_ns();
+	}
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	HMAC_SHA256_Init(&Pctx, passwd, passwdlen);
+	PBKDF2_SHA256_Keyed(&Pctx, salt, saltlen, 1, B, p * 128 * r);
+	if (stats != NULL)
+		stats->pbkdf2_in_ns = now_ns() - t0;
+
+	/* 2: for i = 0 to p - 1 do */
+	if (smix_all(B, r, N, p, S, nS, K, nthreads, stats, P))
+		goto err2;
+	if (stats != NULL)
+		t0 = now_ns();
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	PBKDF2_SHA256_Keyed(&Pctx, B, p * 128 * r, 1, buf, buflen);
+	if (stats != NULL) {
+		stats->pbkdf2_out_ns = now_ns() - t0;
+		t0 = now_ns();
+	}
+
+	/* Free memory. */
+	insecure_memzero(&Pctx, sizeof(HMAC_SHA256_CTX));
+	scratch_free_n(S, nS);
+	free(B0);
+
+	/* Stop the clocks. */
+	if (stats != NULL) {
+		stats->free_ns = now_ns() - t0;
+		stats->total_ns = now_ns() - tstart;
+		stats->faults = faults_now() - f0;
+	}
+
+	/* Success! */
+	return (0);
+
+err2:
+	insecure_memzero(&Pctx, sizeof(HMAC_SHA256_CTX));
+	scratch_free_n(S, nS);
+err1:
+	free(B0);
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * tmto_factor(N, r, p, maxmem):
+ * Return the smallest power of 2 k <= N for which computing scrypt with the
+ * parameters N, r, and p while keeping only every kth block of V needs no
+ * more than ${maxmem} bytes; or 0 if there is no such k.
+ */
+static uint64_t
+tmto_factor(uint64_t N, uint32_t r, uint32_t p, size_t maxmem)
+{
+	size_t fixed = 128 * r * p + 256 * r + 64;
+	uint64_t k;
+
+	/* B and XY can't be cut down. */
+	if (maxmem < fixed)
+		return (0);
+
+	/* V holds N/k blocks, plus two to recompute the others in. */
+	for (k = 1; k <= N; k <<= 1) {
+		if (N / k + 2 <= (maxmem - fixed) / (128 * r))
+			return (k);
+	}
+
+	/* Not even one block of V fits. */
+	return (0);
+}
+
+/**
+ * _crypto_scrypt_tmto(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     K, k):
+ * Perform the requested scrypt computation on this thread using the SMix
+ * kernel ${K}, keeping only every ${k}th block of V.
+ */
+static int
+_crypto_scrypt_tmto(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen, const struct smix_kernel * K, uint64_t k)
+{
+	struct smix_scratch S;
+	HMAC_SHA256_CTX Pctx;
+	void * B0;
+	uint8_t * B;
+	uint32_t i;
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, buflen))
+		goto err0;
+
+	/* Allocate memory. */
+#ifdef HAVE_POSIX_MEMALIGN
+	if ((errno = posix_memalign(&B0, 64, 128 * r * p)) != 0)
+		goto err0;
+	B = (uint8_t *)(B0);
+#else
+	if ((B0 = malloc(128 * r * p + 63)) == NULL)
+		goto err0;
+	B = (uint8_t *)(((uintptr_t)(B0) + 63) & ~ (uintptr_t)(63));
+#endif
+	if (scratch_alloc(&S, r, N / k + 2))
+		goto err1;
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	HMAC_SHA256_Init(&Pctx, passwd, passwdlen);
+	PBKDF2_SHA256_Keyed(&Pctx, salt, saltlen, 1, B, p * 128 * r);
+
+	/* 2: for i = 0 to p - 1 do */
+	for (i = 0; i < p; i++) {
+		/* 3: B_i <-- MF(B_i, N) */
+		K->smix_tmto(&B[i * 128 * r], r, N, k, S.V, S.XY);
+	}
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	PBKDF2_SHA256_Keyed(&Pctx, B, p * 128 * r, 1, buf, buflen);
+
+	/* Free memory. */
+	insecure_memzero(&Pctx, sizeof(HMAC_SHA256_CTX));
+	scratch_free(&S);
+	free(B0);
+
+	/* Success! */
+	return (0);
+
+err1:
+	free(B0);
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/*
+ * Test vectors used to check that an smix implementation works: one for each
+ * value of r which has a specialized kernel.
+ */
+static const struct scrypt_test {
+	const char * passwd;
+	const char * salt;
+	uint64_t N;
+	uint32_t r;
+	uint32_t p;
+	uint8_t result[TESTLEN];
+	uint8_t result2[TESTLEN];
+} testcases[] = {
+	{
+		.passwd = "pleaseletmein",
+		.salt = "SodiumChloride",
+		.N = 16,
+		.r = 1,
+		.p = 1,
+		.result = {
+			0xbb, 0x4d, 0x0d, 0xfa, 0x7f, 0xf5, 0xb1, 0x63,
+			0x33, 0xa1, 0x17, 0xe9, 0x47, 0x81, 0x8f, 0xd2,
+			0x3b, 0xdd, 0xd6, 0x5a, 0x45, 0xb1, 0xc9, 0x09,
+			0x5c, 0x4b, 0xf0, 0xa9, 0x5c, 0x19, 0xdc, 0x16,
+			0x1e, 0xb1, 0x3f, 0x0c, 0xca, 0x59, 0x9e, 0xfe,
+			0x56, 0x55, 0x9a, 0x59, 0xce, 0xc4, 0x55, 0xde,
+			0xe7, 0xb5, 0x93, 0x68, 0x38, 0xf5, 0x7d, 0xba,
+			0xc4, 0xc2, 0x73, 0x30, 0x7b, 0xc3, 0xcd, 0xcd
+		},
+		/* The same computation with p = 2. */
+		.result2 = {
+			0x49, 0x06, 0xa8, 0x35, 0xda, 0xda, 0xbe, 0xa0,
+			0x36, 0xbd, 0xb0, 0xbd, 0xdb, 0xc7, 0x68, 0x7f,
+			0xf7, 0x67, 0x46, 0x13, 0xab, 0x7a, 0x85, 0x86,
+			0x69, 0x32, 0x35, 0x54, 0xd1, 0x98, 0x6b, 0x5b,
+			0x39, 0xff, 0x8c, 0xa4, 0x80, 0x66, 0x12, 0xdb,
+			0x04, 0x61, 0x22, 0xe0, 0xca, 0xcf, 0x03, 0x06,
+			0x7a, 0x73, 0x83, 0x1a, 0x3e, 0x5c, 0x6d, 0xbb,
+			0xa9, 0x50, 0xfd, 0xef, 0x5a, 0x35, 0xc9, 0x17
+		}
+	},
+	{
+		.passwd = "pleaseletmein",
+		.salt = "SodiumChloride",
+		.N = 16,
+		.r = 8,
+		.p = 1,
+		.result = {
+			0x25, 0xa9, 0xfa, 0x20, 0x7f, 0x87, 0xca, 0x09,
+			0xa4, 0xef, 0x8b, 0x9f, 0x77, 0x7a, 0xca, 0x16,
+			0xbe, 0xb7, 0x84, 0xae, 0x18, 0x30, 0xbf, 0xbf,
+			0xd3, 0x83, 0x25, 0xaa, 0xbb, 0x93, 0x77, 0xdf,
+			0x1b, 0xa7, 0x84, 0xd7, 0x46, 0xea, 0x27, 0x3b,
+			0xf5, 0x16, 0xa4, 0x6f, 0xbf, 0xac, 0xf5, 0x11,
+			0xc5, 0xbe, 0xba, 0x4c, 0x4a, 0xb3, 0xac, 0xc7,
+			0xfa, 0x6f, 0x46, 0x0b, 0x6c, 0x0f, 0x47, 0x7b
+		},
+		.result2 = {
+			0x8a, 0x9f, 0x84, 0xc6, 0x52, 0x51, 0xad, 0x42,
+			0xff, 0xad, 0x22, 0x7a, 0x55, 0xdc, 0x51, 0x81,
+			0x6c, 0x3c, 0x6a, 0x05, 0xb4, 0xc9, 0xd9, 0x3c,
+			0x7a, 0xd3, 0x12, 0x9a, 0xf3, 0xc0, 0x0c, 0xc3,
+			0x20, 0x58, 0x67, 0xea, 0x36, 0x64, 0xc2, 0x7e,
+			0xbf, 0xa8, 0x51, 0x8e, 0xe0, 0x36, 0xfb, 0x28,
+			0x7f, 0x6e, 0x82, 0x87, 0x63, 0x72, 0xb8, 0x51,
+			0x28, 0x8f, 0x73, 0x75, 0xdc, 0x4a, 0xd2, 0x1f
+		}
+	},
+	{
+		.passwd = "pleaseletmein",
+		.salt = "SodiumChloride",
+		.N = 16,
+		.r = 16,
+		.p = 1,
+		.result = {
+			0xe3, 0x53, 0xf5, 0x4e, 0xde, 0x7d, 0xc1, 0x36,
+			0xb6, 0x9a, 0x03, 0xcb, 0x4b, 0x1d, 0x41, 0x49,
+			0xe0, 0x3a, 0x96, 0x92, 0xe7, 0x98, 0x1b, 0x3e,
+			0x3e, 0x13, 0x88, 0x87, 0x0d, 0x63, 0xe1, 0xf1,
+			0x91, 0xb5, 0xa1, 0xe7, 0xc6, 0x00, 0xfd, 0x13,
+			0x14, 0x39, 0xd1, 0x3b, 0xaa, 0xbf, 0xb2, 0x95,
+			0xc3, 0x1e, 0x1b, 0x51, 0xfe, 0x90, 0x49, 0x13,
+			0x71, 0x53, 0xea, 0x51, 0xe4, 0xc7, 0xd7, 0xc9
+		},
+		.result2 = {
+			0x1f, 0xda, 0x0a, 0x96, 0x61, 0x32, 0x10, 0xc8,
+			0x87, 0x5a, 0x3f, 0x50, 0xa3, 0x48, 0x49, 0x90,
+			0x60, 0x80, 0x6d, 0xd3, 0x80, 0x66, 0x25, 0x1b,
+			0x35, 0xb7, 0x92, 0x24, 0xc2, 0x8c, 0x62, 0xeb,
+			0x5b, 0xa3, 0x87, 0x13, 0xab, 0x15, 0x0a, 0x07,
+			0xd3, 0x08, 0x1c, 0xee, 0xe3, 0x1c, 0x19, 0x90,
+			0xf0, 0xf2, 0x32, 0x4f, 0xb6, 0x28, 0x51, 0x00,
+			0x80, 0x10, 0x64, 0x24, 0x86, 0x9d, 0xbe, 0x80
+		}
+	}
+};
+
+/**
+ * smix_lookup(Ks, r):
+ * Return the first kernel in the list ${Ks} which works for ${r}.  The list
+ * must end with a kernel which works for any r.
+ */
+static const struct smix_kernel *
+smix_lookup(const struct smix_kernel * Ks, size_t r)
+{
+
+	while ((Ks->r != 0) && (Ks->r != r))
+		Ks++;
+	return (Ks);
+}
+
+/**
+ * testsmix(Ks):
+ * Return 0 if every SMix kernel in the list ${Ks} computes the correct scrypt
+ * output for each of the test vectors above which it handles; non-zero
+ * otherwise.
+ */
+static int
+testsmix(const struct smix_kernel * Ks)
+{
+	const struct smix_kernel * K = Ks;
+	const struct scrypt_test * T;
+	uint8_t hbuf[TESTLEN];
+	size_t i;
+
+	do {
+		for (i = 0; i < sizeof(testcases) / sizeof(testcases[0]); i++) {
+			T = &testcases[i];
+			if ((K->r != 0) && (K->r != T->r))
+				continue;
+
+			/* Perform the computation. */
+			if (_crypto_scrypt(
+			    (const uint8_t *)T->passwd, strlen(T->passwd),
+			    (const uint8_t *)T->salt, strlen(T->salt),
+			    T->N, T->r, T->p, hbuf, TESTLEN, K, 1, 0, NULL,
+			    NULL))
+				return (-1);
+
+			/* Does it match? */
+			if (memcmp(T->result, hbuf, TESTLEN))
+				return (-1);
+
+			/* Check the interleaved code too, with two copies. */
+			if (_crypto_scrypt(
+			    (const uint8_t *)T->passwd, strlen(T->passwd),
+			    (const uint8_t *)T->salt, strlen(T->salt),
+			    T->N, T->r, 2, hbuf, TESTLEN, K, 1, SIZE_MAX,
+			    NULL, NULL))
+				return (-1);
+
+			/* Does it match? */
+			if (memcmp(T->result2, hbuf, TESTLEN))
+				return (-1);
+
+			/* Check the TMTO code, keeping a quarter of V. */
+			if (_crypto_scrypt_tmto(
+			    (const uint8_t *)T->passwd, strlen(T->passwd),
+			    (const uint8_t *)T->salt, strlen(T->salt),
+			    T->N, T->r, T->p, hbuf, TESTLEN, K, 4))
+				return (-1);
+
+			/* Does it match? */
+			if (memcmp(T->result, hbuf, TESTLEN))
+				return (-1);
+		}
+	} while ((K++)->r != 0);
+
+	/* Success! */
+	return (0);
+}
+
+/**
+ * selectsmix(void):
+ * Pick the fastest smix implementation which works on this CPU.
+ */
+static void
+selectsmix(void)
+{
+
+#ifdef CPUSUPPORT_X86_SSE2
+	/* If we're running on an SSE2-capable CPU, try that code. */
+	if (cpusupport_x86_sse2()) {
+		/* If SSE2ized smix works, use it. */
+		if (!testsmix(crypto_scrypt_smix_sse2_kernels)) {
+			smix_kernels = crypto_scrypt_smix_sse2_kernels;
+			return;
+		}
+	}
+#endif
+
+	/* Fall back to the generic code. */
+	smix_kernels = crypto_scrypt_smix_kernels;
+}
+
+/**
+ * smix_layout(void):
+ * Return an identifier for the way the selected SMix kernels lay out X and V
+ * in memory, which differs between the SSE2 and the portable code.
+ */
+static uint32_t
+smix_layout(void)
+{
+
+	return (smix_kernels == crypto_scrypt_smix_kernels ? 0 : 1);
+}
+
+/**
+ * crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf.  The parameters r, p, and buflen
+ * must satisfy r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N
+ * must be a power of 2 greater than 1.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen)
+{
+
+	/* Pick the smix implementation to use the first time through. */
+	if (pthread_once(&smix_once, selectsmix))
+		return (-1);
+
+	/* Perform the computation. */
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p,
+	    buf, buflen, smix_lookup(smix_kernels, r), 1, 0, NULL, NULL));
+}
+
+/**
+ * crypto_scrypt_threads(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, nthreads, maxmem):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt() does, but run
+ * the p instances of SMix on up to nthreads threads.  Each thread uses its
+ * own 128rN-byte V array; if maxmem is non-zero, fewer threads are used if
+ * necessary to keep the memory used within maxmem bytes (but one thread is
+ * always used, even if that alone exceeds maxmem).  If maxmem leaves room for
+ * it, each thread interleaves two SMix instances to hide memory latency.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_threads(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen, uint32_t nthreads, size_t maxmem)
+{
+
+	/* Pick the smix implementation to use the first time through. */
+	if (pthread_once(&smix_once, selectsmix))
+		return (-1);
+
+	/* Perform the computation. */
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p,
+	    buf, buflen, smix_lookup(smix_kernels, r), nthreads, maxmem,
+	    NULL, NULL));
+}
+
+/**
+ * crypto_scrypt_stats(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     nthreads, maxmem, stats):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt_threads() does,
+ * and record in ${stats} how long each phase of the computation took, how
+ * much memory was allocated, and how V was backed.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_stats(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen, uint32_t nthreads, size_t maxmem,
+    struct crypto_scrypt_stats * stats)
+{
+
+	/* Pick the smix implementation to use the first time through. */
+	if (pthread_once(&smix_once, selectsmix))
+		return (-1);
+
+	/* Perform the computation. */
+	return (_crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p,
+	    buf, buflen, smix_lookup(smix_kernels, r), nthreads, maxmem,
+	    stats, NULL));
+}
+
+/**
+ * crypto_scrypt_progress(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, nthreads, maxmem, stats, callback, cookie):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt_threads() does,
+ * calling callback(cookie, done, total) every so often to report that ${done}
+ * of the ${total} SMix iterations have been completed.  The callback may be
+ * called from any of the threads, but never concurrently.  If it returns
+ * non-zero, stop as soon as possible and free the memory used.  If ${stats}
+ * is not NULL, fill it in as crypto_scrypt_stats() does.
+ *
+ * Return 0 on success; or -1 on error, with errno set to ECANCELED if the
+ * callback cancelled the computation.
+ */
+int
+crypto_scrypt_progress(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen, uint32_t nthreads, size_t maxmem,
+    struct crypto_scrypt_stats * stats,
+    int (*callback)(void *, uint64_t, uint64_t), void * cookie)
+{
+	struct smix_progress P;
+	int rc;
+
+	/* Pick the smix implementation to use the first time through. */
+	if (pthread_once(&smix_once, selectsmix))
+		goto err0;
+
+	/* Nothing has happened yet. */
+	if ((errno = pthread_mutex_init(&P.mtx, NULL)) != 0)
+		goto err0;
+	P.callback = callback;
+	P.cookie = cookie;
+	P.done = 0;
+	P.total = 2 * N * p;
+	P.cancelled = 0;
+
+	/* Perform the computation. */
+	rc = _crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p,
+	    buf, buflen, smix_lookup(smix_kernels, r), nthreads, maxmem,
+	    stats, &P);
+
+	/* Clean up. */
+	pthread_mutex_destroy(&P.mtx);
+
+	return (rc);
+
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * crypto_scrypt_tmto(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen,
+ *     maxmem):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt() does, using
+ * no more than ${maxmem} bytes of memory.  Only every kth block of V is kept
+ * and the others are recomputed in the second loop of SMix, where k is the
+ * smallest power of 2 for which everything fits; this takes about (k + 3) / 4
+ * times as long as keeping all of V.  If ${maxmem} is zero, all of V is kept.
+ *
+ * Return 0 on success; or -1 on error, with errno set to ENOMEM if the
+ * computation cannot be done within ${maxmem} bytes.
+ */
+int
+crypto_scrypt_tmto(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen, size_t maxmem)
+{
+	uint64_t k = 1;
+
+	/* Pick the smix implementation to use the first time through. */
+	if (pthread_once(&smix_once, selectsmix))
+		return (-1);
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, buflen))
+		return (-1);
+
+	/* How much of V can we afford to keep? */
+	if ((maxmem != 0) && ((k = tmto_factor(N, r, p, maxmem)) == 0)) {
+		errno = ENOMEM;
+		return (-1);
+	}
+
+	/* Perform the computation. */
+	return (_crypto_scrypt_tmto(passwd, passwdlen, salt, saltlen, N, r, p,
+	    buf, buflen, smix_lookup(smix_kernels, r), k));
+}
+
+/**
+ * crypto_scrypt_jobs(jobs, njobs):
+ * Run the scrypt computations *jobs[0 .. njobs - 1] on this thread, filling
+ * in their rc and err fields.  If the jobs share the same N and r, their SMix
+ * instances are interleaved; the memory used is then no more than the sum of
+ * crypto_scrypt_memory() for the jobs.  The value njobs must be at most 2.
+ */
+void
+crypto_scrypt_jobs(struct crypto_scrypt_job ** jobs, size_t njobs)
+{
+	struct crypto_scrypt_job * job;
+	struct smix_scratch S[SMIX_INTERLEAVE];
+	HMAC_SHA256_CTX Pctx[SMIX_INTERLEAVE];
+	uint8_t * Bk[SMIX_INTERLEAVE];
+	uint8_t * B[SMIX_INTERLEAVE];
+	void * B0[SMIX_INTERLEAVE];
+	uint64_t N;
+	size_t r;
+	size_t i, k, nS;
+	uint32_t lane;
+
+	/* Pick the smix implementation to use the first time through. */
+	if ((errno = pthread_once(&smix_once, selectsmix)) != 0)
+		goto err0;
+
+	/* Interleaving only works if N and r match and both jobs are valid. */
+	if ((njobs != 2) || (jobs[0]->N != jobs[1]->N) ||
+	    (jobs[0]->r != jobs[1]->r) ||
+	    checkparams(jobs[0]->N, jobs[0]->r, jobs[0]->p, jobs[0]->buflen) ||
+	    checkparams(jobs[1]->N, jobs[1]->r, jobs[1]->p, jobs[1]->buflen))
+		goto separately;
+	N = jobs[0]->N;
+	r = jobs[0]->r;
+
+	/* Allocate memory. */
+	for (i = 0; i < njobs; i++) {
+#ifdef HAVE_POSIX_MEMALIGN
+		if (posix_memalign(&B0[i], 64, 128 * r * jobs[i]->p))
+			goto err1;
+		B[i] = (uint8_t *)(B0[i]);
+#else
+		if ((B0[i] = malloc(128 * r * jobs[i]->p + 63)) == NULL)
+			goto err1;
+		B[i] = (uint8_t *)(((uintptr_t)(B0[i]) + 63) &
+		    ~ (uintptr_t)(63));
+#endif
+	}
+	if ((nS = scratch_alloc_n(S, njobs, r, N)) == 0)
+		goto err1;
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	for (i = 0; i < njobs; i++) {
+		job = jobs[i];
+		HMAC_SHA256_Init(&Pctx[i], job->passwd, job->passwdlen);
+		PBKDF2_SHA256_Keyed(&Pctx[i], job->salt, job->saltlen, 1,
+		    B[i], job->p * 128 * r);
+	}
+
+	/* 2: for i = 0 to p - 1 do, taking instances from both jobs. */
+	for (i = 0, lane = 0; i < njobs;) {
+		for (k = 0; (k < nS) && (i < njobs); k++) {
+			Bk[k] = &B[i][lane * 128 * r];
+			if (++lane == jobs[i]->p) {
+				i++;
+				lane = 0;
+			}
+		}
+
+		/* 3: B_i <-- MF(B_i, N) */
+		smix_group(smix_lookup(smix_kernels, r), Bk, k, r, N, S, NULL,
+		    NULL);
+	}
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	for (i = 0; i < njobs; i++) {
+		job = jobs[i];
+		PBKDF2_SHA256_Keyed(&Pctx[i], B[i], job->p * 128 * r, 1,
+		    job->buf, job->buflen);
+		job->rc = 0;
+		job->err = 0;
+	}
+
+	/* Free memory. */
+	insecure_memzero(Pctx, sizeof(Pctx));
+	scratch_free_n(S, nS);
+	for (i = 0; i < njobs; i++)
+		free(B0[i]);
+
+	/* Success! */
+	return;
+
+err1:
+	while (i-- > 0)
+		free(B0[i]);
+separately:
+	/* Run the jobs one at a time instead. */
+	for (i = 0; i < njobs; i++) {
+		job = jobs[i];
+		job->rc = crypto_scrypt(job->passwd, job->passwdlen, job->salt,
+		    job->saltlen, job->N, job->r, job->p, job->buf,
+		    job->buflen);
+		job->err = job->rc ? errno : 0;
+	}
+	return;
+
+err0:
+	/* Failure! */
+	for (i = 0; i < njobs; i++) {
+		jobs[i]->rc = -1;
+		jobs[i]->err = errno;
+	}
+}
+
+/**
+ * crypto_scrypt_memory(N, r, p):
+ * Return the number of bytes of memory which crypto_scrypt() allocates when
+ * called with the parameters N, r, and p; or 0 if it would reject them.
+ */
+size_t
+crypto_scrypt_memory(uint64_t N, uint32_t r, uint32_t p)
+{
+
+	/* Would crypto_scrypt() accept these parameters? */
+	if (checkparams(N, r, p, 0))
+		return (0);
+
+	/* B, XY, and V; the sum can only overflow on 32-bit platforms. */
+	if (128 * r * p + 256 * r + 64 > SIZE_MAX - 128 * r * N)
+		return (0);
+	return (128 * r * p + 256 * r + 64 + 128 * r * N);
+}
+
+/**
+ * crypto_scrypt_vbacking(counts):
+ * Store in counts[t] the number of V arrays which have been allocated with
+ * backing t (one of the CRYPTO_SCRYPT_V_* values) since the program started.
+ * Huge pages are used when the system provides them and the array is large
+ * enough; otherwise allocation silently falls back to normal pages.
+ */
+void
+crypto_scrypt_vbacking(uint64_t counts[CRYPTO_SCRYPT_V_NTYPES])
+{
+	int t;
+
+	pthread_mutex_lock(&vbacking_mtx);
+	for (t = 0; t < CRYPTO_SCRYPT_V_NTYPES; t++)
+		counts[t] = vbacking_count[t];
+	pthread_mutex_unlock(&vbacking_mtx);
+}
+
+/**
+ * crypto_scrypt_ctx_init(N, r, p):
+ * Allocate a context holding the B, XY and V arrays needed to compute scrypt
+ * with parameters N, r, and p, locking them into memory if possible.  The
+ * context can then be used by crypto_scrypt_ctx_run() for any parameters
+ * which need no more memory than these.
+ *
+ * Return the context on success; or NULL on error.
+ */
+struct crypto_scrypt_ctx *
+crypto_scrypt_ctx_init(uint64_t N, uint32_t r, uint32_t p)
+{
+	struct crypto_scrypt_ctx * ctx;
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, 0))
+		goto err0;
+
+	/* Allocate the context structure. */
+	if ((ctx = malloc(sizeof(struct crypto_scrypt_ctx))) == NULL)
+		goto err0;
+
+	/* Allocate B, XY and V. */
+	ctx->Blen = 128 * r * p;
+#ifdef HAVE_POSIX_MEMALIGN
+	if ((errno = posix_memalign(&ctx->B0, 64, ctx->Blen)) != 0)
+		goto err1;
+	ctx->B = (uint8_t *)(ctx->B0);
+#else
+	if ((ctx->B0 = malloc(ctx->Blen + 63)) == NULL)
+		goto err1;
+	ctx->B = (uint8_t *)(((uintptr_t)(ctx->B0) + 63) & ~ (uintptr_t)(63));
+#endif
+	if (scratch_alloc(&ctx->S, r, N))
+		goto err2;
+
+	/*
+	 * Lock everything into memory, which also faults in all of the pages
+	 * up front rather than during each derivation.  This can fail due to
+	 * resource limits; in that case, zero the arrays to fault them in.
+	 */
+	ctx->locked = (mlock(ctx->B, ctx->Blen) == 0);
+	if (ctx->locked && mlock(ctx->S.XY, ctx->S.XYlen)) {
+		munlock(ctx->B, ctx->Blen);
+		ctx->locked = 0;
+	}
+	if (ctx->locked && mlock(ctx->S.V, ctx->S.Vlen)) {
+		munlock(ctx->S.XY, ctx->S.XYlen);
+		munlock(ctx->B, ctx->Blen);
+		ctx->locked = 0;
+	}
+	if (!ctx->locked) {
+		insecure_memzero(ctx->B, ctx->Blen);
+		insecure_memzero(ctx->S.XY, ctx->S.XYlen);
+		insecure_memzero(ctx->S.V, ctx->S.Vlen);
+	}
+
+	/* Success! */
+	return (ctx);
+
+err2:
+	free(ctx->B0);
+err1:
+	free(ctx);
+err0:
+	/* Failure! */
+	return (NULL);
+}
+
+/**
+ * crypto_scrypt_ctx_run(ctx, passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) as crypto_scrypt() does, using the memory held by ${ctx} instead
+ * of allocating it.  The parameters must not need more memory than those
+ * passed to crypto_scrypt_ctx_init().  The memory is zeroed before returning.
+ * A context must not be used by more than one thread at once.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_ctx_run(struct crypto_scrypt_ctx * ctx,
+    const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen)
+{
+	HMAC_SHA256_CTX Pctx;
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, buflen))
+		return (-1);
+	if ((128 * r * p > ctx->Blen) || (256 * r + 64 > ctx->S.XYlen) ||
+	    (128 * r * N > ctx->S.Vlen)) {
+		errno = EINVAL;
+		return (-1);
+	}
+
+	/* Pick the smix implementation to use the first time through. */
+	if (pthread_once(&smix_once, selectsmix))
+		return (-1);
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	HMAC_SHA256_Init(&Pctx, passwd, passwdlen);
+	PBKDF2_SHA256_Keyed(&Pctx, salt, saltlen, 1, ctx->B, p * 128 * r);
+
+	/* 2: for i = 0 to p - 1 do */
+	smix_all(ctx->B, r, N, p, &ctx->S, 1, smix_lookup(smix_kernels, r),
+	    1, NULL, NULL);
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	PBKDF2_SHA256_Keyed(&Pctx, ctx->B, p * 128 * r, 1, buf, buflen);
+
+	/* Don't leave anything derived from the password lying around. */
+	insecure_memzero(&Pctx, sizeof(HMAC_SHA256_CTX));
+	insecure_memzero(ctx->B, 128 * r * p);
+	insecure_memzero(ctx->S.XY, 256 * r + 64);
+	insecure_memzero(ctx->S.V, 128 * r * N);
+
+	/* Success! */
+	return (0);
+}
+
+/**
+ * crypto_scrypt_ctx_free(ctx):
+ * Zero and free the memory held by ${ctx}.
+ */
+void
+crypto_scrypt_ctx_free(struct crypto_scrypt_ctx * ctx)
+{
+
+	/* Behave consistently with free(NULL). */
+	if (ctx == NULL)
+		return;
+
+	/* The memory was zeroed after each use; just unlock and free it. */
+	if (ctx->locked) {
+		munlock(ctx->S.V, ctx->S.Vlen);
+		munlock(ctx->S.XY, ctx->S.XYlen);
+		munlock(ctx->B, ctx->Blen);
+	}
+	scratch_free(&ctx->S);
+	free(ctx->B0);
+	free(ctx);
+}
+
+/**
+ * crypto_scrypt_checkpoint_size(N, r, p):
+ * Return the size of the buffer which crypto_scrypt_resumable() needs to
+ * hold a checkpoint of a computation with parameters N, r, and p; or 0 if
+ * crypto_scrypt() would reject them.
+ */
+size_t
+crypto_scrypt_checkpoint_size(uint64_t N, uint32_t r, uint32_t p)
+{
+	size_t len;
+
+	/* Would crypto_scrypt() accept these parameters? */
+	if (checkparams(N, r, p, 0))
+		return (0);
+
+	/* Header, B, X, and V. */
+	len = sizeof(struct scrypt_checkpoint) + 128 * r * p + 128 * r;
+	if (len > SIZE_MAX - 128 * r * N)
+		return (0);
+	return (len + 128 * r * N);
+}
+
+/**
+ * crypto_scrypt_checkpoint_alloc(N, r, p):
+ * Allocate a zeroed buffer of crypto_scrypt_checkpoint_size(N, r, p) bytes
+ * to hold a checkpoint for crypto_scrypt_resumable().  It is kept out of
+ * core dumps and, if resource limits allow, locked into memory, since it
+ * holds state derived from the password.  Return NULL on error.
+ */
+uint8_t *
+crypto_scrypt_checkpoint_alloc(uint64_t N, uint32_t r, uint32_t p)
+{
+	uint8_t * ckpt;
+	size_t len;
+
+	/* How much space do we need? */
+	if ((len = crypto_scrypt_checkpoint_size(N, r, p)) == 0)
+		goto err0;
+
+	/* Get pages of our own; anonymous pages start out zeroed. */
+#ifdef HAVE_MMAP
+	if ((ckpt = mmap(NULL, len, PROT_READ | PROT_WRITE,
+#ifdef MAP_NOCORE
+	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
+#else
+	    MAP_ANON | MAP_PRIVATE,
+#endif
+	    -1, 0)) == MAP_FAILED)
+		goto err0;
+#ifdef MADV_DONTDUMP
+	(void)madvise(ckpt, len, MADV_DONTDUMP);
+#endif
+#else
+	if ((ckpt = calloc(1, len)) == NULL)
+		goto err0;
+#endif
+
+	/*
+	 * Lock them if we can.  Like the arrays of crypto_scrypt_ctx_init(),
+	 * the checkpoint is still usable if resource limits prevent this.
+	 */
+	(void)mlock(ckpt, len);
+
+	/* Success! */
+	return (ckpt);
+
+err0:
+	/* Failure! */
+	return (NULL);
+}
+
+/**
+ * crypto_scrypt_checkpoint_free(ckpt, ckptlen):
+ * Zero and free the ${ckptlen}-byte buffer ${ckpt}, which must have been
+ * allocated by crypto_scrypt_checkpoint_alloc().
+ */
+void
+crypto_scrypt_checkpoint_free(uint8_t * ckpt, size_t ckptlen)
+{
+
+	/* Behave consistently with free(NULL). */
+	if (ckpt == NULL)
+		return;
+
+	/* Zero it, unlock it if it was locked, and give it back. */
+	insecure_memzero(ckpt, ckptlen);
+	(void)munlock(ckpt, ckptlen);
+#ifdef HAVE_MMAP
+	munmap(ckpt, ckptlen);
+#else
+	free(ckpt);
+#endif
+}
+
+/**
+ * crypto_scrypt_resumable(passwd, passwdlen, salt, saltlen, N, r, p, buf,
+ *     buflen, ckpt, ckptlen, callback, cookie):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf, as crypto_scrypt() does, calling
+ * callback(cookie, done, total) as crypto_scrypt_progress() does.  If ${ckpt}
+ * holds a checkpoint of this same computation, carry on from where it was
+ * taken instead of starting over.  If the callback returns non-zero, stop;
+ * then, if ${ckpt} is not NULL, save the state of the computation in it and
+ * set errno to EAGAIN, or otherwise set errno to ECANCELED.  The buffer
+ * ${ckpt} must be ${ckptlen} >= crypto_scrypt_checkpoint_size(N, r, p) bytes
+ * long; if it holds a checkpoint, of this or any other computation, it is
+ * zeroed when the computation completes, but otherwise it is not touched.  A
+ * checkpoint can only be resumed by the same build of this code on the same
+ * CPU, and reveals as much as the derived key does.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_resumable(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen, uint8_t * ckpt, size_t ckptlen,
+    int (*callback)(void *, uint64_t, uint64_t), void * cookie)
+{
+	struct scrypt_checkpoint H;
+	struct smix_progress P;
+	struct smix_scratch S;
+	HMAC_SHA256_CTX Pctx;
+	const struct smix_kernel * K;
+	uint8_t * C;
+	void * B0;
+	uint8_t * B;
+	uint8_t * Bi;
+	uint8_t check[32];
+	uint64_t step;
+	uint64_t i = 0;
+	uint32_t lane = 0;
+	uint32_t loop = 1;
+	int held = 0;
+
+	/* Pick the smix implementation to use the first time through. */
+	if (pthread_once(&smix_once, selectsmix))
+		goto err0;
+	K = smix_lookup(smix_kernels, r);
+
+	/* Sanity-check parameters. */
+	if (checkparams(N, r, p, buflen))
+		goto err0;
+	if ((ckpt != NULL) &&
+	    (ckptlen < crypto_scrypt_checkpoint_size(N, r, p))) {
+		errno = EINVAL;
+		goto err0;
+	}
+
+	/* Allocate memory. */
+#ifdef HAVE_POSIX_MEMALIGN
+	if ((errno = posix_memalign(&B0, 64, 128 * r * p)) != 0)
+		goto err0;
+	B = (uint8_t *)(B0);
+#else
+	if ((B0 = malloc(128 * r * p + 63)) == NULL)
+		goto err0;
+	B = (uint8_t *)(((uintptr_t)(B0) + 63) & ~ (uintptr_t)(63));
+#endif
+	if (scratch_alloc(&S, r, N))
+		goto err1;
+	if ((errno = pthread_mutex_init(&P.mtx, NULL)) != 0)
+		goto err2;
+
+	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+	HMAC_SHA256_Init(&Pctx, passwd, passwdlen);
+	PBKDF2_SHA256_Keyed(&Pctx, salt, saltlen, 1, B, p * 128 * r);
+	memcpy(check, B, 32);
+
+	/* SMix is run ${step} iterations at a time. */
+	step = (N > PROGRESS_INTERVAL) ? PROGRESS_INTERVAL : N;
+
+	/*
+	 * Pick up where we left off, if this is our checkpoint.  It must
+	 * stop at the end of a piece which is ${step} iterations long, or a
+	 * checkpoint taken by a build with a different PROGRESS_INTERVAL
+	 * could have us run SMix past the end of V.
+	 */
+	if (ckpt != NULL) {
+		memcpy(&H, ckpt, sizeof(struct scrypt_checkpoint));
+		held = (memcmp(H.magic, "scryptck", 8) == 0);
+		if (held && (H.N == N) &&
+		    (H.r == r) && (H.p == p) && (H.layout == smix_layout()) &&
+		    (H.lane < p) && ((H.loop == 1) || (H.loop == 2)) &&
+		    (H.i <= N) && (H.i % step == 0) &&
+		    (memcmp(H.check, check, 32) == 0)) {
+			lane = H.lane;
+			loop = H.loop;
+			i = H.i;
+			C = &ckpt[sizeof(struct scrypt_checkpoint)];
+			memcpy(B, C, 128 * r * p);
+			C += 128 * r * p;
+			memcpy(S.XY, C, 128 * r);
+			C += 128 * r;
+			memcpy(S.V, C, 128 * r * ((loop == 1) ? i : N));
+		}
+	}
+
+	/* Start the count at the work already done. */
+	P.callback = callback;
+	P.cookie = cookie;
+	P.done = 2 * N * lane + N * (loop - 1) + i;
+	P.total = 2 * N * p;
+	P.cancelled = 0;
+
+	/* 2: for i = 0 to p - 1 do */
+	for (; lane < p; lane++, loop = 1, i = 0) {
+		Bi = &B[lane * 128 * r];
+
+		/* 3: B_i <-- MF(B_i, N), one piece at a time. */
+		for (; loop <= 2; loop++, i = 0) {
+			for (; i < N; i += step) {
+				if (loop == 1)
+					K->smix1(Bi, r, N, i, i + step, S.V,
+					    S.XY);
+				else
+					K->smix2(Bi, r, N, i, i + step, S.V,
+					    S.XY);
+				if ((callback != NULL) && progress(&P, step)) {
+					i += step;
+					goto stopped;
+				}
+			}
+		}
+	}
+
+	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
+	PBKDF2_SHA256_Keyed(&Pctx, B, p * 128 * r, 1, buf, buflen);
+	insecure_memzero(&Pctx, sizeof(HMAC_SHA256_CTX));
+
+	/*
+	 * The checkpoint is no longer needed.  If the buffer never held one,
+	 * leave it alone: its pages may never have been touched.
+	 */
+	if (held)
+		insecure_memzero(ckpt, crypto_scrypt_checkpoint_size(N, r, p));
+
+	/* Free memory. */
+	pthread_mutex_destroy(&P.mtx);
+	scratch_free(&S);
+	free(B0);
+
+	/* Success! */
+	return (0);
+
+stopped:
+	/* Save our state if we have somewhere to put it. */
+	if (ckpt != NULL) {
+		memset(&H, 0, sizeof(struct scrypt_checkpoint));
+		memcpy(H.magic, "scryptck", 8);
+		H.N = N;
+		H.i = i;
+		H.r = r;
+		H.p = p;
+		H.lane = lane;
+		H.loop = loop;
+		H.layout = smix_layout();
+		memcpy(H.check, check, 32);
+		memcpy(ckpt, &H, sizeof(struct scrypt_checkpoint));
+		C = &ckpt[sizeof(struct scrypt_checkpoint)];
+		memcpy(C, B, 128 * r * p);
+		C += 128 * r * p;
+		memcpy(C, S.XY, 128 * r);
+		C += 128 * r;
+		memcpy(C, S.V, 128 * r * ((loop == 1) ? i : N));
+	}
+
+	/* Don't leave the half-finished computation lying around. */
+	insecure_memzero(&Pctx, sizeof(HMAC_SHA256_CTX));
+	insecure_memzero(check, 32);
+	insecure_memzero(B, 128 * r * p);
+	insecure_memzero(S.XY, 256 * r + 64);
+	insecure_memzero(S.V, 128 * r * N);
+	pthread_mutex_destroy(&P.mtx);
+	scratch_free(&S);
+	free(B0);
+	errno = (ckpt != NULL) ? EAGAIN : ECANCELED;
+	return (-1);
+
+err2:
+	scratch_free(&S);
+err1:
+	free(B0);
+err0:
+	/* Failure! */
+	return (-1);
+}
@@ -0,0 +1,344 @@
+#include "scrypt_platform.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "crypto_scrypt.h"
+
+#include "crypto_scrypt_batch.h"
+
+/*
+ * Each worker owns a deque of job indices.  It takes work from the bottom of
+ * its own deque and, once that is empty, steals from the top of the others'.
+ * Jobs with very different N/r/p take very different times, so a static
+ * split would leave threads idle while one works through the expensive jobs.
+ */
+struct worker {
+	struct batch * batch;
+	pthread_t thr;
+	pthread_mutex_t mtx;
+	size_t * jobs;
+	size_t top;
+	size_t bottom;
+	size_t id;
+};
+
+/* State shared by all of the workers. */
+struct batch {
+	struct crypto_scrypt_job * jobs;
+	struct worker * workers;
+	size_t nworkers;
+	void (*callback)(void *, struct crypto_scrypt_job *);
+	void * cookie;
+
+	/* Memory budget. */
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	size_t maxmem;
+	size_t inuse;
+};
+
+static int take(struct worker *, size_t *);
+static int take_partner(struct worker *, const struct crypto_scrypt_job *,
+    size_t *, size_t *);
+static int steal(struct worker *, size_t *);
+static void budget_acquire(struct batch *, size_t);
+static int budget_tryacquire(struct batch *, size_t);
+static void budget_release(struct batch *, size_t);
+static void runjob(struct worker *, size_t);
+static void * workthread(void *);
+
+/**
+ * take(w, job):
+ * Pop a job index from the bottom of ${w}'s deque into ${job}.  Return
+ * non-zero if the deque was empty.
+ */
+static int
+take(struct worker * w, size_t * job)
+{
+	int empty;
+
+	pthread_mutex_lock(&w->mtx);
+	if ((empty = (w->top == w->bottom)) == 0)
+		*job = w->jobs[--w->bottom];
+	pthread_mutex_unlock(&w->mtx);
+
+	return (empty);
+}
+
+/**
+ * take_partner(w, job, partner, need):
+ * Look in ${w}'s deque for a job with the same N and r as ${job} whose
+ * memory, stored in ${need}, can be reserved from the budget right away.  If
+ * there is one, remove it from the deque, store its index in ${partner} and
+ * return zero; otherwise, return non-zero.
+ */
+static int
+take_partner(struct worker * w, const struct crypto_scrypt_job * job,
+    size_t * partner, size_t * need)
+{
+	struct crypto_scrypt_job * J;
+	size_t i;
+	int found = 0;
+
+	pthread_mutex_lock(&w->mtx);
+	for (i = w->bottom; !found && (i > w->top); i--) {
+		J = &w->batch->jobs[w->jobs[i - 1]];
+		if ((J->N != job->N) || (J->r != job->r))
+			continue;
+		if ((*need = crypto_scrypt_memory(J->N, J->r, J->p)) == 0)
+			continue;
+		if (budget_tryacquire(w->batch, *need))
+			break;
+
+		/* Take it, moving the bottom job into its slot. */
+		*partner = w->jobs[i - 1];
+		w->jobs[i - 1] = w->jobs[--w->bottom];
+		found = 1;
+	}
+	pthread_mutex_unlock(&w->mtx);
+
+	return (!found);
+}
+
+/**
+ * steal(w, job):
+ * Pop a job index from the top of another worker's deque into ${job}, trying
+ * each of the other workers in turn starting with the one after ${w}.
+ * Return non-zero if there was nothing left to steal.
+ */
+static int
+steal(struct worker * w, size_t * job)
+{
+	struct batch * B = w->batch;
+	struct worker * v;
+	size_t i;
+	int empty = 1;
+
+	for (i = 1; empty && (i < B->nworkers); i++) {
+		v = &B->workers[(w->id + i) % B->nworkers];
+		pthread_mutex_lock(&v->mtx);
+		if ((empty = (v->top == v->bottom)) == 0)
+			*job = v->jobs[v->top++];
+		pthread_mutex_unlock(&v->mtx);
+	}
+
+	return (empty);
+}
+
+/**
+ * budget_acquire(B, need):
+ * Wait until ${need} more bytes fit within the memory budget of ${B}, or
+ * until nothing else is running, and then reserve them.
+ */
+static void
+budget_acquire(struct batch * B, size_t need)
+{
+
+	pthread_mutex_lock(&B->mtx);
+	while ((B->maxmem != 0) && (B->inuse != 0) &&
+	    ((B->inuse > B->maxmem) || (need > B->maxmem - B->inuse)))
+		pthread_cond_wait(&B->cv, &B->mtx);
+	B->inuse += need;
+	pthread_mutex_unlock(&B->mtx);
+}
+
+/**
+ * budget_tryacquire(B, need):
+ * Reserve ${need} bytes from the memory budget of ${B} if they fit without
+ * waiting, and return zero; otherwise, return non-zero.
+ */
+static int
+budget_tryacquire(struct batch * B, size_t need)
+{
+	int fits;
+
+	pthread_mutex_lock(&B->mtx);
+	fits = (B->maxmem == 0) ||
+	    ((B->inuse <= B->maxmem) && (need <= B->maxmem - B->inuse));
+	if (fits)
+		B->inuse += need;
+	pthread_mutex_unlock(&B->mtx);
+
+	return (!fits);
+}
+
+/**
+ * budget_release(B, need):
+ * Return ${need} bytes to the memory budget of ${B}.
+ */
+static void
+budget_release(struct batch * B, size_t need)
+{
+
+	pthread_mutex_lock(&B->mtx);
+	B->inuse -= need;
+	pthread_cond_broadcast(&B->cv);
+	pthread_mutex_unlock(&B->mtx);
+}
+
+/**
+ * runjob(w, job):
+ * Run job number ${job} within the memory budget, together with another job
+ * from ${w}'s deque if one has the same N and r and also fits, so that the
+ * two are interleaved by crypto_scrypt_jobs(); then report their completion.
+ */
+static void
+runjob(struct worker * w, size_t job)
+{
+	struct batch * B = w->batch;
+	struct crypto_scrypt_job * jobs[2];
+	size_t need[2];
+	size_t partner;
+	size_t njobs = 1;
+	size_t i;
+
+	/* Invalid parameters need no memory; crypto_scrypt will reject them. */
+	jobs[0] = &B->jobs[job];
+	need[0] = crypto_scrypt_memory(jobs[0]->N, jobs[0]->r, jobs[0]->p);
+	budget_acquire(B, need[0]);
+
+	/* Look for a partner. */
+	if ((need[0] != 0) && !take_partner(w, jobs[0], &partner, &need[1]))
+		jobs[njobs++] = &B->jobs[partner];
+
+	/* Perform the computations. */
+	crypto_scrypt_jobs(jobs, njobs);
+	for (i = 0; i < njobs; i++)
+		budget_release(B, need[i]);
+
+	/* Tell the caller. */
+	for (i = 0; (B->callback != NULL) && (i < njobs); i++)
+		(B->callback)(B->cookie, jobs[i]);
+}
+
+/**
+ * workthread(cookie):
+ * Run jobs from our own deque, then from other workers' deques, until there
+ * are none left anywhere.
+ */
+static void *
+workthread(void * cookie)
+{
+	struct worker * w = cookie;
+	size_t job;
+
+	while (!take(w, &job) || !steal(w, &job))
+		runjob(w, job);
+
+	return (NULL);
+}
+
+/**
+ * crypto_scrypt_batch(jobs, njobs, nthreads, maxmem, callback, cookie):
+ * Compute each of the ${njobs} scrypt computations described by ${jobs},
+ * using up to ${nthreads} threads (including the calling thread).  Jobs are
+ * spread over per-thread queues and idle threads steal work from the others;
+ * a thread runs two jobs with the same N and r together, interleaving their
+ * SMix computations, when the memory budget allows.
+ * If ${maxmem} is non-zero, jobs are only started while the memory needed by
+ * all running jobs stays within ${maxmem} bytes; a job which needs more than
+ * that on its own is run with no other jobs in progress.  As each job
+ * completes, its rc and err fields are filled in and, if ${callback} is not
+ * NULL, callback(cookie, job) is invoked; it may be called from any of the
+ * threads, including concurrently.
+ *
+ * Return 0 once every job has been run (whether or not it succeeded); or -1
+ * if the batch could not be started, in which case no jobs were run.
+ */
+int
+crypto_scrypt_batch(struct crypto_scrypt_job * jobs, size_t njobs,
+    uint32_t nthreads, size_t maxmem,
+    void (*callback)(void *, struct crypto_scrypt_job *), void * cookie)
+{
+	struct batch B;
+	size_t * idx;
+	size_t nspawned;
+	size_t i;
+
+	/* Nothing to do? */
+	if (njobs == 0)
+		return (0);
+
+	/* Don't start more threads than there are jobs. */
+	if (nthreads > njobs)
+		nthreads = (uint32_t)njobs;
+	if (nthreads == 0)
+		nthreads = 1;
+
+	/* Set up the shared state. */
+	B.jobs = jobs;
+	B.nworkers = nthreads;
+	B.callback = callback;
+	B.cookie = cookie;
+	B.maxmem = maxmem;
+	B.inuse = 0;
+	if ((errno = pthread_mutex_init(&B.mtx, NULL)) != 0)
+		goto err0;
+	if ((errno = pthread_cond_init(&B.cv, NULL)) != 0)
+		goto err1;
+
+	/* Allocate the workers and the storage backing their deques. */
+	if ((B.workers = calloc(B.nworkers, sizeof(struct worker))) == NULL)
+		goto err2;
+	if ((idx = malloc(njobs * sizeof(size_t))) == NULL)
+		goto err3;
+
+	/* Deal the jobs out round-robin so each deque gets a similar mix. */
+	for (i = 0; i < B.nworkers; i++) {
+		B.workers[i].batch = &B;
+		B.workers[i].id = i;
+		B.workers[i].jobs = &idx[i * (njobs / B.nworkers) +
+		    (i < njobs % B.nworkers ? i : njobs % B.nworkers)];
+		B.workers[i].top = 0;
+		B.workers[i].bottom = 0;
+		if ((errno = pthread_mutex_init(&B.workers[i].mtx, NULL)) != 0)
+			goto err4;
+	}
+	for (i = 0; i < njobs; i++) {
+		/* Push in reverse so each worker takes its jobs in order. */
+		B.workers[i % B.nworkers].jobs[B.workers[i % B.nworkers].bottom++]
+		    = njobs - 1 - i;
+	}
+
+	/* Start the helper threads; worker 0 is this thread. */
+	for (nspawned = 1; nspawned < B.nworkers; nspawned++) {
+		if (pthread_create(&B.workers[nspawned].thr, NULL, workthread,
+		    &B.workers[nspawned]))
+			break;
+	}
+
+	/* Do our share, and whatever any threads which didn't start left. */
+	workthread(&B.workers[0]);
+
+	/* Wait for the helpers to finish. */
+	for (i = 1; i < nspawned; i++)
+		pthread_join(B.workers[i].thr, NULL);
+
+	/* Clean up. */
+	for (i = 0; i < B.nworkers; i++)
+		pthread_mutex_destroy(&B.workers[i].mtx);
+	free(idx);
+	free(B.workers);
+	pthread_cond_destroy(&B.cv);
+	pthread_mutex_destroy(&B.mtx);
+
+	/* Success! */
+	return (0);
+
+err4:
+	while (i-- > 0)
+		pthread_mutex_destroy(&B.workers[i].mtx);
+	free(idx);
+err3:
+	free(B.workers);
+err2:
+	pthread_cond_destroy(&B.cv);
+err1:
+	pthread_mutex_destroy(&B.mtx);
+err0:
+	/* Failure! */
+	return (-1);
+}
@@ -0,0 +1,239 @@
+#include "scrypt_platform.h"
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "crypto_scrypt.h"
+
+#include "crypto_scrypt_params.h"
+
+/*
+ * Calibration runs scrypt with N = 128 and r = 8: each run does 4Nr = 4096
+ * salsa20/8 cores on 128 kB of V, which stays in cache, so what we measure
+ * is the speed of the core rather than of the memory system.
+ */
+#define CALIB_N		128
+#define CALIB_R		8
+#define CALIB_NS	100000000
+
+/* Cached results of crypto_scrypt_calibrate(). */
+static pthread_mutex_t calib_mtx = PTHREAD_MUTEX_INITIALIZER;
+static int calib_done = 0;
+static double calib_opps;
+static size_t calib_memavail;
+
+static uint64_t now_ns(void);
+static int cpuperf(double *);
+static int memavail(size_t *);
+
+/**
+ * now_ns(void):
+ * Return the time in nanoseconds according to a monotonic clock.
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return (0);
+	return ((uint64_t)(ts.tv_sec) * 1000000000 + (uint64_t)(ts.tv_nsec));
+}
+
+/**
+ * cpuperf(opps):
+ * Store in ${opps} the number of salsa20/8 cores per second which this
+ * thread computes within scrypt.
+ */
+static int
+cpuperf(double * opps)
+{
+	uint8_t buf[32];
+	uint64_t t0, t;
+	uint64_t i;
+
+	/* Warm up: page in the code and get the CPU out of any idle state. */
+	if (crypto_scrypt(&buf[0], 0, &buf[0], 0, CALIB_N, CALIB_R, 1, buf, 32))
+		goto err0;
+
+	/* Count the runs we can do in CALIB_NS nanoseconds. */
+	if ((t0 = now_ns()) == 0)
+		goto err0;
+	i = 0;
+	do {
+		if (crypto_scrypt(&buf[0], 0, &buf[0], 0, CALIB_N, CALIB_R, 1,
+		    buf, 32))
+			goto err0;
+		i++;
+	} while ((t = now_ns()) - t0 < CALIB_NS);
+
+	/* Each run computes 4Nr cores. */
+	*opps = (double)(i * 4 * CALIB_N * CALIB_R) * 1e9 / (double)(t - t0);
+
+	/* Success! */
+	return (0);
+
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * memavail(mem):
+ * Store in ${mem} the amount of memory which this process could use: the
+ * physical memory of the host, less if resource limits say so.
+ */
+static int
+memavail(size_t * mem)
+{
+	struct rlimit rl;
+	uint64_t physmem;
+#ifdef __APPLE__
+	size_t len = sizeof(physmem);
+
+	/* Ask the kernel how much RAM there is. */
+	if (sysctlbyname("hw.memsize", &physmem, &len, NULL, 0))
+		goto err0;
+#else
+	long pages, pagesize;
+
+	/* Count the physical pages. */
+	if (((pages = sysconf(_SC_PHYS_PAGES)) == -1) ||
+	    ((pagesize = sysconf(_SC_PAGESIZE)) == -1))
+		goto err0;
+	physmem = (uint64_t)pages * (uint64_t)pagesize;
+#endif
+
+	/* Respect any limit on our address space. */
+	if ((getrlimit(RLIMIT_AS, &rl) == 0) &&
+	    (rl.rlim_cur != RLIM_INFINITY) && ((uint64_t)rl.rlim_cur < physmem))
+		physmem = (uint64_t)rl.rlim_cur;
+
+	/* We can't use more than we can address. */
+	if (physmem > SIZE_MAX)
+		physmem = SIZE_MAX;
+	*mem = (size_t)physmem;
+
+	/* Success! */
+	return (0);
+
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * crypto_scrypt_calibrate(opps, memavail):
+ * Store in ${opps} the number of salsa20/8 cores per second which one thread
+ * on this host computes within scrypt, and in ${memavail} the amount of
+ * memory which this process could use.  The first call measures these, which
+ * takes about a tenth of a second; later calls return the cached results.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_calibrate(double * opps, size_t * mem)
+{
+
+	pthread_mutex_lock(&calib_mtx);
+
+	/* Measure, if nobody has yet. */
+	if (!calib_done) {
+		if (cpuperf(&calib_opps))
+			goto err1;
+		if (memavail(&calib_memavail))
+			goto err1;
+		calib_done = 1;
+	}
+
+	/* Return the cached values. */
+	*opps = calib_opps;
+	*mem = calib_memavail;
+	pthread_mutex_unlock(&calib_mtx);
+
+	/* Success! */
+	return (0);
+
+err1:
+	pthread_mutex_unlock(&calib_mtx);
+
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * crypto_scrypt_pickparams(maxmem, maxtime, N, r, p):
+ * Store in ${N}, ${r}, and ${p} the most expensive scrypt parameters which
+ * crypto_scrypt() on one thread of this host can compute in no more than
+ * ${maxtime} seconds with V taking no more than ${maxmem} bytes, or half of
+ * the memory available if ${maxmem} is zero or larger than that.  The memory
+ * cost is raised first; p is only raised beyond 1 once memory runs out.
+ * However slow or small the host, at least 2^15 salsa20/8 cores' worth of
+ * work and 1 MiB of memory are used.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+crypto_scrypt_pickparams(size_t maxmem, double maxtime, uint64_t * N,
+    uint32_t * r, uint32_t * p)
+{
+	double opps;
+	double opslimit;
+	double maxN, maxrp;
+	size_t memlimit;
+
+	/* Find out what this host can do. */
+	if (crypto_scrypt_calibrate(&opps, &memlimit))
+		return (-1);
+
+	/* Use no more than half of the memory, or maxmem if that's less. */
+	memlimit /= 2;
+	if ((maxmem != 0) && (maxmem < memlimit))
+		memlimit = maxmem;
+	if (memlimit < 1048576)
+		memlimit = 1048576;
+
+	/* Allow a minimum of 2^15 salsa20/8 cores. */
+	if ((opslimit = opps * maxtime) < 32768)
+		opslimit = 32768;
+
+	/* Fix r = 8 for now. */
+	*r = 8;
+
+	/*
+	 * The memory limit requires that 128Nr <= memlimit, while the CPU
+	 * limit requires that 4Nrp <= opslimit.  If opslimit < memlimit/32,
+	 * opslimit imposes the stronger limit on N.
+	 */
+	if (opslimit < (double)memlimit / 32) {
+		/* Set p = 1 and choose N based on the CPU limit. */
+		*p = 1;
+		maxN = opslimit / (*r * 4);
+		for (*N = 2; *N <= maxN / 2; *N <<= 1)
+			continue;
+	} else {
+		/* Set N based on the memory limit. */
+		maxN = (double)memlimit / (*r * 128);
+		for (*N = 2; *N <= maxN / 2; *N <<= 1)
+			continue;
+
+		/* Choose p based on the CPU limit. */
+		maxrp = (opslimit / 4) / (double)(*N);
+		if (maxrp > 0x3fffffff)
+			maxrp = 0x3fffffff;
+		*p = (uint32_t)(maxrp) / *r;
+		if (*p == 0)
+			*p = 1;
+	}
+
+	/* Success! */
+	return (0);
+}
@@ -0,0 +1,343 @@
+#include "scrypt_platform.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "crypto_scrypt.h"
+
+#include "crypto_scrypt_sched.h"
+
+/* A queued job. */
+struct job {
+	struct job * next;
+	void (*run)(void *, size_t);
+	void * cookie;
+	size_t need;
+	uint64_t queued_ns;
+};
+
+/*
+ * Jobs wait in one FIFO per priority.  Only the job at the head of the most
+ * urgent non-empty queue is ever considered for admission: letting smaller
+ * jobs past it whenever they fit would keep memory busier, but a large
+ * interactive job could then wait behind an endless stream of small ones.
+ */
+struct crypto_scrypt_sched {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	pthread_t * thr;
+	uint32_t nthr;
+	int stopping;
+
+	/* Queues, by priority. */
+	struct job * head[CRYPTO_SCRYPT_NPRIO];
+	struct job ** tail[CRYPTO_SCRYPT_NPRIO];
+
+	/* Memory budget. */
+	size_t maxmem;
+
+	/* Everything reported by crypto_scrypt_sched_stats(). */
+	struct crypto_scrypt_sched_stats stats;
+};
+
+static uint64_t now_ns(void);
+static struct job * admit(struct crypto_scrypt_sched *);
+static void * workthread(void *);
+
+/**
+ * now_ns(void):
+ * Return the time in nanoseconds according to a monotonic clock.
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return (0);
+	return ((uint64_t)(ts.tv_sec) * 1000000000 + (uint64_t)(ts.tv_nsec));
+}
+
+/**
+ * admit(S):
+ * If the most urgent job queued on ${S} fits within the memory budget,
+ * remove it from its queue, reserve its memory, and return it; otherwise,
+ * return NULL.  Must be called with ${S}'s mutex held.
+ */
+static struct job *
+admit(struct crypto_scrypt_sched * S)
+{
+	struct crypto_scrypt_sched_stats * st = &S->stats;
+	struct job * J;
+	uint64_t wait;
+	int prio;
+
+	/* Find the most urgent job. */
+	for (prio = 0; prio < CRYPTO_SCRYPT_NPRIO; prio++) {
+		if (S->head[prio] != NULL)
+			break;
+	}
+	if (prio == CRYPTO_SCRYPT_NPRIO)
+		return (NULL);
+	J = S->head[prio];
+
+	/* Does it fit? */
+	if ((S->maxmem != 0) && (J->need > S->maxmem - st->inuse))
+		return (NULL);
+
+	/* Take it off the queue. */
+	if ((S->head[prio] = J->next) == NULL)
+		S->tail[prio] = &S->head[prio];
+	st->queued[prio]--;
+
+	/* Reserve its memory. */
+	st->running++;
+	st->inuse += J->need;
+	if (st->inuse_peak < st->inuse)
+		st->inuse_peak = st->inuse;
+
+	/* Record how long it waited. */
+	wait = now_ns() - J->queued_ns;
+	st->started[prio]++;
+	st->wait_ns[prio] += wait;
+	if (st->wait_max_ns[prio] < wait)
+		st->wait_max_ns[prio] = wait;
+
+	return (J);
+}
+
+/**
+ * workthread(cookie):
+ * Run jobs from the scheduler ${cookie} as they are admitted, until it is
+ * stopping and there are none left.
+ */
+static void *
+workthread(void * cookie)
+{
+	struct crypto_scrypt_sched * S = cookie;
+	struct job * J;
+	int prio;
+
+	pthread_mutex_lock(&S->mtx);
+	for (;;) {
+		/* Wait for a job which fits, or for the end. */
+		while ((J = admit(S)) == NULL) {
+			for (prio = 0; prio < CRYPTO_SCRYPT_NPRIO; prio++) {
+				if (S->head[prio] != NULL)
+					break;
+			}
+			if (S->stopping && (prio == CRYPTO_SCRYPT_NPRIO))
+				goto done;
+			pthread_cond_wait(&S->cv, &S->mtx);
+		}
+
+		/* Run it without holding the lock. */
+		pthread_mutex_unlock(&S->mtx);
+		(J->run)(J->cookie, J->need);
+		pthread_mutex_lock(&S->mtx);
+
+		/* Give its memory back and let the other threads look. */
+		S->stats.running--;
+		S->stats.inuse -= J->need;
+		pthread_cond_broadcast(&S->cv);
+		free(J);
+	}
+
+done:
+	pthread_mutex_unlock(&S->mtx);
+	return (NULL);
+}
+
+/**
+ * crypto_scrypt_sched_init(maxmem, nworkers):
+ * Create a scheduler which runs scrypt computations on ${nworkers} threads
+ * of its own, starting them only while the memory reserved by all running
+ * jobs stays within ${maxmem} bytes.  A job which needs more than that is
+ * given ${maxmem} bytes and run with no other jobs in progress.  Waiting jobs
+ * are started in order of priority and then of submission; a job never
+ * overtakes one of higher priority, even if it would fit in the budget and
+ * the other won't.  If ${maxmem} is zero, jobs are limited only by the number
+ * of threads.
+ */
+struct crypto_scrypt_sched *
+crypto_scrypt_sched_init(size_t maxmem, uint32_t nworkers)
+{
+	struct crypto_scrypt_sched * S;
+	int prio;
+
+	/* We need at least one thread. */
+	if (nworkers == 0)
+		nworkers = 1;
+
+	/* Allocate the structure and the thread IDs. */
+	if ((S = calloc(1, sizeof(struct crypto_scrypt_sched))) == NULL)
+		goto err0;
+	if ((S->thr = malloc(nworkers * sizeof(pthread_t))) == NULL)
+		goto err1;
+
+	/* Set up the shared state. */
+	S->maxmem = maxmem;
+	S->stopping = 0;
+	for (prio = 0; prio < CRYPTO_SCRYPT_NPRIO; prio++) {
+		S->head[prio] = NULL;
+		S->tail[prio] = &S->head[prio];
+	}
+	if ((errno = pthread_mutex_init(&S->mtx, NULL)) != 0)
+		goto err2;
+	if ((errno = pthread_cond_init(&S->cv, NULL)) != 0)
+		goto err3;
+
+	/* Start the threads. */
+	for (S->nthr = 0; S->nthr < nworkers; S->nthr++) {
+		if ((errno = pthread_create(&S->thr[S->nthr], NULL,
+		    workthread, S)) != 0)
+			goto err4;
+	}
+
+	/* Success! */
+	return (S);
+
+err4:
+	/* Stop whichever threads did start. */
+	pthread_mutex_lock(&S->mtx);
+	S->stopping = 1;
+	pthread_cond_broadcast(&S->cv);
+	pthread_mutex_unlock(&S->mtx);
+	while (S->nthr > 0)
+		pthread_join(S->thr[--S->nthr], NULL);
+	pthread_cond_destroy(&S->cv);
+err3:
+	pthread_mutex_destroy(&S->mtx);
+err2:
+	free(S->thr);
+err1:
+	free(S);
+err0:
+	/* Failure! */
+	return (NULL);
+}
+
+/**
+ * crypto_scrypt_sched_need(N, r, p, nthreads):
+ * Return the number of bytes of memory which crypto_scrypt_threads() uses
+ * when called with the parameters N, r, p and ${nthreads}, and no limit on
+ * memory; or 0 if it would reject the parameters.
+ */
+size_t
+crypto_scrypt_sched_need(uint64_t N, uint32_t r, uint32_t p,
+    uint32_t nthreads)
+{
+	size_t need, lanemem;
+	uint32_t lanes;
+
+	/* One SMix instance, and all of B. */
+	if ((need = crypto_scrypt_memory(N, r, p)) == 0)
+		return (0);
+
+	/* Each extra thread has its own V and XY. */
+	lanes = (nthreads < p) ? nthreads : p;
+	lanemem = 128 * r * N + 256 * r + 64;
+	if ((lanes > 1) && (lanemem > (SIZE_MAX - need) / (lanes - 1)))
+		return (0);
+	if (lanes > 1)
+		need += (lanes - 1) * lanemem;
+
+	return (need);
+}
+
+/**
+ * crypto_scrypt_sched_submit(S, need, prio, run, cookie):
+ * Queue a job needing ${need} bytes of memory with priority ${prio} (one of
+ * the CRYPTO_SCRYPT_PRIO_* values) on the scheduler ${S}.  Once it has been
+ * admitted, run(cookie, maxmem) is invoked on one of the scheduler's threads;
+ * it should pass ${maxmem}, which is the number of bytes reserved for it (no
+ * more than ${need}, and no more than the scheduler's budget), as the memory
+ * limit of the scrypt computation it performs.
+ */
+int
+crypto_scrypt_sched_submit(struct crypto_scrypt_sched * S, size_t need,
+    int prio, void (*run)(void *, size_t), void * cookie)
+{
+	struct job * J;
+
+	/* Sanity-check the priority. */
+	if ((prio < 0) || (prio >= CRYPTO_SCRYPT_NPRIO)) {
+		errno = EINVAL;
+		goto err0;
+	}
+
+	/* Record the job. */
+	if ((J = malloc(sizeof(struct job))) == NULL)
+		goto err0;
+	J->next = NULL;
+	J->run = run;
+	J->cookie = cookie;
+	J->need = need;
+	J->queued_ns = now_ns();
+
+	/* Something too big for the budget will have to make do with it all. */
+	if ((S->maxmem != 0) && (J->need > S->maxmem))
+		J->need = S->maxmem;
+
+	/* Add it to the end of its queue and wake the threads. */
+	pthread_mutex_lock(&S->mtx);
+	*S->tail[prio] = J;
+	S->tail[prio] = &J->next;
+	S->stats.queued[prio]++;
+	pthread_cond_broadcast(&S->cv);
+	pthread_mutex_unlock(&S->mtx);
+
+	/* Success! */
+	return (0);
+
+err0:
+	/* Failure! */
+	return (-1);
+}
+
+/**
+ * crypto_scrypt_sched_stats(S, stats):
+ * Fill in ${stats} with the current state of the scheduler ${S}.
+ */
+void
+crypto_scrypt_sched_stats(struct crypto_scrypt_sched * S,
+    struct crypto_scrypt_sched_stats * stats)
+{
+
+	pthread_mutex_lock(&S->mtx);
+	*stats = S->stats;
+	pthread_mutex_unlock(&S->mtx);
+}
+
+/**
+ * crypto_scrypt_sched_free(S):
+ * Wait for every job submitted to ${S} to finish, then stop its threads and
+ * free it.
+ */
+void
+crypto_scrypt_sched_free(struct crypto_scrypt_sched * S)
+{
+
+	/* Behave consistently with free(NULL). */
+	if (S == NULL)
+		return;
+
+	/* Tell the threads to exit once the queues are empty. */
+	pthread_mutex_lock(&S->mtx);
+	S->stopping = 1;
+	pthread_cond_broadcast(&S->cv);
+	pthread_mutex_unlock(&S->mtx);
+
+	/* Wait for them. */
+	while (S->nthr > 0)
+		pthread_join(S->thr[--S->nthr], NULL);
+
+	/* Free everything. */
+	pthread_cond_destroy(&S->cv);
+	pthread_mutex_destroy(&S->mtx);
+	free(S->thr);
+	free(S);
+}
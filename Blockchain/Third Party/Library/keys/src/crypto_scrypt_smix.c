@@ -0,0 +1,624 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#include "scrypt_platform.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sysendian.h"
+
+#include "crypto_scrypt_smix.h"
+
+/*
+ * Non-temporal stores, if the compiler gives us a portable way to ask for
+ * them; see blkcpy_stream().
+ */
+#ifdef __has_builtin
+#if __has_builtin(__builtin_nontemporal_store)
+#define HAVE_NONTEMPORAL_STORE 1
+#endif
+#endif
+
+static SMIX_INLINE void blkcpy(void *, void *, size_t);
+static SMIX_INLINE void blkcpy_stream(void *, void *, size_t);
+static void stream_fence(void);
+static SMIX_INLINE void blkxor(void *, void *, size_t);
+static SMIX_INLINE void salsa20_8_xor(uint32_t[16], const uint32_t[16],
+    uint32_t[16]);
+static SMIX_INLINE void blockmix_salsa8(uint32_t *, uint32_t *, size_t);
+static SMIX_INLINE void blockmix_salsa8_fill(uint32_t *, uint32_t *,
+    uint32_t *, size_t);
+static SMIX_INLINE uint64_t integerify(void *, size_t);
+static void prefetch(const void *, size_t);
+static SMIX_INLINE void smix1(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+static SMIX_INLINE void smix2(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+static SMIX_INLINE void smix1_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+static SMIX_INLINE void smix2_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+static SMIX_INLINE uint32_t * tmto_block(uint32_t *, uint64_t, uint64_t,
+    uint32_t *, uint32_t *, size_t);
+static SMIX_INLINE void smix_tmto(uint8_t *, size_t, uint64_t, uint64_t,
+    void *, void *);
+
+static SMIX_INLINE void
+blkcpy(void * dest, void * src, size_t len)
+{
+	size_t * D = dest;
+	size_t * S = src;
+	size_t L = len / sizeof(size_t);
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		D[i] = S[i];
+}
+
+/**
+ * blkcpy_stream(dest, src, len):
+ * Copy ${len} bytes from ${src} to ${dest} with non-temporal stores, which
+ * write to memory without first reading the destination into the cache or
+ * evicting anything from it; or with ordinary stores if the compiler can't
+ * generate non-temporal ones.
+ */
+static SMIX_INLINE void
+blkcpy_stream(void * dest, void * src, size_t len)
+{
+#ifdef HAVE_NONTEMPORAL_STORE
+	size_t * D = dest;
+	size_t * S = src;
+	size_t L = len / sizeof(size_t);
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		__builtin_nontemporal_store(S[i], &D[i]);
+#else
+	blkcpy(dest, src, len);
+#endif
+}
+
+/**
+ * stream_fence(void):
+ * Wait until the stores made by blkcpy_stream() are visible everywhere.
+ */
+static void
+stream_fence(void)
+{
+
+#ifdef HAVE_NONTEMPORAL_STORE
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+static SMIX_INLINE void
+blkxor(void * dest, void * src, size_t len)
+{
+	size_t * D = dest;
+	size_t * S = src;
+	size_t L = len / sizeof(size_t);
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		D[i] ^= S[i];
+}
+
+/**
+ * salsa20_8_xor(B, Bin, Bout):
+ * Apply the salsa20/8 core to B xor Bin, storing the result in both B and
+ * Bout.
+ */
+static SMIX_INLINE void
+salsa20_8_xor(uint32_t B[16], const uint32_t Bin[16], uint32_t Bout[16])
+{
+	uint32_t x[16];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i] ^= Bin[i];
+	for (i = 0; i < 8; i += 2) {
+#define R(a,b) (((a) << (b)) | ((a) >> (32 - (b))))
+		/* Operate on columns. */
+		x[ 4] ^= R(x[ 0]+x[12], 7);  x[ 8] ^= R(x[ 4]+x[ 0], 9);
+		x[12] ^= R(x[ 8]+x[ 4],13);  x[ 0] ^= R(x[12]+x[ 8],18);
+
+		x[ 9] ^= R(x[ 5]+x[ 1], 7);  x[13] ^= R(x[ 9]+x[ 5], 9);
+		x[ 1] ^= R(x[13]+x[ 9],13);  x[ 5] ^= R(x[ 1]+x[13],18);
+
+		x[14] ^= R(x[10]+x[ 6], 7);  x[ 2] ^= R(x[14]+x[10], 9);
+		x[ 6] ^= R(x[ 2]+x[14],13);  x[10] ^= R(x[ 6]+x[ 2],18);
+
+		x[ 3] ^= R(x[15]+x[11], 7);  x[ 7] ^= R(x[ 3]+x[15], 9);
+		x[11] ^= R(x[ 7]+x[ 3],13);  x[15] ^= R(x[11]+x[ 7],18);
+
+		/* Operate on rows. */
+		x[ 1] ^= R(x[ 0]+x[ 3], 7);  x[ 2] ^= R(x[ 1]+x[ 0], 9);
+		x[ 3] ^= R(x[ 2]+x[ 1],13);  x[ 0] ^= R(x[ 3]+x[ 2],18);
+
+		x[ 6] ^= R(x[ 5]+x[ 4], 7);  x[ 7] ^= R(x[ 6]+x[ 5], 9);
+		x[ 4] ^= R(x[ 7]+x[ 6],13);  x[ 5] ^= R(x[ 4]+x[ 7],18);
+
+		x[11] ^= R(x[10]+x[ 9], 7);  x[ 8] ^= R(x[11]+x[10], 9);
+		x[ 9] ^= R(x[ 8]+x[11],13);  x[10] ^= R(x[ 9]+x[ 8],18);
+
+		x[12] ^= R(x[15]+x[14], 7);  x[13] ^= R(x[12]+x[15], 9);
+		x[14] ^= R(x[13]+x[12],13);  x[15] ^= R(x[14]+x[13],18);
+#undef R
+	}
+	for (i = 0; i < 16; i++)
+		Bout[i] = B[i] += x[i];
+}
+
+/**
+ * blockmix_salsa8(Bin, Bout, r):
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin).  The input Bin must be 128r
+ * bytes in length; the output Bout must also be the same size.
+ */
+static SMIX_INLINE void
+blockmix_salsa8(uint32_t * Bin, uint32_t * Bout, size_t r)
+{
+	uint32_t X[16];
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	blkcpy(X, &Bin[(2 * r - 1) * 16], 64);
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < 2 * r; i += 2) {
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 16], &Bout[i * 8]);
+
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 16 + 16], &Bout[i * 8 + r * 16]);
+	}
+}
+
+/**
+ * blockmix_salsa8_fill(Bin, Bout, Vout, r):
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin) as blockmix_salsa8() does, and
+ * also copy Bout to ${Vout} with blkcpy_stream() as each 64-byte piece of it
+ * comes out of salsa20/8, while it is still in L1 cache.  The first loop of
+ * SMix fills V this way, since V is not read again until the second loop.
+ */
+static SMIX_INLINE void
+blockmix_salsa8_fill(uint32_t * Bin, uint32_t * Bout, uint32_t * Vout,
+    size_t r)
+{
+	uint32_t X[16];
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	blkcpy(X, &Bin[(2 * r - 1) * 16], 64);
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < 2 * r; i += 2) {
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 16], &Bout[i * 8]);
+		blkcpy_stream(&Vout[i * 8], X, 64);
+
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 16 + 16], &Bout[i * 8 + r * 16]);
+		blkcpy_stream(&Vout[i * 8 + r * 16], X, 64);
+	}
+}
+
+/**
+ * integerify(B, r):
+ * Return the result of parsing B_{2r-1} as a little-endian integer.
+ */
+static SMIX_INLINE uint64_t
+integerify(void * B, size_t r)
+{
+	uint32_t * X = (void *)((uintptr_t)(B) + (2 * r - 1) * 64);
+
+	return (((uint64_t)(X[1]) << 32) + X[0]);
+}
+
+/**
+ * prefetch(p, len):
+ * Hint that the ${len} bytes at ${p} will be read soon.
+ */
+static void
+prefetch(const void * p, size_t len)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	const uint8_t * P = p;
+	size_t i;
+
+	for (i = 0; i < len; i += 64)
+		__builtin_prefetch(&P[i]);
+#else
+	(void)p; /* UNUSED */
+	(void)len; /* UNUSED */
+#endif
+}
+
+/**
+ * smix1(B, r, N, i0, i1, V, XY):
+ * Compute the first loop of SMix_r(B, N), as described for
+ * crypto_scrypt_smix1().  This is always inlined, so that callers passing a
+ * constant r get a copy with every length and offset known at compile time.
+ */
+static SMIX_INLINE void
+smix1(uint8_t * B, size_t r, uint64_t N, uint64_t i0, uint64_t i1,
+    void * _V, void * XY)
+{
+	uint32_t * V = _V;
+	uint32_t * X = XY;
+	uint32_t * Y = (void *)((uint8_t *)(XY) + 128 * r);
+	uint64_t i;
+
+	(void)N; /* UNUSED */
+
+	/* 1: X <-- B */
+	if (i0 == 0)
+		le32dec_vec(X, B, 32 * r);
+
+	/*
+	 * 3: V_i <-- X, for the first i of this call; each later V_i is
+	 * written as it comes out of BlockMix.  The last X we compute is left
+	 * for the next call to store.
+	 */
+	if (i0 < i1)
+		blkcpy_stream(&V[i0 * (32 * r)], X, 128 * r);
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i += 2) {
+		/* 4: X <-- H(X); 3: V_i <-- X */
+		blockmix_salsa8_fill(X, Y, &V[(i + 1) * (32 * r)], r);
+
+		/* 4: X <-- H(X); 3: V_i <-- X */
+		if (i + 2 < i1)
+			blockmix_salsa8_fill(Y, X, &V[(i + 2) * (32 * r)], r);
+		else
+			blockmix_salsa8(Y, X, r);
+	}
+
+	/* Make sure V is in memory before anyone reads it. */
+	stream_fence();
+}
+
+/**
+ * smix2(B, r, N, i0, i1, V, XY):
+ * Compute the second loop of SMix_r(B, N), as described for
+ * crypto_scrypt_smix2().  This is always inlined, as smix1() is.
+ */
+static SMIX_INLINE void
+smix2(uint8_t * B, size_t r, uint64_t N, uint64_t i0, uint64_t i1,
+    void * _V, void * XY)
+{
+	uint32_t * V = _V;
+	uint32_t * X = XY;
+	uint32_t * Y = (void *)((uint8_t *)(XY) + 128 * r);
+	uint64_t i;
+	uint64_t j;
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i += 2) {
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(X, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(X, &V[j * (32 * r)], 128 * r);
+		blockmix_salsa8(X, Y, r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(Y, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(Y, &V[j * (32 * r)], 128 * r);
+		blockmix_salsa8(Y, X, r);
+	}
+
+	/* 10: B' <-- X */
+	if (i1 == N)
+		le32enc_vec(B, X, 32 * r);
+}
+
+/**
+ * smix1_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute the first loop of SMix_r(B[k], N) for k = 0 ... n - 1, as
+ * described for crypto_scrypt_smix1_multi().  This is always inlined, as
+ * smix1() is.
+ */
+static SMIX_INLINE void
+smix1_multi(uint8_t ** B, size_t n, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void ** V, void ** XY)
+{
+	uint32_t * X[SMIX_MULTI_MAX];
+	uint32_t * Y[SMIX_MULTI_MAX];
+	uint32_t * T;
+	uint64_t i;
+	size_t m;
+
+	(void)N; /* UNUSED */
+
+	for (m = 0; m < n; m++) {
+		X[m] = XY[m];
+		Y[m] = (void *)((uint8_t *)(XY[m]) + 128 * r);
+
+		/* 1: X <-- B */
+		if (i0 == 0)
+			le32dec_vec(X[m], B[m], 32 * r);
+
+		/* 3: V_i <-- X, for the first i; see smix1(). */
+		if (i0 < i1)
+			blkcpy_stream((uint32_t *)(V[m]) + i0 * (32 * r),
+			    X[m], 128 * r);
+	}
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i++) {
+		for (m = 0; m < n; m++) {
+			/* 4: X <-- H(X); 3: V_i <-- X */
+			if (i + 1 < i1)
+				blockmix_salsa8_fill(X[m], Y[m],
+				    (uint32_t *)(V[m]) + (i + 1) * (32 * r),
+				    r);
+			else
+				blockmix_salsa8(X[m], Y[m], r);
+			T = X[m];
+			X[m] = Y[m];
+			Y[m] = T;
+		}
+	}
+
+	/* Make sure V is in memory before anyone reads it. */
+	stream_fence();
+
+	/* i1 - i0 is even, so X has ended up back at the start of XY. */
+}
+
+/**
+ * smix2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute the second loop of SMix_r(B[k], N) for k = 0 ... n - 1, as
+ * described for crypto_scrypt_smix2_multi().  This is always inlined, as
+ * smix1() is.
+ */
+static SMIX_INLINE void
+smix2_multi(uint8_t ** B, size_t n, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void ** V, void ** XY)
+{
+	uint32_t * X[SMIX_MULTI_MAX];
+	uint32_t * Y[SMIX_MULTI_MAX];
+	uint32_t * T;
+	uint64_t j[SMIX_MULTI_MAX];
+	uint64_t i;
+	size_t m;
+
+	for (m = 0; m < n; m++) {
+		X[m] = XY[m];
+		Y[m] = (void *)((uint8_t *)(XY[m]) + 128 * r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		j[m] = integerify(X[m], r) & (N - 1);
+		prefetch((uint32_t *)(V[m]) + j[m] * (32 * r), 128 * r);
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i++) {
+		for (m = 0; m < n; m++) {
+			/* 8: X <-- H(X \xor V_j) */
+			blkxor(X[m], (uint32_t *)(V[m]) + j[m] * (32 * r),
+			    128 * r);
+			blockmix_salsa8(X[m], Y[m], r);
+			T = X[m];
+			X[m] = Y[m];
+			Y[m] = T;
+
+			/* 7: j <-- Integerify(X) mod N */
+			j[m] = integerify(X[m], r) & (N - 1);
+			prefetch((uint32_t *)(V[m]) + j[m] * (32 * r),
+			    128 * r);
+		}
+	}
+
+	/* 10: B' <-- X */
+	for (m = 0; (i1 == N) && (m < n); m++)
+		le32enc_vec(B[m], X[m], 32 * r);
+}
+
+/**
+ * tmto_block(V, j, k, Z0, Z1, r):
+ * Return a pointer to V_j, where V holds only V_0, V_k, V_{2k} ..., by
+ * applying BlockMix to the nearest block stored before it as often as
+ * needed, using Z0 and Z1 for the results.  The value k must be a power of 2.
+ */
+static SMIX_INLINE uint32_t *
+tmto_block(uint32_t * V, uint64_t j, uint64_t k, uint32_t * Z0, uint32_t * Z1,
+    size_t r)
+{
+	uint32_t * T = &V[(j / k) * (32 * r)];
+	uint32_t * U;
+	uint64_t n;
+
+	for (n = j & (k - 1); n > 0; n--) {
+		U = (T == Z0) ? Z1 : Z0;
+		blockmix_salsa8(T, U, r);
+		T = U;
+	}
+
+	return (T);
+}
+
+/**
+ * smix_tmto(B, r, N, k, V, XY):
+ * Compute B = SMix_r(B, N), as described for crypto_scrypt_smix_tmto().
+ * This is always inlined, as smix1() is.
+ */
+static SMIX_INLINE void
+smix_tmto(uint8_t * B, size_t r, uint64_t N, uint64_t k, void * _V, void * XY)
+{
+	uint32_t * V = _V;
+	uint32_t * X = XY;
+	uint32_t * Y = (void *)((uint8_t *)(XY) + 128 * r);
+	uint32_t * Z0 = &V[(N / k) * (32 * r)];
+	uint32_t * Z1 = &V[(N / k + 1) * (32 * r)];
+	uint32_t * T;
+	uint64_t i;
+	uint64_t j;
+
+	/* 1: X <-- B */
+	le32dec_vec(X, B, 32 * r);
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 3: V_i <-- X, if i is a multiple of k */
+		if ((i & (k - 1)) == 0)
+			blkcpy(&V[(i / k) * (32 * r)], X, 128 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(X, Y, r);
+		T = X;
+		X = Y;
+		Y = T;
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(X, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j), recomputing V_j if needed */
+		blkxor(X, tmto_block(V, j, k, Z0, Z1, r), 128 * r);
+		blockmix_salsa8(X, Y, r);
+		T = X;
+		X = Y;
+		Y = T;
+	}
+
+	/* 10: B' <-- X */
+	le32enc_vec(B, X, 32 * r);
+}
+
+/**
+ * crypto_scrypt_smix1(B, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the first loop of SMix_r(B, N),
+ * filling V_{i0} ... V_{i1 - 1}.  X is read from B if i0 is zero, and is
+ * otherwise the one left in the first 128r bytes of XY by the previous call;
+ * it is left there in turn for the next call or crypto_scrypt_smix2().  The
+ * input B must be 128r bytes in length; the temporary storage V must be
+ * 128rN bytes in length; the temporary storage XY must be 256r + 64 bytes in
+ * length.  The value N must be a power of 2 greater than 1, and i0 and i1
+ * must be even with i0 < i1 <= N.  The arrays B, V, and XY must be aligned
+ * to a multiple of 64 bytes.
+ */
+void
+crypto_scrypt_smix1(uint8_t * B, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void * V, void * XY)
+{
+
+	smix1(B, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix2(B, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the second loop of SMix_r(B, N),
+ * continuing from the V and XY left by crypto_scrypt_smix1() or by the
+ * previous call, and write the result to B if i1 is N.
+ */
+void
+crypto_scrypt_smix2(uint8_t * B, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void * V, void * XY)
+{
+
+	smix2(B, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix1_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the first loop of SMix_r(B[k], N) for
+ * k = 0 ... n - 1, where V[k] and XY[k] are the temporary storage for B[k]
+ * as described for crypto_scrypt_smix1().  The n computations are
+ * interleaved one BlockMix at a time.  The value n must be between 1 and
+ * SMIX_MULTI_MAX.
+ */
+void
+crypto_scrypt_smix1_multi(uint8_t ** B, size_t n, size_t r, uint64_t N,
+    uint64_t i0, uint64_t i1, void ** V, void ** XY)
+{
+
+	smix1_multi(B, n, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute iterations i0 ... i1 - 1 of the second loop of SMix_r(B[k], N)
+ * for k = 0 ... n - 1, continuing from the V[k] and XY[k] left by
+ * crypto_scrypt_smix1_multi() or by the previous call, and write the results
+ * to B[k] if i1 is N.  The n computations are interleaved one BlockMix at a
+ * time, and the V_j block each computation needs next is prefetched as soon
+ * as j is known, so the memory latency of one computation is hidden behind
+ * the others' work.
+ */
+void
+crypto_scrypt_smix2_multi(uint8_t ** B, size_t n, size_t r, uint64_t N,
+    uint64_t i0, uint64_t i1, void ** V, void ** XY)
+{
+
+	smix2_multi(B, n, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix_tmto(B, r, N, k, V, XY):
+ * Compute B = SMix_r(B, N), keeping only every ${k}th block of V and
+ * recomputing the others as they are needed.  The temporary storage V must
+ * be 128r(N/k + 2) bytes in length; the value k must be a power of 2 no
+ * greater than N; the other requirements are those of crypto_scrypt_smix1().
+ */
+void
+crypto_scrypt_smix_tmto(uint8_t * B, size_t r, uint64_t N, uint64_t k,
+    void * V, void * XY)
+{
+
+	smix_tmto(B, r, N, k, V, XY);
+}
+
+/* Copies of SMix specialized for the values of r which are used in practice. */
+SMIX_FIXED_R(1)
+SMIX_FIXED_R(8)
+SMIX_FIXED_R(16)
+
+/* SMix kernels using only portable C. */
+const struct smix_kernel crypto_scrypt_smix_kernels[] = {
+	SMIX_KERNEL_R(1),
+	SMIX_KERNEL_R(8),
+	SMIX_KERNEL_R(16),
+	{ 0, crypto_scrypt_smix1, crypto_scrypt_smix2,
+	    crypto_scrypt_smix1_multi, crypto_scrypt_smix2_multi,
+	    crypto_scrypt_smix_tmto }
+};
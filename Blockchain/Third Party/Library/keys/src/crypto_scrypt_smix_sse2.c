@@ -0,0 +1,660 @@
+/*-
+ * Copyright 2009 Colin Percival
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+#include "scrypt_platform.h"
+
+#ifdef CPUSUPPORT_X86_SSE2
+
+#include <emmintrin.h>
+#include <stdint.h>
+
+#include "crypto_scrypt_smix.h"
+#include "sysendian.h"
+
+#include "crypto_scrypt_smix_sse2.h"
+
+static SMIX_INLINE void blkcpy(__m128i *, const __m128i *, size_t);
+static SMIX_INLINE void blkcpy_stream(__m128i *, const __m128i *, size_t);
+static SMIX_INLINE void blkxor(__m128i *, const __m128i *, size_t);
+static SMIX_INLINE void salsa20_8_xor(__m128i[4], const __m128i[4],
+    __m128i[4]);
+static SMIX_INLINE void blockmix_salsa8(const __m128i *, __m128i *, size_t);
+static SMIX_INLINE void blockmix_salsa8_fill(const __m128i *, __m128i *,
+    __m128i *, size_t);
+static SMIX_INLINE uint64_t integerify(const void *, size_t);
+static void prefetch(const void *, size_t);
+static SMIX_INLINE void smix1(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+static SMIX_INLINE void smix2(uint8_t *, size_t, uint64_t, uint64_t,
+    uint64_t, void *, void *);
+static SMIX_INLINE void smix1_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+static SMIX_INLINE void smix2_multi(uint8_t **, size_t, size_t, uint64_t,
+    uint64_t, uint64_t, void **, void **);
+static SMIX_INLINE const __m128i * tmto_block(const __m128i *, uint64_t,
+    uint64_t, __m128i *, __m128i *, size_t);
+static SMIX_INLINE void smix_tmto(uint8_t *, size_t, uint64_t, uint64_t,
+    void *, void *);
+
+static SMIX_INLINE void
+blkcpy(__m128i * D, const __m128i * S, size_t len)
+{
+	size_t L = len / 16;
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		D[i] = S[i];
+}
+
+/**
+ * blkcpy_stream(D, S, len):
+ * Copy ${len} bytes from ${S} to ${D} with non-temporal stores, which write
+ * to memory without first reading the destination into the cache or
+ * evicting anything from it.
+ */
+static SMIX_INLINE void
+blkcpy_stream(__m128i * D, const __m128i * S, size_t len)
+{
+	size_t L = len / 16;
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		_mm_stream_si128(&D[i], S[i]);
+}
+
+static SMIX_INLINE void
+blkxor(__m128i * D, const __m128i * S, size_t len)
+{
+	size_t L = len / 16;
+	size_t i;
+
+	for (i = 0; i < L; i++)
+		D[i] = _mm_xor_si128(D[i], S[i]);
+}
+
+/**
+ * salsa20_8_xor(B, Bin, Bout):
+ * Apply the salsa20/8 core to B xor Bin, storing the result in both B and
+ * Bout.  The blocks are held in the "diagonal" layout produced by
+ * crypto_scrypt_smix_sse2(), so that each of the four vectors holds one
+ * diagonal of the 4x4 salsa20 matrix and both the column and the row rounds
+ * operate on whole vectors.
+ */
+static SMIX_INLINE void
+salsa20_8_xor(__m128i B[4], const __m128i Bin[4], __m128i Bout[4])
+{
+	__m128i X0, X1, X2, X3;
+	__m128i T;
+	size_t i;
+
+	X0 = B[0] = _mm_xor_si128(B[0], Bin[0]);
+	X1 = B[1] = _mm_xor_si128(B[1], Bin[1]);
+	X2 = B[2] = _mm_xor_si128(B[2], Bin[2]);
+	X3 = B[3] = _mm_xor_si128(B[3], Bin[3]);
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on "columns". */
+		T = _mm_add_epi32(X0, X3);
+		X1 = _mm_xor_si128(X1, _mm_slli_epi32(T, 7));
+		X1 = _mm_xor_si128(X1, _mm_srli_epi32(T, 25));
+		T = _mm_add_epi32(X1, X0);
+		X2 = _mm_xor_si128(X2, _mm_slli_epi32(T, 9));
+		X2 = _mm_xor_si128(X2, _mm_srli_epi32(T, 23));
+		T = _mm_add_epi32(X2, X1);
+		X3 = _mm_xor_si128(X3, _mm_slli_epi32(T, 13));
+		X3 = _mm_xor_si128(X3, _mm_srli_epi32(T, 19));
+		T = _mm_add_epi32(X3, X2);
+		X0 = _mm_xor_si128(X0, _mm_slli_epi32(T, 18));
+		X0 = _mm_xor_si128(X0, _mm_srli_epi32(T, 14));
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x93);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x39);
+
+		/* Operate on "rows". */
+		T = _mm_add_epi32(X0, X1);
+		X3 = _mm_xor_si128(X3, _mm_slli_epi32(T, 7));
+		X3 = _mm_xor_si128(X3, _mm_srli_epi32(T, 25));
+		T = _mm_add_epi32(X3, X0);
+		X2 = _mm_xor_si128(X2, _mm_slli_epi32(T, 9));
+		X2 = _mm_xor_si128(X2, _mm_srli_epi32(T, 23));
+		T = _mm_add_epi32(X2, X3);
+		X1 = _mm_xor_si128(X1, _mm_slli_epi32(T, 13));
+		X1 = _mm_xor_si128(X1, _mm_srli_epi32(T, 19));
+		T = _mm_add_epi32(X1, X2);
+		X0 = _mm_xor_si128(X0, _mm_slli_epi32(T, 18));
+		X0 = _mm_xor_si128(X0, _mm_srli_epi32(T, 14));
+
+		/* Rearrange data. */
+		X1 = _mm_shuffle_epi32(X1, 0x39);
+		X2 = _mm_shuffle_epi32(X2, 0x4E);
+		X3 = _mm_shuffle_epi32(X3, 0x93);
+	}
+
+	Bout[0] = B[0] = _mm_add_epi32(B[0], X0);
+	Bout[1] = B[1] = _mm_add_epi32(B[1], X1);
+	Bout[2] = B[2] = _mm_add_epi32(B[2], X2);
+	Bout[3] = B[3] = _mm_add_epi32(B[3], X3);
+}
+
+/**
+ * blockmix_salsa8(Bin, Bout, r):
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin).  The input Bin must be 128r
+ * bytes in length; the output Bout must also be the same size.  The running
+ * value X is kept in registers rather than copied in and out of memory
+ * around each salsa20/8 operation.
+ */
+static SMIX_INLINE void
+blockmix_salsa8(const __m128i * Bin, __m128i * Bout, size_t r)
+{
+	__m128i X[4];
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	X[0] = Bin[8 * r - 4];
+	X[1] = Bin[8 * r - 3];
+	X[2] = Bin[8 * r - 2];
+	X[3] = Bin[8 * r - 1];
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < r; i++) {
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 8], &Bout[i * 4]);
+
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 8 + 4], &Bout[(r + i) * 4]);
+	}
+}
+
+/**
+ * blockmix_salsa8_fill(Bin, Bout, Vout, r):
+ * Compute Bout = BlockMix_{salsa20/8, r}(Bin) as blockmix_salsa8() does, and
+ * also write Bout to ${Vout} with non-temporal stores as each 64-byte piece
+ * of it comes out of salsa20/8.  This is how the first loop of SMix fills V:
+ * V is not read again until the second loop, by which time it would long
+ * since have been evicted from the cache, so there is no point in reading
+ * each line of it into the cache in order to write it, nor in pushing X and
+ * Y out of the cache to make room for it.
+ */
+static SMIX_INLINE void
+blockmix_salsa8_fill(const __m128i * Bin, __m128i * Bout, __m128i * Vout,
+    size_t r)
+{
+	__m128i X[4];
+	size_t i;
+
+	/* 1: X <-- B_{2r - 1} */
+	X[0] = Bin[8 * r - 4];
+	X[1] = Bin[8 * r - 3];
+	X[2] = Bin[8 * r - 2];
+	X[3] = Bin[8 * r - 1];
+
+	/* 2: for i = 0 to 2r - 1 do */
+	for (i = 0; i < r; i++) {
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 8], &Bout[i * 4]);
+		blkcpy_stream(&Vout[i * 4], X, 64);
+
+		/* 3: X <-- H(X \xor B_i) */
+		/* 4: Y_i <-- X */
+		/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
+		salsa20_8_xor(X, &Bin[i * 8 + 4], &Bout[(r + i) * 4]);
+		blkcpy_stream(&Vout[(r + i) * 4], X, 64);
+	}
+}
+
+/**
+ * integerify(B, r):
+ * Return the result of parsing B_{2r-1} as a little-endian integer.  Note
+ * that B's layout is permuted compared to the generic implementation: the
+ * low word of B_{2r-1} is in position 0 and the high word in position 13.
+ */
+static SMIX_INLINE uint64_t
+integerify(const void * B, size_t r)
+{
+	const uint32_t * X = (const void *)((uintptr_t)(B) + (2 * r - 1) * 64);
+
+	return (((uint64_t)(X[13]) << 32) + X[0]);
+}
+
+/**
+ * prefetch(p, len):
+ * Hint that the ${len} bytes at ${p} will be read soon.
+ */
+static void
+prefetch(const void * p, size_t len)
+{
+	const char * P = p;
+	size_t i;
+
+	for (i = 0; i < len; i += 64)
+		_mm_prefetch(&P[i], _MM_HINT_T0);
+}
+
+/**
+ * smix1(B, r, N, i0, i1, V, XY):
+ * Compute the first loop of SMix_r(B, N), as described for
+ * crypto_scrypt_smix1_sse2().  This is always inlined, so that callers
+ * passing a constant r get a copy with every length and offset known at
+ * compile time.
+ */
+static SMIX_INLINE void
+smix1(uint8_t * B, size_t r, uint64_t N, uint64_t i0, uint64_t i1,
+    void * V, void * XY)
+{
+	__m128i * X = XY;
+	__m128i * Y = (void *)((uintptr_t)(XY) + 128 * r);
+	uint32_t * X32 = (void *)X;
+	uint64_t i;
+	size_t k;
+
+	(void)N; /* UNUSED */
+
+	/* 1: X <-- B (in the diagonal layout used by salsa20_8) */
+	for (k = 0; (i0 == 0) && (k < 2 * r); k++) {
+		for (i = 0; i < 16; i++) {
+			X32[k * 16 + i] =
+			    le32dec(&B[(k * 16 + (i * 5 % 16)) * 4]);
+		}
+	}
+
+	/*
+	 * 3: V_i <-- X, for the first i of this call; each later V_i is
+	 * written as it comes out of BlockMix.  The last X we compute is left
+	 * for the next call to store.
+	 */
+	if (i0 < i1)
+		blkcpy_stream((void *)((uintptr_t)(V) + i0 * 128 * r), X,
+		    128 * r);
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i += 2) {
+		/* 4: X <-- H(X); 3: V_i <-- X */
+		blockmix_salsa8_fill(X, Y,
+		    (void *)((uintptr_t)(V) + (i + 1) * 128 * r), r);
+
+		/* 4: X <-- H(X); 3: V_i <-- X */
+		if (i + 2 < i1)
+			blockmix_salsa8_fill(Y, X,
+			    (void *)((uintptr_t)(V) + (i + 2) * 128 * r), r);
+		else
+			blockmix_salsa8(Y, X, r);
+	}
+
+	/* Make sure V is in memory before anyone reads it. */
+	_mm_sfence();
+}
+
+/**
+ * smix2(B, r, N, i0, i1, V, XY):
+ * Compute the second loop of SMix_r(B, N), as described for
+ * crypto_scrypt_smix2_sse2().  This is always inlined, as smix1() is.
+ */
+static SMIX_INLINE void
+smix2(uint8_t * B, size_t r, uint64_t N, uint64_t i0, uint64_t i1,
+    void * V, void * XY)
+{
+	__m128i * X = XY;
+	__m128i * Y = (void *)((uintptr_t)(XY) + 128 * r);
+	uint32_t * X32 = (void *)X;
+	uint64_t i, j;
+	size_t k;
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i += 2) {
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(X, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(X, (void *)((uintptr_t)(V) + j * 128 * r), 128 * r);
+		blockmix_salsa8(X, Y, r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(Y, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j) */
+		blkxor(Y, (void *)((uintptr_t)(V) + j * 128 * r), 128 * r);
+		blockmix_salsa8(Y, X, r);
+	}
+
+	/* 10: B' <-- X */
+	for (k = 0; (i1 == N) && (k < 2 * r); k++) {
+		for (i = 0; i < 16; i++) {
+			le32enc(&B[(k * 16 + (i * 5 % 16)) * 4],
+			    X32[k * 16 + i]);
+		}
+	}
+}
+
+/**
+ * smix1_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute the first loop of SMix_r(B[k], N) for k = 0 ... n - 1, as
+ * described for crypto_scrypt_smix1_sse2_multi().  This is always inlined,
+ * as smix1() is.
+ */
+static SMIX_INLINE void
+smix1_multi(uint8_t ** B, size_t n, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void ** V, void ** XY)
+{
+	__m128i * X[SMIX_MULTI_MAX];
+	__m128i * Y[SMIX_MULTI_MAX];
+	__m128i * T;
+	uint32_t * X32;
+	uint64_t i;
+	size_t k, m;
+
+	(void)N; /* UNUSED */
+
+	for (m = 0; m < n; m++) {
+		X[m] = XY[m];
+		Y[m] = (void *)((uintptr_t)(XY[m]) + 128 * r);
+
+		/* 1: X <-- B (in the diagonal layout used by salsa20_8) */
+		X32 = (void *)X[m];
+		for (k = 0; (i0 == 0) && (k < 2 * r); k++) {
+			for (i = 0; i < 16; i++) {
+				X32[k * 16 + i] = le32dec(
+				    &B[m][(k * 16 + (i * 5 % 16)) * 4]);
+			}
+		}
+
+		/* 3: V_i <-- X, for the first i; see smix1(). */
+		if (i0 < i1)
+			blkcpy_stream((void *)((uintptr_t)(V[m]) +
+			    i0 * 128 * r), X[m], 128 * r);
+	}
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i++) {
+		for (m = 0; m < n; m++) {
+			/* 4: X <-- H(X); 3: V_i <-- X */
+			if (i + 1 < i1)
+				blockmix_salsa8_fill(X[m], Y[m],
+				    (void *)((uintptr_t)(V[m]) +
+				    (i + 1) * 128 * r), r);
+			else
+				blockmix_salsa8(X[m], Y[m], r);
+			T = X[m];
+			X[m] = Y[m];
+			Y[m] = T;
+		}
+	}
+
+	/* Make sure V is in memory before anyone reads it. */
+	_mm_sfence();
+
+	/* i1 - i0 is even, so X has ended up back at the start of XY. */
+}
+
+/**
+ * smix2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute the second loop of SMix_r(B[k], N) for k = 0 ... n - 1, as
+ * described for crypto_scrypt_smix2_sse2_multi().  This is always inlined,
+ * as smix1() is.
+ */
+static SMIX_INLINE void
+smix2_multi(uint8_t ** B, size_t n, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void ** V, void ** XY)
+{
+	__m128i * X[SMIX_MULTI_MAX];
+	__m128i * Y[SMIX_MULTI_MAX];
+	__m128i * T;
+	uint32_t * X32;
+	uint64_t j[SMIX_MULTI_MAX];
+	uint64_t i;
+	size_t k, m;
+
+	for (m = 0; m < n; m++) {
+		X[m] = XY[m];
+		Y[m] = (void *)((uintptr_t)(XY[m]) + 128 * r);
+
+		/* 7: j <-- Integerify(X) mod N */
+		j[m] = integerify(X[m], r) & (N - 1);
+		prefetch((void *)((uintptr_t)(V[m]) + j[m] * 128 * r),
+		    128 * r);
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = i0; i < i1; i++) {
+		for (m = 0; m < n; m++) {
+			/* 8: X <-- H(X \xor V_j) */
+			blkxor(X[m],
+			    (void *)((uintptr_t)(V[m]) + j[m] * 128 * r),
+			    128 * r);
+			blockmix_salsa8(X[m], Y[m], r);
+			T = X[m];
+			X[m] = Y[m];
+			Y[m] = T;
+
+			/* 7: j <-- Integerify(X) mod N */
+			j[m] = integerify(X[m], r) & (N - 1);
+			prefetch((void *)((uintptr_t)(V[m]) + j[m] * 128 * r),
+			    128 * r);
+		}
+	}
+
+	/* 10: B' <-- X */
+	for (m = 0; (i1 == N) && (m < n); m++) {
+		X32 = (void *)X[m];
+		for (k = 0; k < 2 * r; k++) {
+			for (i = 0; i < 16; i++) {
+				le32enc(&B[m][(k * 16 + (i * 5 % 16)) * 4],
+				    X32[k * 16 + i]);
+			}
+		}
+	}
+}
+
+/**
+ * tmto_block(V, j, k, Z0, Z1, r):
+ * Return a pointer to V_j, where V holds only V_0, V_k, V_{2k} ..., by
+ * applying BlockMix to the nearest block stored before it as often as
+ * needed, using Z0 and Z1 for the results.  The value k must be a power of 2.
+ */
+static SMIX_INLINE const __m128i *
+tmto_block(const __m128i * V, uint64_t j, uint64_t k, __m128i * Z0,
+    __m128i * Z1, size_t r)
+{
+	const __m128i * T = &V[(j / k) * (8 * r)];
+	__m128i * U;
+	uint64_t n;
+
+	for (n = j & (k - 1); n > 0; n--) {
+		U = (T == Z0) ? Z1 : Z0;
+		blockmix_salsa8(T, U, r);
+		T = U;
+	}
+
+	return (T);
+}
+
+/**
+ * smix_tmto(B, r, N, k, V, XY):
+ * Compute B = SMix_r(B, N), as described for crypto_scrypt_smix_tmto_sse2().
+ * This is always inlined, as smix1() is.
+ */
+static SMIX_INLINE void
+smix_tmto(uint8_t * B, size_t r, uint64_t N, uint64_t k, void * _V, void * XY)
+{
+	__m128i * V = _V;
+	__m128i * X = XY;
+	__m128i * Y = (void *)((uintptr_t)(XY) + 128 * r);
+	__m128i * Z0 = &V[(N / k) * (8 * r)];
+	__m128i * Z1 = &V[(N / k + 1) * (8 * r)];
+	__m128i * T;
+	uint32_t * X32;
+	uint64_t i, j;
+	size_t m;
+
+	/* 1: X <-- B (in the diagonal layout used by salsa20_8) */
+	X32 = (void *)X;
+	for (m = 0; m < 2 * r; m++) {
+		for (i = 0; i < 16; i++) {
+			X32[m * 16 + i] =
+			    le32dec(&B[(m * 16 + (i * 5 % 16)) * 4]);
+		}
+	}
+
+	/* 2: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 3: V_i <-- X, if i is a multiple of k */
+		if ((i & (k - 1)) == 0)
+			blkcpy(&V[(i / k) * (8 * r)], X, 128 * r);
+
+		/* 4: X <-- H(X) */
+		blockmix_salsa8(X, Y, r);
+		T = X;
+		X = Y;
+		Y = T;
+	}
+
+	/* 6: for i = 0 to N - 1 do */
+	for (i = 0; i < N; i++) {
+		/* 7: j <-- Integerify(X) mod N */
+		j = integerify(X, r) & (N - 1);
+
+		/* 8: X <-- H(X \xor V_j), recomputing V_j if needed */
+		blkxor(X, tmto_block(V, j, k, Z0, Z1, r), 128 * r);
+		blockmix_salsa8(X, Y, r);
+		T = X;
+		X = Y;
+		Y = T;
+	}
+
+	/* 10: B' <-- X */
+	X32 = (void *)X;
+	for (m = 0; m < 2 * r; m++) {
+		for (i = 0; i < 16; i++) {
+			le32enc(&B[(m * 16 + (i * 5 % 16)) * 4],
+			    X32[m * 16 + i]);
+		}
+	}
+}
+
+/**
+ * crypto_scrypt_smix1_sse2(B, r, N, i0, i1, V, XY):
+ * Compute part of the first loop of SMix_r(B, N), as crypto_scrypt_smix1()
+ * does.  The X left in XY is in a different layout from the one which
+ * crypto_scrypt_smix1() leaves, so the computation must be continued by
+ * crypto_scrypt_smix1_sse2() and crypto_scrypt_smix2_sse2().
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void
+crypto_scrypt_smix1_sse2(uint8_t * B, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void * V, void * XY)
+{
+
+	smix1(B, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix2_sse2(B, r, N, i0, i1, V, XY):
+ * Compute part of the second loop of SMix_r(B, N), as crypto_scrypt_smix2()
+ * does, continuing from the V and XY left by crypto_scrypt_smix1_sse2() or
+ * by the previous call.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void
+crypto_scrypt_smix2_sse2(uint8_t * B, size_t r, uint64_t N, uint64_t i0,
+    uint64_t i1, void * V, void * XY)
+{
+
+	smix2(B, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix1_sse2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute part of the first loop of SMix_r(B[k], N) for k = 0 ... n - 1, as
+ * crypto_scrypt_smix1_multi() does, leaving X in the layout which
+ * crypto_scrypt_smix2_sse2_multi() expects.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void
+crypto_scrypt_smix1_sse2_multi(uint8_t ** B, size_t n, size_t r, uint64_t N,
+    uint64_t i0, uint64_t i1, void ** V, void ** XY)
+{
+
+	smix1_multi(B, n, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix2_sse2_multi(B, n, r, N, i0, i1, V, XY):
+ * Compute part of the second loop of SMix_r(B[k], N) for k = 0 ... n - 1,
+ * as crypto_scrypt_smix2_multi() does, continuing from the V[k] and XY[k]
+ * left by crypto_scrypt_smix1_sse2_multi() or by the previous call.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void
+crypto_scrypt_smix2_sse2_multi(uint8_t ** B, size_t n, size_t r, uint64_t N,
+    uint64_t i0, uint64_t i1, void ** V, void ** XY)
+{
+
+	smix2_multi(B, n, r, N, i0, i1, V, XY);
+}
+
+/**
+ * crypto_scrypt_smix_tmto_sse2(B, r, N, k, V, XY):
+ * Compute B = SMix_r(B, N), as crypto_scrypt_smix_tmto() does.
+ *
+ * Use SSE2 instructions; the caller must check that the CPU supports them.
+ */
+void
+crypto_scrypt_smix_tmto_sse2(uint8_t * B, size_t r, uint64_t N, uint64_t k,
+    void * V, void * XY)
+{
+
+	smix_tmto(B, r, N, k, V, XY);
+}
+
+/* Copies of SMix specialized for the values of r which are used in practice. */
+SMIX_FIXED_R(1)
+SMIX_FIXED_R(8)
+SMIX_FIXED_R(16)
+
+/* SMix kernels using SSE2. */
+const struct smix_kernel crypto_scrypt_smix_sse2_kernels[] = {
+	SMIX_KERNEL_R(1),
+	SMIX_KERNEL_R(8),
+	SMIX_KERNEL_R(16),
+	{ 0, crypto_scrypt_smix1_sse2, crypto_scrypt_smix2_sse2,
+	    crypto_scrypt_smix1_sse2_multi, crypto_scrypt_smix2_sse2_multi,
+	    crypto_scrypt_smix_tmto_sse2 }
+};
+
+#endif /* CPUSUPPORT_X86_SSE2 */
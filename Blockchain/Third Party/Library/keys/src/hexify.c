@@ -0,0 +1,252 @@
+#include "scrypt_platform.h"
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpusupport.h"
+#include "hexify_arm.h"
+#include "hexify_avx2.h"
+#include "hexify_ssse3.h"
+
+#include "hexify.h"
+
+/* Ways of converting whole blocks; see hexify_impl(). */
+#define HEXIFY_GENERIC	0
+#define HEXIFY_SSSE3	1
+#define HEXIFY_AVX2	2
+#define HEXIFY_ARM	3
+
+static const char digits[] = "0123456789abcdef";
+
+/**
+ * hexify_generic(in, out, len):
+ * Convert ${len} bytes from ${in} into lower-case hexadecimal, writing the
+ * resulting 2 * ${len} characters to ${out}.
+ */
+static void
+hexify_generic(const uint8_t * in, char * out, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		out[2 * i] = digits[in[i] >> 4];
+		out[2 * i + 1] = digits[in[i] & 0x0f];
+	}
+}
+
+/**
+ * unhex1(c):
+ * Return the value of the hexadecimal character ${c}, or -1 if ${c} is not
+ * a hexadecimal character.
+ */
+static int
+unhex1(char c)
+{
+
+	if ((c >= '0') && (c <= '9'))
+		return (c - '0');
+	if ((c >= 'a') && (c <= 'f'))
+		return (c - 'a' + 10);
+	if ((c >= 'A') && (c <= 'F'))
+		return (c - 'A' + 10);
+	return (-1);
+}
+
+/**
+ * unhexify_generic(in, out, len):
+ * Convert 2 * ${len} hexadecimal characters from ${in} to ${len} bytes and
+ * write them to ${out}.
+ *
+ * Return 0 on success; or -1 if any of the characters are not hexadecimal.
+ */
+static int
+unhexify_generic(const char * in, uint8_t * out, size_t len)
+{
+	size_t i;
+	int hi, lo;
+
+	for (i = 0; i < len; i++) {
+		if (((hi = unhex1(in[2 * i])) == -1) ||
+		    ((lo = unhex1(in[2 * i + 1])) == -1))
+			return (-1);
+		out[i] = (uint8_t)((hi << 4) + lo);
+	}
+
+	/* Success! */
+	return (0);
+}
+
+#if defined(CPUSUPPORT_X86_SSSE3) || defined(CPUSUPPORT_X86_AVX2) || \
+    defined(CPUSUPPORT_ARM_NEON)
+/**
+ * impl_ok(enc, dec, blocklen):
+ * Return non-zero if ${enc} and ${dec}, which convert ${blocklen}-byte
+ * blocks, agree with the portable code on two test blocks and ${dec}
+ * rejects a character which is not hexadecimal.  Code using SIMD
+ * instructions is only trusted once it has passed this.
+ */
+static int
+impl_ok(void (* enc)(const uint8_t *, char *, size_t),
+    int (* dec)(const char *, uint8_t *, size_t), size_t blocklen)
+{
+	uint8_t in[64], out[64];
+	char hex[2][128];
+	size_t i;
+
+	/* Something which isn't too regular. */
+	for (i = 0; i < 2 * blocklen; i++)
+		in[i] = (uint8_t)(i * 37 + 11);
+
+	/* Encode both ways and compare. */
+	hexify_generic(in, hex[0], 2 * blocklen);
+	enc(in, hex[1], 2);
+	if (memcmp(hex[0], hex[1], 4 * blocklen))
+		return (0);
+
+	/* Decode, with some of the letters in upper case. */
+	for (i = 0; i < 4 * blocklen; i += 3) {
+		if ((hex[1][i] >= 'a') && (hex[1][i] <= 'f'))
+			hex[1][i] = (char)(hex[1][i] - 'a' + 'A');
+	}
+	if (dec(hex[1], out, 2) || memcmp(in, out, 2 * blocklen))
+		return (0);
+
+	/* A character just past 'f' must be caught. */
+	hex[1][4 * blocklen - 1] = 'g';
+	return (dec(hex[1], out, 2) == -1);
+}
+#endif
+
+/* The way of converting whole blocks picked by selecthexify(). */
+static int hexify_blocks = HEXIFY_GENERIC;
+static pthread_once_t hexify_once = PTHREAD_ONCE_INIT;
+
+/**
+ * selecthexify(void):
+ * Pick the fastest way to convert whole blocks which works on this CPU.
+ */
+static void
+selecthexify(void)
+{
+
+	/* Use the widest SIMD code which the CPU has and which works. */
+#ifdef CPUSUPPORT_X86_SSSE3
+	if (cpusupport_x86_ssse3() &&
+	    impl_ok(hexify_ssse3, unhexify_ssse3, 16))
+		hexify_blocks = HEXIFY_SSSE3;
+#endif
+#ifdef CPUSUPPORT_X86_AVX2
+	if (cpusupport_x86_avx2() && impl_ok(hexify_avx2, unhexify_avx2, 32))
+		hexify_blocks = HEXIFY_AVX2;
+#endif
+#ifdef CPUSUPPORT_ARM_NEON
+	if (cpusupport_arm_neon() && impl_ok(hexify_arm, unhexify_arm, 16))
+		hexify_blocks = HEXIFY_ARM;
+#endif
+}
+
+/**
+ * hexify_impl(void):
+ * Return the HEXIFY_* value for the fastest way to convert whole blocks on
+ * this CPU.
+ */
+static int
+hexify_impl(void)
+{
+
+	/* Pick the implementation the first time through. */
+	if (pthread_once(&hexify_once, selecthexify))
+		return (HEXIFY_GENERIC);
+
+	return (hexify_blocks);
+}
+
+/**
+ * hexify(in, out, len):
+ * Convert ${len} bytes from ${in} into lower-case hexadecimal, writing the
+ * resulting 2 * ${len} characters to ${out}; and append a NUL byte.
+ */
+void
+hexify(const uint8_t * in, char * out, size_t len)
+{
+	size_t done = 0;
+
+	/* Convert as many whole blocks as we can with SIMD code... */
+	switch (hexify_impl()) {
+#ifdef CPUSUPPORT_X86_SSSE3
+	case HEXIFY_SSSE3:
+		done = len - len % 16;
+		hexify_ssse3(in, out, len / 16);
+		break;
+#endif
+#ifdef CPUSUPPORT_X86_AVX2
+	case HEXIFY_AVX2:
+		done = len - len % 32;
+		hexify_avx2(in, out, len / 32);
+		break;
+#endif
+#ifdef CPUSUPPORT_ARM_NEON
+	case HEXIFY_ARM:
+		done = len - len % 16;
+		hexify_arm(in, out, len / 16);
+		break;
+#endif
+	}
+
+	/* ... and the rest one byte at a time. */
+	hexify_generic(&in[done], &out[2 * done], len - done);
+	out[2 * len] = '\0';
+}
+
+/**
+ * unhexify(in, out, len):
+ * Convert 2 * ${len} hexadecimal characters (of either case) from ${in} to
+ * ${len} bytes and write them to ${out}.  This function will only fail if
+ * the input is not a sequence of hexadecimal characters, in which case the
+ * contents of ${out} are unspecified.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+unhexify(const char * in, uint8_t * out, size_t len)
+{
+	size_t done = 0;
+
+	/* Convert as many whole blocks as we can with SIMD code... */
+	switch (hexify_impl()) {
+#ifdef CPUSUPPORT_X86_SSSE3
+	case HEXIFY_SSSE3:
+		done = len - len % 16;
+		if (unhexify_ssse3(in, out, len / 16))
+			goto err0;
+		break;
+#endif
+#ifdef CPUSUPPORT_X86_AVX2
+	case HEXIFY_AVX2:
+		done = len - len % 32;
+		if (unhexify_avx2(in, out, len / 32))
+			goto err0;
+		break;
+#endif
+#ifdef CPUSUPPORT_ARM_NEON
+	case HEXIFY_ARM:
+		done = len - len % 16;
+		if (unhexify_arm(in, out, len / 16))
+			goto err0;
+		break;
+#endif
+	}
+
+	/* ... and the rest one byte at a time. */
+	if (unhexify_generic(&in[2 * done], &out[done], len - done))
+		goto err0;
+
+	/* Success! */
+	return (0);
+
+err0:
+	/* Failure! */
+	return (-1);
+}
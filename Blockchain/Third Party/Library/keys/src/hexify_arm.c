@@ -0,0 +1,95 @@
+#include "scrypt_platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_ARM_NEON
+#include <arm_neon.h>
+
+#include "hexify_arm.h"
+
+/*
+ * The interleaving loads and stores (LD2 and ST2) do the work of splitting
+ * characters into high and low nibbles and of putting them back together.
+ */
+
+/**
+ * hexify_arm(in, out, nblocks):
+ * Convert ${nblocks} 16-byte blocks from ${in} into lower-case hexadecimal,
+ * writing 32 * ${nblocks} characters to ${out}, using NEON.
+ */
+void
+hexify_arm(const uint8_t * in, char * out, size_t nblocks)
+{
+	static const uint8_t digits[16] = {
+		'0', '1', '2', '3', '4', '5', '6', '7',
+		'8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+	};
+	const uint8x16_t lut = vld1q_u8(digits);
+	uint8x16_t x;
+	uint8x16x2_t y;
+	size_t i;
+
+	for (i = 0; i < nblocks; i++) {
+		x = vld1q_u8(&in[i * 16]);
+
+		/* Look up the digit for each nibble, high nibble first. */
+		y.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(x, 4));
+		y.val[1] = vqtbl1q_u8(lut, vandq_u8(x, vdupq_n_u8(0x0f)));
+		vst2q_u8((uint8_t *)&out[i * 32], y);
+	}
+}
+
+/**
+ * unhex16(in, ok):
+ * Return the values of the 16 hexadecimal characters ${in}, one per byte;
+ * and clear bytes of ${ok} where the characters are not hexadecimal.
+ */
+static inline uint8x16_t
+unhex16(uint8x16_t in, uint8x16_t * ok)
+{
+	uint8x16_t d, l, isd, isl;
+
+	/* Digits are 0 .. 9 above '0'... */
+	d = vsubq_u8(in, vdupq_n_u8('0'));
+	isd = vcleq_u8(d, vdupq_n_u8(9));
+
+	/* ... and letters, once folded to lower case, 0 .. 5 above 'a'. */
+	l = vsubq_u8(vorrq_u8(in, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+	isl = vcleq_u8(l, vdupq_n_u8(5));
+
+	*ok = vandq_u8(*ok, vorrq_u8(isd, isl));
+	return (vorrq_u8(vandq_u8(isd, d),
+	    vandq_u8(isl, vaddq_u8(l, vdupq_n_u8(10)))));
+}
+
+/**
+ * unhexify_arm(in, out, nblocks):
+ * Convert 32 * ${nblocks} hexadecimal characters from ${in} to ${nblocks}
+ * 16-byte blocks and write them to ${out}, using NEON.
+ *
+ * Return 0 on success; or -1 if any of the characters are not hexadecimal.
+ */
+int
+unhexify_arm(const char * in, uint8_t * out, size_t nblocks)
+{
+	uint8x16_t ok = vdupq_n_u8(0xff);
+	uint8x16x2_t x;
+	size_t i;
+
+	for (i = 0; i < nblocks; i++) {
+		/* Split the characters into high and low nibbles. */
+		x = vld2q_u8((const uint8_t *)&in[i * 32]);
+		x.val[0] = unhex16(x.val[0], &ok);
+		x.val[1] = unhex16(x.val[1], &ok);
+		vst1q_u8(&out[i * 16],
+		    vorrq_u8(vshlq_n_u8(x.val[0], 4), x.val[1]));
+	}
+
+	/* Were all the characters hexadecimal? */
+	return ((vminvq_u8(ok) == 0xff) ? 0 : -1);
+}
+
+#endif /* CPUSUPPORT_ARM_NEON */
@@ -0,0 +1,119 @@
+#include "scrypt_platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_AVX2
+#include <immintrin.h>
+
+#include "hexify_avx2.h"
+
+/*
+ * This file is compiled for whatever the rest of the build targets, so the
+ * functions which use AVX2 are marked with a target attribute and must only
+ * be called once cpusupport_x86_avx2() says the CPU can run them.  Most AVX2
+ * byte operations work within each 128-bit half of a register, so results
+ * which cross the halves are put back in order with a permute.
+ */
+
+/**
+ * hexify_avx2(in, out, nblocks):
+ * Convert ${nblocks} 32-byte blocks from ${in} into lower-case hexadecimal,
+ * writing 64 * ${nblocks} characters to ${out}, using AVX2.
+ */
+__attribute__((target("avx2")))
+void
+hexify_avx2(const uint8_t * in, char * out, size_t nblocks)
+{
+	const __m256i digits = _mm256_setr_epi8('0', '1', '2', '3', '4', '5',
+	    '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+	    '0', '1', '2', '3', '4', '5',
+	    '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	__m256i x, hi, lo, y0, y1;
+	size_t i;
+
+	for (i = 0; i < nblocks; i++) {
+		x = _mm256_loadu_si256((const __m256i *)&in[i * 32]);
+
+		/* Look up the digit for each nibble... */
+		hi = _mm256_shuffle_epi8(digits,
+		    _mm256_and_si256(_mm256_srli_epi16(x, 4), mask));
+		lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(x, mask));
+
+		/* ... interleave them, high nibble first... */
+		y0 = _mm256_unpacklo_epi8(hi, lo);
+		y1 = _mm256_unpackhi_epi8(hi, lo);
+
+		/* ... and put the halves back in order. */
+		_mm256_storeu_si256((__m256i *)&out[i * 64],
+		    _mm256_permute2x128_si256(y0, y1, 0x20));
+		_mm256_storeu_si256((__m256i *)&out[i * 64 + 32],
+		    _mm256_permute2x128_si256(y0, y1, 0x31));
+	}
+}
+
+/**
+ * unhex32(in, ok):
+ * Return the values of the 32 hexadecimal characters ${in}, one per byte;
+ * and clear bytes of ${ok} where the characters are not hexadecimal.
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+unhex32(__m256i in, __m256i * ok)
+{
+	__m256i d, l, isd, isl;
+
+	/* Digits are 0 .. 9 above '0'... */
+	d = _mm256_sub_epi8(in, _mm256_set1_epi8('0'));
+	isd = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+
+	/* ... and letters, once folded to lower case, 0 .. 5 above 'a'. */
+	l = _mm256_sub_epi8(_mm256_or_si256(in, _mm256_set1_epi8(0x20)),
+	    _mm256_set1_epi8('a'));
+	isl = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+
+	*ok = _mm256_and_si256(*ok, _mm256_or_si256(isd, isl));
+	return (_mm256_or_si256(_mm256_and_si256(isd, d),
+	    _mm256_and_si256(isl, _mm256_add_epi8(l, _mm256_set1_epi8(10)))));
+}
+
+/**
+ * unhexify_avx2(in, out, nblocks):
+ * Convert 64 * ${nblocks} hexadecimal characters from ${in} to ${nblocks}
+ * 32-byte blocks and write them to ${out}, using AVX2.
+ *
+ * Return 0 on success; or -1 if any of the characters are not hexadecimal.
+ */
+__attribute__((target("avx2")))
+int
+unhexify_avx2(const char * in, uint8_t * out, size_t nblocks)
+{
+	const __m256i weights = _mm256_set1_epi16(0x0110);
+	__m256i ok = _mm256_set1_epi8(-1);
+	__m256i x0, x1;
+	size_t i;
+
+	for (i = 0; i < nblocks; i++) {
+		x0 = unhex32(_mm256_loadu_si256(
+		    (const __m256i *)&in[i * 64]), &ok);
+		x1 = unhex32(_mm256_loadu_si256(
+		    (const __m256i *)&in[i * 64 + 32]), &ok);
+
+		/* Each pair of nibbles becomes 16 * high + low... */
+		x0 = _mm256_maddubs_epi16(x0, weights);
+		x1 = _mm256_maddubs_epi16(x1, weights);
+
+		/* ... which fits in a byte; then put the halves in order. */
+		_mm256_storeu_si256((__m256i *)&out[i * 32],
+		    _mm256_permute4x64_epi64(_mm256_packus_epi16(x0, x1),
+		    0xd8));
+	}
+
+	/* Were all the characters hexadecimal? */
+	return ((_mm256_movemask_epi8(ok) == -1) ? 0 : -1);
+}
+
+#endif /* CPUSUPPORT_X86_AVX2 */
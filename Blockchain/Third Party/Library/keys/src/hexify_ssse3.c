@@ -0,0 +1,110 @@
+#include "scrypt_platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_SSSE3
+#include <tmmintrin.h>
+
+#include "hexify_ssse3.h"
+
+/*
+ * This file is compiled for whatever the rest of the build targets, so the
+ * functions which use SSSE3 are marked with a target attribute and must only
+ * be called once cpusupport_x86_ssse3() says the CPU can run them.
+ */
+
+/**
+ * hexify_ssse3(in, out, nblocks):
+ * Convert ${nblocks} 16-byte blocks from ${in} into lower-case hexadecimal,
+ * writing 32 * ${nblocks} characters to ${out}, using SSSE3.
+ */
+__attribute__((target("ssse3")))
+void
+hexify_ssse3(const uint8_t * in, char * out, size_t nblocks)
+{
+	const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5',
+	    '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	__m128i x, hi, lo;
+	size_t i;
+
+	for (i = 0; i < nblocks; i++) {
+		x = _mm_loadu_si128((const __m128i *)&in[i * 16]);
+
+		/* Look up the digit for each nibble... */
+		hi = _mm_shuffle_epi8(digits,
+		    _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+		lo = _mm_shuffle_epi8(digits, _mm_and_si128(x, mask));
+
+		/* ... and interleave them, high nibble first. */
+		_mm_storeu_si128((__m128i *)&out[i * 32],
+		    _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)&out[i * 32 + 16],
+		    _mm_unpackhi_epi8(hi, lo));
+	}
+}
+
+/**
+ * unhex16(in, ok):
+ * Return the values of the 16 hexadecimal characters ${in}, one per byte;
+ * and clear bytes of ${ok} where the characters are not hexadecimal.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i
+unhex16(__m128i in, __m128i * ok)
+{
+	__m128i d, l, isd, isl;
+
+	/* Digits are 0 .. 9 above '0'... */
+	d = _mm_sub_epi8(in, _mm_set1_epi8('0'));
+	isd = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+
+	/* ... and letters, once folded to lower case, 0 .. 5 above 'a'. */
+	l = _mm_sub_epi8(_mm_or_si128(in, _mm_set1_epi8(0x20)),
+	    _mm_set1_epi8('a'));
+	isl = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+
+	*ok = _mm_and_si128(*ok, _mm_or_si128(isd, isl));
+	return (_mm_or_si128(_mm_and_si128(isd, d), _mm_and_si128(isl,
+	    _mm_add_epi8(l, _mm_set1_epi8(10)))));
+}
+
+/**
+ * unhexify_ssse3(in, out, nblocks):
+ * Convert 32 * ${nblocks} hexadecimal characters from ${in} to ${nblocks}
+ * 16-byte blocks and write them to ${out}, using SSSE3.
+ *
+ * Return 0 on success; or -1 if any of the characters are not hexadecimal.
+ */
+__attribute__((target("ssse3")))
+int
+unhexify_ssse3(const char * in, uint8_t * out, size_t nblocks)
+{
+	const __m128i weights = _mm_set1_epi16(0x0110);
+	__m128i ok = _mm_set1_epi8(-1);
+	__m128i x0, x1;
+	size_t i;
+
+	for (i = 0; i < nblocks; i++) {
+		x0 = unhex16(_mm_loadu_si128((const __m128i *)&in[i * 32]),
+		    &ok);
+		x1 = unhex16(_mm_loadu_si128((const __m128i *)&in[i * 32 + 16]),
+		    &ok);
+
+		/* Each pair of nibbles becomes 16 * high + low... */
+		x0 = _mm_maddubs_epi16(x0, weights);
+		x1 = _mm_maddubs_epi16(x1, weights);
+
+		/* ... which fits in a byte. */
+		_mm_storeu_si128((__m128i *)&out[i * 16],
+		    _mm_packus_epi16(x0, x1));
+	}
+
+	/* Were all the characters hexadecimal? */
+	return ((_mm_movemask_epi8(ok) == 0xffff) ? 0 : -1);
+}
+
+#endif /* CPUSUPPORT_X86_SSSE3 */
@@ -0,0 +1,24 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "insecure_memzero.h"
+
+/*
+ * Calling memset through a volatile pointer prevents the compiler from
+ * proving that the call has no observable effect and removing it.
+ */
+static void * (* const volatile memset_ptr)(void *, int, size_t) = memset;
+
+/**
+ * insecure_memzero(buf, len):
+ * Zero ${len} bytes at ${buf} in a way which the compiler will not optimize
+ * away even if ${buf} is never read again.  This is "insecure" in that it
+ * makes no attempt to clear copies of the data held in registers, on the
+ * stack, or in swap.
+ */
+void
+insecure_memzero(void * buf, size_t len)
+{
+
+	(memset_ptr)(buf, 0, len);
+}
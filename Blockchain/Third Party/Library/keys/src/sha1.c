@@ -0,0 +1,495 @@
+#include "scrypt_platform.h"
+
+#include <sys/types.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpusupport.h"
+#include "sha1_arm.h"
+#include "sha1_shani.h"
+#include "sysendian.h"
+
+#include "sha1.h"
+
+/*
+ * This follows sha256.c: a portable compression function, which is replaced
+ * by the CPU's own SHA1 instructions where it has them.  PBKDF2-SHA1 output
+ * is usually only a block or two long, so there is no multi-buffer code.
+ */
+
+/* Ways of compressing a single block; see transform_impl(). */
+#define TRANSFORM_GENERIC	0
+#define TRANSFORM_SHANI		1
+#define TRANSFORM_ARM		2
+
+/*
+ * Encode a length len/4 vector of (uint32_t) into a length len vector of
+ * (unsigned char) in big-endian form.  Assumes len is a multiple of 4.
+ */
+static void
+be32enc_vect(unsigned char * dst, const uint32_t * src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len / 4; i++)
+		be32enc(dst + i * 4, src[i]);
+}
+
+/* Elementary functions used by SHA1 */
+#define Ch(x, y, z)	((x & (y ^ z)) ^ z)
+#define Parity(x, y, z)	(x ^ y ^ z)
+#define Maj(x, y, z)	((x & (y | z)) | (y & z))
+#define ROTL(x, n)	((x << n) | (x >> (32 - n)))
+
+/* SHA1 round function */
+#define RND(f, k, i) do {					\
+	t = ROTL(a, 5) + f(b, c, d) + e + k + W[i];		\
+	e = d;							\
+	d = c;							\
+	c = ROTL(b, 30);					\
+	b = a;							\
+	a = t;							\
+} while (0)
+
+/**
+ * SHA1_Transform_generic(state, block, W):
+ * Compress the 64-byte ${block} into the SHA1 ${state}, using ${W} as
+ * scratch space.  This is the portable C code which is used when the CPU
+ * has no SHA1 instructions.
+ */
+static void
+SHA1_Transform_generic(uint32_t state[5], const uint8_t block[64],
+    uint32_t W[80])
+{
+	uint32_t a, b, c, d, e, t;
+	int i;
+
+	/* 1. Prepare the message schedule W. */
+	be32dec_vec(W, block, 16);
+	for (i = 16; i < 80; i++)
+		W[i] = ROTL((W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16]), 1);
+
+	/* 2. Initialize working variables. */
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+
+	/* 3. Mix. */
+	for (i = 0; i < 20; i++)
+		RND(Ch, 0x5a827999, i);
+	for (; i < 40; i++)
+		RND(Parity, 0x6ed9eba1, i);
+	for (; i < 60; i++)
+		RND(Maj, 0x8f1bbcdc, i);
+	for (; i < 80; i++)
+		RND(Parity, 0xca62c1d6, i);
+
+	/* 4. Mix local working variables into global state. */
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+/* Magic initialization constants. */
+static const uint32_t initial_state[5] = {
+	0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+#if defined(CPUSUPPORT_X86_SHANI) || defined(CPUSUPPORT_ARM_SHA1)
+/**
+ * transform_ok(func):
+ * Return non-zero if ${func} compresses a test block into the initial SHA1
+ * state the same way SHA1_Transform_generic() does.  Code using hardware
+ * instructions is only trusted once it has passed this.
+ */
+static int
+transform_ok(void (* func)(uint32_t[5], const uint8_t[64]))
+{
+	uint32_t W[80];
+	uint32_t state[2][5];
+	uint8_t block[64];
+	int i;
+
+	/* Something which isn't too regular. */
+	for (i = 0; i < 64; i++)
+		block[i] = (uint8_t)(i * 37 + 11);
+
+	/* Compress it both ways and compare. */
+	memcpy(state[0], initial_state, 20);
+	memcpy(state[1], initial_state, 20);
+	SHA1_Transform_generic(state[0], block, W);
+	func(state[1], block);
+	return (memcmp(state[0], state[1], 20) == 0);
+}
+#endif
+
+/* The way of compressing one block picked by selecttransform(). */
+static int transform = TRANSFORM_GENERIC;
+static pthread_once_t transform_once = PTHREAD_ONCE_INIT;
+
+/**
+ * selecttransform(void):
+ * Pick the fastest way to compress one block which works on this CPU.
+ */
+static void
+selecttransform(void)
+{
+
+	/* Use SHA1 instructions if the CPU has them and they work. */
+#ifdef CPUSUPPORT_X86_SHANI
+	if (cpusupport_x86_shani() && transform_ok(SHA1_Transform_shani))
+		transform = TRANSFORM_SHANI;
+#endif
+#ifdef CPUSUPPORT_ARM_SHA1
+	if (cpusupport_arm_sha1() && transform_ok(SHA1_Transform_arm))
+		transform = TRANSFORM_ARM;
+#endif
+}
+
+/**
+ * transform_impl(void):
+ * Return the TRANSFORM_* value for the fastest way to compress one block on
+ * this CPU.
+ */
+static int
+transform_impl(void)
+{
+
+	/* Pick the implementation the first time through. */
+	if (pthread_once(&transform_once, selecttransform))
+		return (TRANSFORM_GENERIC);
+
+	return (transform);
+}
+
+/**
+ * SHA1_Transform(state, block, W):
+ * Compress the 64-byte ${block} into the SHA1 ${state}, in whichever way is
+ * fastest on this CPU.  ${W} is scratch space for the portable code, which
+ * the caller should clean once it is done.
+ */
+static void
+SHA1_Transform(uint32_t state[5], const uint8_t block[64], uint32_t W[80])
+{
+
+	switch (transform_impl()) {
+#ifdef CPUSUPPORT_X86_SHANI
+	case TRANSFORM_SHANI:
+		SHA1_Transform_shani(state, block);
+		break;
+#endif
+#ifdef CPUSUPPORT_ARM_SHA1
+	case TRANSFORM_ARM:
+		SHA1_Transform_arm(state, block);
+		break;
+#endif
+	default:
+		SHA1_Transform_generic(state, block, W);
+		break;
+	}
+}
+
+static const uint8_t PAD[64] = { 0x80 };
+
+/* Add padding and terminating bit-count. */
+static void
+SHA1_Pad(SHA1_CTX * ctx, uint32_t W[80])
+{
+	size_t r;
+
+	/* Figure out how many bytes we have buffered. */
+	r = (ctx->count >> 3) & 0x3f;
+
+	/* Pad to 56 mod 64, transforming if we finish a block en route. */
+	if (r < 56) {
+		/* Pad to 56 mod 64. */
+		memcpy(&ctx->buf[r], PAD, 56 - r);
+	} else {
+		/* Finish the current block and mix. */
+		memcpy(&ctx->buf[r], PAD, 64 - r);
+		SHA1_Transform(ctx->state, ctx->buf, W);
+
+		/* The start of the final block is all zeroes. */
+		memset(&ctx->buf[0], 0, 56);
+	}
+
+	/* Add the terminating bit-count. */
+	be64enc(&ctx->buf[56], ctx->count);
+
+	/* Mix in the final block. */
+	SHA1_Transform(ctx->state, ctx->buf, W);
+}
+
+/**
+ * SHA1_Init(ctx):
+ * Initialize the SHA1 context ${ctx}.
+ */
+void
+SHA1_Init(SHA1_CTX * ctx)
+{
+
+	/* Zero bits processed so far. */
+	ctx->count = 0;
+
+	/* Initialize state. */
+	memcpy(ctx->state, initial_state, sizeof(initial_state));
+}
+
+/**
+ * SHA1_Update(ctx, in, len):
+ * Input ${len} bytes from ${in} into the SHA1 context ${ctx}.
+ */
+void
+SHA1_Update(SHA1_CTX * ctx, const void * in, size_t len)
+{
+	uint32_t W[80];
+	uint32_t r;
+	const uint8_t * src = in;
+
+	/* Return immediately if we have nothing to do. */
+	if (len == 0)
+		return;
+
+	/* Number of bytes left in the buffer from previous updates. */
+	r = (ctx->count >> 3) & 0x3f;
+
+	/* Update number of bits. */
+	ctx->count += (uint64_t)(len) << 3;
+
+	/* Handle the case where we don't need to perform any transforms. */
+	if (len < 64 - r) {
+		memcpy(&ctx->buf[r], src, len);
+		return;
+	}
+
+	/* Finish the current block. */
+	memcpy(&ctx->buf[r], src, 64 - r);
+	SHA1_Transform(ctx->state, ctx->buf, W);
+	src += 64 - r;
+	len -= 64 - r;
+
+	/* Perform complete blocks. */
+	while (len >= 64) {
+		SHA1_Transform(ctx->state, src, W);
+		src += 64;
+		len -= 64;
+	}
+
+	/* Copy left over data into buffer. */
+	memcpy(ctx->buf, src, len);
+
+	/* Clean the stack. */
+	memset(W, 0, sizeof(W));
+}
+
+/**
+ * SHA1_Final(digest, ctx):
+ * Output the SHA1 hash of the data input to the context ${ctx} into the
+ * buffer ${digest}, and clear the context state.
+ */
+void
+SHA1_Final(unsigned char digest[20], SHA1_CTX * ctx)
+{
+	uint32_t W[80];
+
+	/* Add padding. */
+	SHA1_Pad(ctx, W);
+
+	/* Write the hash. */
+	be32enc_vect(digest, ctx->state, 20);
+
+	/* Clear the context state, and the stack. */
+	memset(ctx, 0, sizeof(SHA1_CTX));
+	memset(W, 0, sizeof(W));
+}
+
+/* Initialize an HMAC-SHA1 operation with the given key. */
+void
+HMAC_SHA1_Init(HMAC_SHA1_CTX * ctx, const void * _K, size_t Klen)
+{
+	unsigned char pad[64];
+	unsigned char khash[20];
+	const unsigned char * K = _K;
+	size_t i;
+
+	/* If Klen > 64, the key is really SHA1(K). */
+	if (Klen > 64) {
+		SHA1_Init(&ctx->ictx);
+		SHA1_Update(&ctx->ictx, K, Klen);
+		SHA1_Final(khash, &ctx->ictx);
+		K = khash;
+		Klen = 20;
+	}
+
+	/* Inner SHA1 operation is SHA1(K xor [block of 0x36] || data). */
+	SHA1_Init(&ctx->ictx);
+	memset(pad, 0x36, 64);
+	for (i = 0; i < Klen; i++)
+		pad[i] ^= K[i];
+	SHA1_Update(&ctx->ictx, pad, 64);
+
+	/* Outer SHA1 operation is SHA1(K xor [block of 0x5c] || hash). */
+	SHA1_Init(&ctx->octx);
+	memset(pad, 0x5c, 64);
+	for (i = 0; i < Klen; i++)
+		pad[i] ^= K[i];
+	SHA1_Update(&ctx->octx, pad, 64);
+
+	/* Clean the stack. */
+	memset(khash, 0, 20);
+	memset(pad, 0, 64);
+}
+
+/* Add bytes to the HMAC-SHA1 operation. */
+void
+HMAC_SHA1_Update(HMAC_SHA1_CTX * ctx, const void * in, size_t len)
+{
+
+	/* Feed data to the inner SHA1 operation. */
+	SHA1_Update(&ctx->ictx, in, len);
+}
+
+/* Finish an HMAC-SHA1 operation. */
+void
+HMAC_SHA1_Final(unsigned char digest[20], HMAC_SHA1_CTX * ctx)
+{
+	unsigned char ihash[20];
+
+	/* Finish the inner SHA1 operation. */
+	SHA1_Final(ihash, &ctx->ictx);
+
+	/* Feed the inner hash to the outer SHA1 operation. */
+	SHA1_Update(&ctx->octx, ihash, 20);
+
+	/* Finish the outer SHA1 operation. */
+	SHA1_Final(digest, &ctx->octx);
+
+	/* Clean the stack. */
+	memset(ihash, 0, 20);
+}
+
+/**
+ * PBKDF2_SHA1(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA1 as the PRF, and
+ * write the output to buf.  The value dkLen must be at most 20 * (2^32 - 1).
+ */
+void
+PBKDF2_SHA1(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
+{
+	HMAC_SHA1_CTX Pctx;
+
+	/* Key HMAC with the password, then do the work. */
+	HMAC_SHA1_Init(&Pctx, passwd, passwdlen);
+	PBKDF2_SHA1_Keyed(&Pctx, salt, saltlen, c, buf, dkLen);
+
+	/* Clean Pctx, since we never called _Final on it. */
+	memset(&Pctx, 0, sizeof(HMAC_SHA1_CTX));
+}
+
+/**
+ * PBKDF2_SHA1_Keyed(Pctx, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA1() does, where
+ * ${Pctx} is the result of HMAC_SHA1_Init(Pctx, passwd, passwdlen) with no
+ * data added yet.  ${Pctx} is not modified.
+ */
+void
+PBKDF2_SHA1_Keyed(const HMAC_SHA1_CTX * Pctx, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
+{
+	uint32_t istate[5], ostate[5], sstate[5];
+	uint32_t state[5], T[5];
+	uint8_t ublk[128];
+	uint8_t hblk[64];
+	uint8_t U[20];
+	uint32_t W[80];
+	size_t tail, ulen;
+	size_t i, clen;
+	uint64_t j;
+	int k;
+
+	/* Keyed states, after the ipad and opad blocks. */
+	memcpy(istate, Pctx->ictx.state, 20);
+	memcpy(ostate, Pctx->octx.state, 20);
+
+	/* Every U_1 starts with the salt; hash its whole blocks once. */
+	memcpy(sstate, istate, 20);
+	for (tail = saltlen; tail >= 64; tail -= 64)
+		SHA1_Transform(sstate, &salt[saltlen - tail], W);
+
+	/*
+	 * What is left of S || INT(i), with its padding, takes one block, or
+	 * two if the padding doesn't fit; only INT(i) differs between blocks.
+	 */
+	ulen = (tail + 4 + 9 > 64) ? 128 : 64;
+	memset(ublk, 0, ulen);
+	if (tail > 0)
+		memcpy(ublk, &salt[saltlen - tail], tail);
+	ublk[tail + 4] = 0x80;
+	be64enc(&ublk[ulen - 8], ((uint64_t)saltlen + 68) * 8);
+
+	/*
+	 * U_j = PRF(P, U_{j-1}) for j >= 2 is always the SHA1 compression of
+	 * one block after the ipad block, then of one block after the opad
+	 * block, and each of those blocks is a 20-byte hash followed by the
+	 * same padding for an 84-byte message; so is the block in the outer
+	 * hash of U_1.
+	 */
+	memset(hblk, 0, 64);
+	hblk[20] = 0x80;
+	be64enc(&hblk[56], 84 * 8);
+
+	/* Iterate through the blocks. */
+	for (i = 0; i * 20 < dkLen; i++) {
+		/* Compute U_1 = PRF(P, S || INT(i)). */
+		be32enc(&ublk[tail], (uint32_t)(i + 1));
+		memcpy(state, sstate, 20);
+		SHA1_Transform(state, ublk, W);
+		if (ulen == 128)
+			SHA1_Transform(state, &ublk[64], W);
+		be32enc_vect(hblk, state, 20);
+		memcpy(state, ostate, 20);
+		SHA1_Transform(state, hblk, W);
+
+		/* T_i = U_1 ... */
+		memcpy(T, state, 20);
+
+		for (j = 2; j <= c; j++) {
+			/* Compute U_j. */
+			be32enc_vect(hblk, state, 20);
+			memcpy(state, istate, 20);
+			SHA1_Transform(state, hblk, W);
+			be32enc_vect(hblk, state, 20);
+			memcpy(state, ostate, 20);
+			SHA1_Transform(state, hblk, W);
+
+			/* ... xor U_j ... */
+			for (k = 0; k < 5; k++)
+				T[k] ^= state[k];
+		}
+
+		/* Copy as many bytes as necessary into buf. */
+		be32enc_vect(U, T, 20);
+		clen = dkLen - i * 20;
+		if (clen > 20)
+			clen = 20;
+		memcpy(&buf[i * 20], U, clen);
+	}
+
+	/* Clean the stack. */
+	memset(istate, 0, 20);
+	memset(ostate, 0, 20);
+	memset(sstate, 0, 20);
+	memset(state, 0, 20);
+	memset(T, 0, 20);
+	memset(ublk, 0, sizeof(ublk));
+	memset(hblk, 0, sizeof(hblk));
+	memset(U, 0, 20);
+	memset(W, 0, sizeof(W));
+}
@@ -0,0 +1,88 @@
+#include "scrypt_platform.h"
+
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_ARM_SHA1
+#include <arm_neon.h>
+
+#include "sha1_arm.h"
+
+/*
+ * As with sha256_arm.c, this is only built when the compiler targets CPUs
+ * with the SHA1 instructions, and only called once cpusupport_arm_sha1()
+ * agrees that this CPU has them.
+ */
+
+/*
+ * Four rounds, with message words W[4t .. 4t + 3] in ${w}, round constant
+ * ${k} and SHA1C, SHA1P or SHA1M as ${op}.  ${e} holds E for these rounds,
+ * and ${e_next} gets E for the following four, which SHA1H computes from A
+ * before the rounds.
+ */
+#define RND4(op, e, e_next, w, k) do {					\
+	WK = vaddq_u32(w, vdupq_n_u32(k));				\
+	e_next = vsha1h_u32(vgetq_lane_u32(ABCD, 0));			\
+	ABCD = op(ABCD, e, WK);						\
+} while (0)
+
+/* Turn W[i .. i + 3] in ${w0} into W[i + 16 .. i + 19]. */
+#define MSCH4(w0, w1, w2, w3)						\
+	w0 = vsha1su1q_u32(vsha1su0q_u32(w0, w1, w2), w3)
+
+#define K0	0x5a827999
+#define K1	0x6ed9eba1
+#define K2	0x8f1bbcdc
+#define K3	0xca62c1d6
+
+/**
+ * SHA1_Transform_arm(state, block):
+ * Compress the 64-byte ${block} into the SHA1 ${state}, using the ARMv8
+ * cryptography extensions.
+ */
+void
+SHA1_Transform_arm(uint32_t state[5], const uint8_t block[64])
+{
+	uint32x4_t ABCD, ABCD_orig;
+	uint32x4_t W0, W1, W2, W3, WK;
+	uint32_t E0, E0_orig, E1;
+
+	/* Load the state. */
+	ABCD = ABCD_orig = vld1q_u32(&state[0]);
+	E0 = E0_orig = state[4];
+
+	/* Load the message, which is big-endian. */
+	W0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[0])));
+	W1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[16])));
+	W2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[32])));
+	W3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[48])));
+
+	/* 80 rounds, expanding the message four words at a time. */
+	RND4(vsha1cq_u32, E0, E1, W0, K0);	MSCH4(W0, W1, W2, W3);
+	RND4(vsha1cq_u32, E1, E0, W1, K0);	MSCH4(W1, W2, W3, W0);
+	RND4(vsha1cq_u32, E0, E1, W2, K0);	MSCH4(W2, W3, W0, W1);
+	RND4(vsha1cq_u32, E1, E0, W3, K0);	MSCH4(W3, W0, W1, W2);
+	RND4(vsha1cq_u32, E0, E1, W0, K0);	MSCH4(W0, W1, W2, W3);
+	RND4(vsha1pq_u32, E1, E0, W1, K1);	MSCH4(W1, W2, W3, W0);
+	RND4(vsha1pq_u32, E0, E1, W2, K1);	MSCH4(W2, W3, W0, W1);
+	RND4(vsha1pq_u32, E1, E0, W3, K1);	MSCH4(W3, W0, W1, W2);
+	RND4(vsha1pq_u32, E0, E1, W0, K1);	MSCH4(W0, W1, W2, W3);
+	RND4(vsha1pq_u32, E1, E0, W1, K1);	MSCH4(W1, W2, W3, W0);
+	RND4(vsha1mq_u32, E0, E1, W2, K2);	MSCH4(W2, W3, W0, W1);
+	RND4(vsha1mq_u32, E1, E0, W3, K2);	MSCH4(W3, W0, W1, W2);
+	RND4(vsha1mq_u32, E0, E1, W0, K2);	MSCH4(W0, W1, W2, W3);
+	RND4(vsha1mq_u32, E1, E0, W1, K2);	MSCH4(W1, W2, W3, W0);
+	RND4(vsha1mq_u32, E0, E1, W2, K2);	MSCH4(W2, W3, W0, W1);
+	RND4(vsha1pq_u32, E1, E0, W3, K3);	MSCH4(W3, W0, W1, W2);
+	RND4(vsha1pq_u32, E0, E1, W0, K3);
+	RND4(vsha1pq_u32, E1, E0, W1, K3);
+	RND4(vsha1pq_u32, E0, E1, W2, K3);
+	RND4(vsha1pq_u32, E1, E0, W3, K3);
+
+	/* Add the old state and store the new one. */
+	vst1q_u32(&state[0], vaddq_u32(ABCD, ABCD_orig));
+	state[4] = E0 + E0_orig;
+}
+
+#endif /* CPUSUPPORT_ARM_SHA1 */
@@ -0,0 +1,104 @@
+#include "scrypt_platform.h"
+
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_SHANI
+#include <immintrin.h>
+
+#include "sha1_shani.h"
+
+/*
+ * As with sha256_shani.c, the function here is marked with a target
+ * attribute and must only be called once cpusupport_x86_shani() says the
+ * CPU can run it.
+ */
+
+/*
+ * Four rounds, with message words W[4t .. 4t + 3] in ${w}.  SHA1NEXTE works
+ * out E for these rounds from ${e}, which holds A from four rounds ago, and
+ * adds it to the message words; SHA1RNDS4 then does the rounds, with the
+ * round function and constant picked by ${f}.  ${e_next} gets A for use by
+ * the following four rounds.
+ */
+#define RND4(e, e_next, w, f) do {					\
+	e = _mm_sha1nexte_epu32(e, w);					\
+	e_next = ABCD;							\
+	ABCD = _mm_sha1rnds4_epu32(ABCD, e, f);				\
+} while (0)
+
+/*
+ * Message schedule: W[i + 16 .. i + 19] is built in the register which held
+ * W[i .. i + 3], as MSG1 with W[i + 4 .. i + 7], then MSGX with
+ * W[i + 8 .. i + 11], then MSG2 with W[i + 12 .. i + 15].
+ */
+#define MSG1(w0, w1)	w0 = _mm_sha1msg1_epu32(w0, w1)
+#define MSGX(w0, w2)	w0 = _mm_xor_si128(w0, w2)
+#define MSG2(w0, w3)	w0 = _mm_sha1msg2_epu32(w0, w3)
+
+/**
+ * SHA1_Transform_shani(state, block):
+ * Compress the 64-byte ${block} into the SHA1 ${state}, using the x86 SHA
+ * extensions.
+ */
+__attribute__((target("sha,sse4.1")))
+void
+SHA1_Transform_shani(uint32_t state[5], const uint8_t block[64])
+{
+	const __m128i BSWAP = _mm_set_epi64x(0x0001020304050607ULL,
+	    0x08090a0b0c0d0e0fULL);
+	__m128i ABCD, ABCD_orig, E0, E0_orig, E1;
+	__m128i W0, W1, W2, W3;
+
+	/* Load the state, with A in the top word and E on its own. */
+	ABCD = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),
+	    0x1b);
+	E0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+	ABCD_orig = ABCD;
+	E0_orig = E0;
+
+	/* Load the message, which is big-endian, in the same order. */
+	W0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[0]),
+	    BSWAP);
+	W1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[16]),
+	    BSWAP);
+	W2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[32]),
+	    BSWAP);
+	W3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[48]),
+	    BSWAP);
+
+	/* 80 rounds, expanding the message four words at a time. */
+	E0 = _mm_add_epi32(E0, W0);
+	E1 = ABCD;
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+	RND4(E1, E0, W1, 0);	MSG1(W0, W1);
+	RND4(E0, E1, W2, 0);	MSG1(W1, W2);	MSGX(W0, W2);
+	RND4(E1, E0, W3, 0);	MSG2(W0, W3);	MSG1(W2, W3);	MSGX(W1, W3);
+	RND4(E0, E1, W0, 0);	MSG2(W1, W0);	MSG1(W3, W0);	MSGX(W2, W0);
+	RND4(E1, E0, W1, 1);	MSG2(W2, W1);	MSG1(W0, W1);	MSGX(W3, W1);
+	RND4(E0, E1, W2, 1);	MSG2(W3, W2);	MSG1(W1, W2);	MSGX(W0, W2);
+	RND4(E1, E0, W3, 1);	MSG2(W0, W3);	MSG1(W2, W3);	MSGX(W1, W3);
+	RND4(E0, E1, W0, 1);	MSG2(W1, W0);	MSG1(W3, W0);	MSGX(W2, W0);
+	RND4(E1, E0, W1, 1);	MSG2(W2, W1);	MSG1(W0, W1);	MSGX(W3, W1);
+	RND4(E0, E1, W2, 2);	MSG2(W3, W2);	MSG1(W1, W2);	MSGX(W0, W2);
+	RND4(E1, E0, W3, 2);	MSG2(W0, W3);	MSG1(W2, W3);	MSGX(W1, W3);
+	RND4(E0, E1, W0, 2);	MSG2(W1, W0);	MSG1(W3, W0);	MSGX(W2, W0);
+	RND4(E1, E0, W1, 2);	MSG2(W2, W1);	MSG1(W0, W1);	MSGX(W3, W1);
+	RND4(E0, E1, W2, 2);	MSG2(W3, W2);	MSG1(W1, W2);	MSGX(W0, W2);
+	RND4(E1, E0, W3, 3);	MSG2(W0, W3);	MSG1(W2, W3);	MSGX(W1, W3);
+	RND4(E0, E1, W0, 3);	MSG2(W1, W0);	MSG1(W3, W0);	MSGX(W2, W0);
+	RND4(E1, E0, W1, 3);	MSG2(W2, W1);	MSGX(W3, W1);
+	RND4(E0, E1, W2, 3);	MSG2(W3, W2);
+	RND4(E1, E0, W3, 3);
+
+	/* Add the old state. */
+	E0 = _mm_sha1nexte_epu32(E0, E0_orig);
+	ABCD = _mm_add_epi32(ABCD, ABCD_orig);
+
+	/* Put it back in order and store it. */
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(ABCD, 0x1b));
+	state[4] = (uint32_t)_mm_extract_epi32(E0, 3);
+}
+
+#endif /* CPUSUPPORT_X86_SHANI */
@@ -27,13 +27,391 @@
 
 #include <sys/types.h>
 
+#include <pthread.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "cpusupport.h"
+#include "sha256_arm.h"
+#include "sha256_avx2.h"
+#include "sha256_shani.h"
+#include "sha256_sse2.h"
 #include "sysendian.h"
 
 #include "sha256.h"
 
+/* Number of independent SHA256 computations done side by side. */
+#define LANES	8
+
+/* Ways of compressing LANES blocks at once; see lanes_impl(). */
+#define LANES_SCALAR	0
+#define LANES_SSE2	1
+#define LANES_AVX2	2
+
+/* Ways of compressing a single block; see transform_impl(). */
+#define TRANSFORM_GENERIC	0
+#define TRANSFORM_SHANI		1
+#define TRANSFORM_ARM		2
+
+/* PBKDF2 output blocks shared out among threads by PBKDF2_SHA256_threads. */
+struct pbkdf2_shared {
+	const HMAC_SHA256_CTX * Pctx;
+	const uint8_t * salt;
+	size_t saltlen;
+	uint64_t c;
+	uint8_t * buf;
+	size_t dkLen;
+	size_t nblocks;
+	size_t chunk;
+	size_t next;
+	pthread_mutex_t mtx;
+};
+
+/*
+ * Encode a length len/4 vector of (uint32_t) into a length len vector of
+ * (unsigned char) in big-endian form.  Assumes len is a multiple of 4.
+ */
+static void
+be32enc_vect(unsigned char * dst, const uint32_t * src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len / 4; i++)
+		be32enc(dst + i * 4, src[i]);
+}
+
+/* SHA256 round constants. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* Elementary functions used by SHA256 */
+#define Ch(x, y, z)	((x & (y ^ z)) ^ z)
+#define Maj(x, y, z)	((x & (y | z)) | (y & z))
+#define SHR(x, n)	(x >> n)
+#define ROTR(x, n)	((x >> n) | (x << (32 - n)))
+#define S0(x)		(ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define S1(x)		(ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define s0(x)		(ROTR(x, 7) ^ ROTR(x, 18) ^ SHR(x, 3))
+#define s1(x)		(ROTR(x, 17) ^ ROTR(x, 19) ^ SHR(x, 10))
+
+/* SHA256 round function */
+#define RND(a, b, c, d, e, f, g, h, k)			\
+	h += S1(e) + Ch(e, f, g) + k;			\
+	d += h;						\
+	h += S0(a) + Maj(a, b, c);
+
+/* Adjusted round function for rotating state */
+#define RNDr(S, W, i, ii)			\
+	RND(S[(64 - i) % 8], S[(65 - i) % 8],	\
+	    S[(66 - i) % 8], S[(67 - i) % 8],	\
+	    S[(68 - i) % 8], S[(69 - i) % 8],	\
+	    S[(70 - i) % 8], S[(71 - i) % 8],	\
+	    W[i + ii] + Krnd[i + ii])
+
+/* Message schedule computation */
+#define MSCH(W, ii, i)				\
+	W[i + ii + 16] = s1(W[i + ii + 14]) + W[i + ii + 9] +	\
+	    s0(W[i + ii + 1]) + W[i + ii]
+
+/**
+ * SHA256_Transform_generic(state, block, W, S):
+ * Compress the 64-byte ${block} into the SHA256 ${state}, using ${W} and
+ * ${S} as scratch space.  This is the portable C code which is used when
+ * the CPU has no SHA256 instructions.
+ */
+static void
+SHA256_Transform_generic(uint32_t state[8], const uint8_t block[64],
+    uint32_t W[64], uint32_t S[8])
+{
+	int i;
+
+	/* 1. Prepare the first part of the message schedule W. */
+	be32dec_vec(W, block, 16);
+
+	/* 2. Initialize working variables. */
+	memcpy(S, state, 32);
+
+	/* 3. Mix. */
+	for (i = 0; i < 64; i += 16) {
+		RNDr(S, W, 0, i);
+		RNDr(S, W, 1, i);
+		RNDr(S, W, 2, i);
+		RNDr(S, W, 3, i);
+		RNDr(S, W, 4, i);
+		RNDr(S, W, 5, i);
+		RNDr(S, W, 6, i);
+		RNDr(S, W, 7, i);
+		RNDr(S, W, 8, i);
+		RNDr(S, W, 9, i);
+		RNDr(S, W, 10, i);
+		RNDr(S, W, 11, i);
+		RNDr(S, W, 12, i);
+		RNDr(S, W, 13, i);
+		RNDr(S, W, 14, i);
+		RNDr(S, W, 15, i);
+
+		if (i == 48)
+			break;
+		MSCH(W, 0, i);
+		MSCH(W, 1, i);
+		MSCH(W, 2, i);
+		MSCH(W, 3, i);
+		MSCH(W, 4, i);
+		MSCH(W, 5, i);
+		MSCH(W, 6, i);
+		MSCH(W, 7, i);
+		MSCH(W, 8, i);
+		MSCH(W, 9, i);
+		MSCH(W, 10, i);
+		MSCH(W, 11, i);
+		MSCH(W, 12, i);
+		MSCH(W, 13, i);
+		MSCH(W, 14, i);
+		MSCH(W, 15, i);
+	}
+
+	/* 4. Mix local working variables into global state. */
+	for (i = 0; i < 8; i++)
+		state[i] += S[i];
+}
+
+/* Magic initialization constants. */
+static const uint32_t initial_state[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+#if defined(CPUSUPPORT_X86_SHANI) || defined(CPUSUPPORT_ARM_SHA256)
+/**
+ * transform_ok(func):
+ * Return non-zero if ${func} compresses a test block into the initial SHA256
+ * state the same way SHA256_Transform_generic() does.  Code using hardware
+ * instructions is only trusted once it has passed this.
+ */
+static int
+transform_ok(void (* func)(uint32_t[8], const uint8_t[64]))
+{
+	uint32_t W[64], S[8];
+	uint32_t state[2][8];
+	uint8_t block[64];
+	int i;
+
+	/* Something which isn't too regular. */
+	for (i = 0; i < 64; i++)
+		block[i] = (uint8_t)(i * 37 + 11);
+
+	/* Compress it both ways and compare. */
+	memcpy(state[0], initial_state, 32);
+	memcpy(state[1], initial_state, 32);
+	SHA256_Transform_generic(state[0], block, W, S);
+	func(state[1], block);
+	return (memcmp(state[0], state[1], 32) == 0);
+}
+#endif
+
+/* The way of compressing one block picked by selecttransform(). */
+static int transform = TRANSFORM_GENERIC;
+static pthread_once_t transform_once = PTHREAD_ONCE_INIT;
+
+/**
+ * selecttransform(void):
+ * Pick the fastest way to compress one block which works on this CPU.
+ */
+static void
+selecttransform(void)
+{
+
+	/* Use SHA256 instructions if the CPU has them and they work. */
+#ifdef CPUSUPPORT_X86_SHANI
+	if (cpusupport_x86_shani() && transform_ok(SHA256_Transform_shani))
+		transform = TRANSFORM_SHANI;
+#endif
+#ifdef CPUSUPPORT_ARM_SHA256
+	if (cpusupport_arm_sha256() && transform_ok(SHA256_Transform_arm))
+		transform = TRANSFORM_ARM;
+#endif
+}
+
+/**
+ * transform_impl(void):
+ * Return the TRANSFORM_* value for the fastest way to compress one block on
+ * this CPU.
+ */
+static int
+transform_impl(void)
+{
+
+	/* Pick the implementation the first time through. */
+	if (pthread_once(&transform_once, selecttransform))
+		return (TRANSFORM_GENERIC);
+
+	return (transform);
+}
+
+/**
+ * SHA256_Transform(state, block, W, S):
+ * Compress the 64-byte ${block} into the SHA256 ${state}, in whichever way
+ * is fastest on this CPU.  ${W} and ${S} are scratch space for the portable
+ * code, which the caller should clean once it is done.
+ */
+static void
+SHA256_Transform(uint32_t state[8], const uint8_t block[64],
+    uint32_t W[64], uint32_t S[8])
+{
+
+	switch (transform_impl()) {
+#ifdef CPUSUPPORT_X86_SHANI
+	case TRANSFORM_SHANI:
+		SHA256_Transform_shani(state, block);
+		break;
+#endif
+#ifdef CPUSUPPORT_ARM_SHA256
+	case TRANSFORM_ARM:
+		SHA256_Transform_arm(state, block);
+		break;
+#endif
+	default:
+		SHA256_Transform_generic(state, block, W, S);
+		break;
+	}
+}
+
+static const uint8_t PAD[64] = {
+	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* Add padding and terminating bit-count. */
+static void
+SHA256_Pad(SHA256_CTX * ctx, uint32_t tmp32[72])
+{
+	size_t r;
+
+	/* Figure out how many bytes we have buffered. */
+	r = (ctx->count >> 3) & 0x3f;
+
+	/* Pad to 56 mod 64, transforming if we finish a block en route. */
+	if (r < 56) {
+		/* Pad to 56 mod 64. */
+		memcpy(&ctx->buf[r], PAD, 56 - r);
+	} else {
+		/* Finish the current block and mix. */
+		memcpy(&ctx->buf[r], PAD, 64 - r);
+		SHA256_Transform(ctx->state, ctx->buf, &tmp32[0], &tmp32[64]);
+
+		/* The start of the final block is all zeroes. */
+		memset(&ctx->buf[0], 0, 56);
+	}
+
+	/* Add the terminating bit-count. */
+	be64enc(&ctx->buf[56], ctx->count);
+
+	/* Mix in the final block. */
+	SHA256_Transform(ctx->state, ctx->buf, &tmp32[0], &tmp32[64]);
+}
+
+/**
+ * SHA256_Init(ctx):
+ * Initialize the SHA256 context ${ctx}.
+ */
+void
+SHA256_Init(SHA256_CTX * ctx)
+{
+
+	/* Zero bits processed so far. */
+	ctx->count = 0;
+
+	/* Initialize state. */
+	memcpy(ctx->state, initial_state, sizeof(initial_state));
+}
+
+/**
+ * SHA256_Update(ctx, in, len):
+ * Input ${len} bytes from ${in} into the SHA256 context ${ctx}.
+ */
+void
+SHA256_Update(SHA256_CTX * ctx, const void * in, size_t len)
+{
+	uint32_t tmp32[72];
+	uint32_t r;
+	const uint8_t * src = in;
+
+	/* Return immediately if we have nothing to do. */
+	if (len == 0)
+		return;
+
+	/* Number of bytes left in the buffer from previous updates. */
+	r = (ctx->count >> 3) & 0x3f;
+
+	/* Update number of bits. */
+	ctx->count += (uint64_t)(len) << 3;
+
+	/* Handle the case where we don't need to perform any transforms. */
+	if (len < 64 - r) {
+		memcpy(&ctx->buf[r], src, len);
+		return;
+	}
+
+	/* Finish the current block. */
+	memcpy(&ctx->buf[r], src, 64 - r);
+	SHA256_Transform(ctx->state, ctx->buf, &tmp32[0], &tmp32[64]);
+	src += 64 - r;
+	len -= 64 - r;
+
+	/* Perform complete blocks. */
+	while (len >= 64) {
+		SHA256_Transform(ctx->state, src, &tmp32[0], &tmp32[64]);
+		src += 64;
+		len -= 64;
+	}
+
+	/* Copy left over data into buffer. */
+	memcpy(ctx->buf, src, len);
+
+	/* Clean the stack. */
+	memset(tmp32, 0, 288);
+}
+
+/**
+ * SHA256_Final(digest, ctx):
+ * Output the SHA256 hash of the data input to the context ${ctx} into the
+ * buffer ${digest}, and clear the context state.
+ */
+void
+SHA256_Final(unsigned char digest[32], SHA256_CTX * ctx)
+{
+	uint32_t tmp32[72];
+
+	/* Add padding. */
+	SHA256_Pad(ctx, tmp32);
+
+	/* Write the hash. */
+	be32enc_vect(digest, ctx->state, 32);
+
+	/* Clear the context state, and the stack. */
+	memset(ctx, 0, sizeof(SHA256_CTX));
+	memset(tmp32, 0, 288);
+}
+
 /* Initialize an HMAC-SHA256 operation with the given key. */
 void
 HMAC_SHA256_Init(HMAC_SHA256_CTX * ctx, const void * _K, size_t Klen)
@@ -98,6 +476,249 @@ HMAC_SHA256_Final(unsigned char digest[32], HMAC_SHA256_CTX * ctx)
 	memset(ihash, 0, 32);
 }
 
+/* The way of compressing LANES blocks at once picked by selectlanes(). */
+static int lanes = LANES_SCALAR;
+static pthread_once_t lanes_once = PTHREAD_ONCE_INIT;
+
+/**
+ * selectlanes(void):
+ * Pick the fastest way to compress LANES blocks at once on this CPU.
+ */
+static void
+selectlanes(void)
+{
+
+	/* Use the widest SIMD code we can... */
+	if (cpusupport_x86_sse2())
+		lanes = LANES_SSE2;
+	if (cpusupport_x86_avx2())
+		lanes = LANES_AVX2;
+
+	/* ... unless the CPU has SHA256 instructions, which beat it. */
+	if (transform_impl() != TRANSFORM_GENERIC)
+		lanes = LANES_SCALAR;
+}
+
+/**
+ * lanes_impl(void):
+ * Return the LANES_* value for the fastest way to compress LANES blocks at
+ * once on this CPU.
+ */
+static int
+lanes_impl(void)
+{
+
+	/* Pick the implementation the first time through. */
+	if (pthread_once(&lanes_once, selectlanes))
+		return (LANES_SCALAR);
+
+	return (lanes);
+}
+
+/**
+ * lanes_compress(S, blocks, n):
+ * For each l < ${n}, compress the 64-byte block blocks[l] into the SHA256
+ * state held in column l of ${S}.
+ */
+static void
+lanes_compress(uint32_t S[8][LANES], const uint8_t * const * blocks,
+    size_t n)
+{
+	const uint8_t * b[LANES];
+	uint32_t state[8];
+	uint32_t tmp32[72];
+	size_t l;
+	int w;
+
+	/* SIMD code always does whole vectors: give unused lanes a block. */
+	for (l = 0; l < LANES; l++)
+		b[l] = blocks[(l < n) ? l : 0];
+
+	/* A single block is faster on its own than in a vector of junk. */
+	switch ((n > 1) ? lanes_impl() : LANES_SCALAR) {
+#ifdef CPUSUPPORT_X86_AVX2
+	case LANES_AVX2:
+		SHA256_Compress8_avx2(&S[0][0], LANES, b);
+		break;
+#endif
+#ifdef CPUSUPPORT_X86_SSE2
+	case LANES_SSE2:
+		for (l = 0; l < n; l += 4)
+			SHA256_Compress4_sse2(&S[0][l], LANES, &b[l]);
+		break;
+#endif
+	default:
+		for (l = 0; l < n; l++) {
+			for (w = 0; w < 8; w++)
+				state[w] = S[w][l];
+			SHA256_Transform(state, b[l], &tmp32[0], &tmp32[64]);
+			for (w = 0; w < 8; w++)
+				S[w][l] = state[w];
+		}
+		memset(state, 0, 32);
+		memset(tmp32, 0, 288);
+		break;
+	}
+}
+
+/**
+ * lanes_set(S, state):
+ * Set every column of ${S} to ${state}.
+ */
+static void
+lanes_set(uint32_t S[8][LANES], const uint32_t state[8])
+{
+	size_t l;
+	int w;
+
+	for (w = 0; w < 8; w++) {
+		for (l = 0; l < LANES; l++)
+			S[w][l] = state[w];
+	}
+}
+
+/**
+ * lanes_next(S, state, blk, n):
+ * For each l < ${n}, replace the hash in column l of ${S} with the hash of
+ * it under ${state}: it is written into the first 32 bytes of blk[l], whose
+ * last 32 bytes must already hold the padding, and compressed.
+ */
+static void
+lanes_next(uint32_t S[8][LANES], const uint32_t state[8],
+    uint8_t blk[LANES][64], size_t n)
+{
+	const uint8_t * blocks[LANES];
+	size_t l;
+	int w;
+
+	for (l = 0; l < n; l++) {
+		for (w = 0; w < 8; w++)
+			be32enc(&blk[l][w * 4], S[w][l]);
+		blocks[l] = blk[l];
+	}
+	lanes_set(S, state);
+	lanes_compress(S, blocks, n);
+}
+
+/**
+ * pad96(blk):
+ * Fill in the last 32 bytes of each of the LANES blocks ${blk} with the
+ * SHA256 padding for a 96-byte message: one block of HMAC key, then the
+ * 32-byte hash in the first half of the block.
+ */
+static void
+pad96(uint8_t blk[LANES][64])
+{
+	size_t l;
+
+	for (l = 0; l < LANES; l++) {
+		memset(&blk[l][32], 0, 32);
+		blk[l][32] = 0x80;
+		be32enc(&blk[l][60], 768);
+	}
+}
+
+/**
+ * HMAC_SHA256_Batch(ctx, in, inlen, n, out):
+ * Compute HMAC-SHA256(K, in[i][0 .. inlen[i] - 1]) for each i < ${n}, where
+ * ${ctx} is the result of HMAC_SHA256_Init(ctx, K, Klen) with no data added
+ * yet, and write them to out[32 * i .. 32 * i + 31].  The messages are
+ * hashed side by side, several at a time if the CPU has SIMD instructions
+ * for it; this is fastest when they are about the same length.
+ */
+void
+HMAC_SHA256_Batch(const HMAC_SHA256_CTX * ctx, const uint8_t * const * in,
+    const size_t * inlen, size_t n, uint8_t * out)
+{
+	HMAC_SHA256_CTX hctx;
+	uint32_t istate[8], ostate[8];
+	uint32_t S[8][LANES], H[8][LANES];
+	uint8_t tblk[LANES][128];
+	uint8_t oblk[LANES][64];
+	const uint8_t * blocks[LANES];
+	size_t nfull[LANES], nblk[LANES];
+	size_t i, k, kmax, l, m, tail;
+	int w;
+
+	/* Without SIMD, let SHA256_Update run through each message. */
+	if (lanes_impl() == LANES_SCALAR) {
+		for (i = 0; i < n; i++) {
+			memcpy(&hctx, ctx, sizeof(HMAC_SHA256_CTX));
+			HMAC_SHA256_Update(&hctx, in[i], inlen[i]);
+			HMAC_SHA256_Final(&out[i * 32], &hctx);
+		}
+		return;
+	}
+
+	/* Keyed states, after the ipad and opad blocks. */
+	for (w = 0; w < 8; w++) {
+		istate[w] = ctx->ictx.state[w];
+		ostate[w] = ctx->octx.state[w];
+	}
+	pad96(oblk);
+
+	/* Hash up to LANES messages at a time. */
+	for (i = 0; i < n; i += m) {
+		m = (n - i < LANES) ? n - i : LANES;
+
+		/* Copy the end of each message and pad it. */
+		for (kmax = 0, l = 0; l < m; l++) {
+			nfull[l] = inlen[i + l] / 64;
+			tail = inlen[i + l] % 64;
+			nblk[l] = nfull[l] + ((tail + 9 > 64) ? 2 : 1);
+			memset(tblk[l], 0, 128);
+			if (tail > 0)
+				memcpy(tblk[l], &in[i + l][nfull[l] * 64],
+				    tail);
+			tblk[l][tail] = 0x80;
+			be64enc(&tblk[l][(nblk[l] - nfull[l]) * 64 - 8],
+			    ((uint64_t)inlen[i + l] + 64) * 8);
+			if (kmax < nblk[l])
+				kmax = nblk[l];
+		}
+
+		/*
+		 * Inner hashes.  A message which runs out of blocks before
+		 * the others has its hash saved, and then hashes junk.
+		 */
+		lanes_set(S, istate);
+		for (k = 0; k < kmax; k++) {
+			for (l = 0; l < m; l++) {
+				if (k < nfull[l])
+					blocks[l] = &in[i + l][k * 64];
+				else if (k < nblk[l])
+					blocks[l] =
+					    &tblk[l][(k - nfull[l]) * 64];
+				else
+					blocks[l] = tblk[l];
+			}
+			lanes_compress(S, blocks, m);
+			for (l = 0; l < m; l++) {
+				if (k + 1 != nblk[l])
+					continue;
+				for (w = 0; w < 8; w++)
+					H[w][l] = S[w][l];
+			}
+		}
+
+		/* Outer hashes. */
+		memcpy(S, H, sizeof(S));
+		lanes_next(S, ostate, oblk, m);
+		for (l = 0; l < m; l++) {
+			for (w = 0; w < 8; w++)
+				be32enc(&out[(i + l) * 32 + w * 4], S[w][l]);
+		}
+	}
+
+	/* Clean the stack. */
+	memset(istate, 0, 32);
+	memset(ostate, 0, 32);
+	memset(S, 0, sizeof(S));
+	memset(H, 0, sizeof(H));
+	memset(tblk, 0, sizeof(tblk));
+	memset(oblk, 0, sizeof(oblk));
+}
+
 /**
  * PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
  * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA256 as the PRF, and
@@ -107,50 +728,256 @@ void
 PBKDF2_SHA256(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
     size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
 {
-	HMAC_SHA256_CTX PShctx, hctx;
-	size_t i;
-	uint8_t ivec[4];
+	HMAC_SHA256_CTX Pctx;
+
+	/* Key HMAC with the password, then do the work. */
+	HMAC_SHA256_Init(&Pctx, passwd, passwdlen);
+	PBKDF2_SHA256_Keyed(&Pctx, salt, saltlen, c, buf, dkLen);
+
+	/* Clean Pctx, since we never called _Final on it. */
+	memset(&Pctx, 0, sizeof(HMAC_SHA256_CTX));
+}
+
+/**
+ * pbkdf2_blocks(Pctx, salt, saltlen, c, buf, dkLen, i0, i1):
+ * Compute the output blocks T_{i0 + 1} .. T_{i1} of PBKDF2(passwd, salt, c,
+ * dkLen), where ${Pctx} is as for PBKDF2_SHA256_Keyed(), and write them to
+ * their places in ${buf}.
+ */
+static void
+pbkdf2_blocks(const HMAC_SHA256_CTX * Pctx, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen, size_t i0,
+    size_t i1)
+{
+	uint32_t istate[8], ostate[8], sstate[8];
+	uint32_t S[8][LANES], T[8][LANES];
+	uint8_t ublk[LANES][128];
+	uint8_t iblk[LANES][64], oblk[LANES][64];
+	const uint8_t * blocks[LANES];
 	uint8_t U[32];
-	uint8_t T[32];
-	uint64_t j;
-	int k;
+	uint32_t tmp32[72];
+	size_t tail, ulen;
+	size_t i, l, n;
 	size_t clen;
+	uint64_t j;
+	int w;
+
+	/* Keyed states, after the ipad and opad blocks. */
+	for (w = 0; w < 8; w++) {
+		istate[w] = Pctx->ictx.state[w];
+		ostate[w] = Pctx->octx.state[w];
+	}
 
-	/* Compute HMAC state after processing P and S. */
-	HMAC_SHA256_Init(&PShctx, passwd, passwdlen);
-	HMAC_SHA256_Update(&PShctx, salt, saltlen);
+	/* Every U_1 starts with the salt; hash its whole blocks once. */
+	memcpy(sstate, istate, 32);
+	for (tail = saltlen; tail >= 64; tail -= 64)
+		SHA256_Transform(sstate, &salt[saltlen - tail],
+		    &tmp32[0], &tmp32[64]);
 
-	/* Iterate through the blocks. */
-	for (i = 0; i * 32 < dkLen; i++) {
-		/* Generate INT(i + 1). */
-		be32enc(ivec, (uint32_t)(i + 1));
+	/*
+	 * What is left of S || INT(i), with its padding, takes one block, or
+	 * two if the padding doesn't fit; only INT(i) differs between blocks.
+	 */
+	ulen = (tail + 4 + 9 > 64) ? 128 : 64;
+	for (l = 0; l < LANES; l++) {
+		memset(ublk[l], 0, ulen);
+		if (tail > 0)
+			memcpy(ublk[l], &salt[saltlen - tail], tail);
+		ublk[l][tail + 4] = 0x80;
+		be64enc(&ublk[l][ulen - 8], ((uint64_t)saltlen + 68) * 8);
+	}
+
+	/*
+	 * U_j = PRF(P, U_{j-1}) for j >= 2 is always the SHA256 compression
+	 * of one block after the ipad block, then of one block after the opad
+	 * block, and each of those blocks is a 32-byte hash followed by the
+	 * same padding; so is the block in the outer hash of U_1.
+	 */
+	pad96(iblk);
+	pad96(oblk);
+
+	/* Iterate through the blocks, up to LANES at a time. */
+	for (i = i0; i < i1; i += n) {
+		n = i1 - i;
+		if (n > LANES)
+			n = LANES;
 
 		/* Compute U_1 = PRF(P, S || INT(i)). */
-		memcpy(&hctx, &PShctx, sizeof(HMAC_SHA256_CTX));
-		HMAC_SHA256_Update(&hctx, ivec, 4);
-		HMAC_SHA256_Final(U, &hctx);
+		for (l = 0; l < n; l++) {
+			be32enc(&ublk[l][tail], (uint32_t)(i + l + 1));
+			blocks[l] = ublk[l];
+		}
+		lanes_set(S, sstate);
+		lanes_compress(S, blocks, n);
+		if (ulen == 128) {
+			for (l = 0; l < n; l++)
+				blocks[l] = &ublk[l][64];
+			lanes_compress(S, blocks, n);
+		}
+		lanes_next(S, ostate, oblk, n);
 
 		/* T_i = U_1 ... */
-		memcpy(T, U, 32);
+		memcpy(T, S, sizeof(T));
 
 		for (j = 2; j <= c; j++) {
 			/* Compute U_j. */
-			HMAC_SHA256_Init(&hctx, passwd, passwdlen);
-			HMAC_SHA256_Update(&hctx, U, 32);
-			HMAC_SHA256_Final(U, &hctx);
+			lanes_next(S, istate, iblk, n);
+			lanes_next(S, ostate, oblk, n);
 
 			/* ... xor U_j ... */
-			for (k = 0; k < 32; k++)
-				T[k] ^= U[k];
+			for (w = 0; w < 8; w++) {
+				for (l = 0; l < n; l++)
+					T[w][l] ^= S[w][l];
+			}
 		}
 
 		/* Copy as many bytes as necessary into buf. */
-		clen = dkLen - i * 32;
-		if (clen > 32)
-			clen = 32;
-		memcpy(&buf[i * 32], T, clen);
+		for (l = 0; l < n; l++) {
+			for (w = 0; w < 8; w++)
+				be32enc(&U[w * 4], T[w][l]);
+			clen = dkLen - (i + l) * 32;
+			if (clen > 32)
+				clen = 32;
+			memcpy(&buf[(i + l) * 32], U, clen);
+		}
 	}
 
-	/* Clean PShctx, since we never called _Final on it. */
-	memset(&PShctx, 0, sizeof(HMAC_SHA256_CTX));
+	/* Clean the stack. */
+	memset(istate, 0, 32);
+	memset(ostate, 0, 32);
+	memset(sstate, 0, 32);
+	memset(S, 0, sizeof(S));
+	memset(T, 0, sizeof(T));
+	memset(ublk, 0, sizeof(ublk));
+	memset(iblk, 0, sizeof(iblk));
+	memset(oblk, 0, sizeof(oblk));
+	memset(U, 0, 32);
+	memset(tmp32, 0, 288);
+}
+
+/**
+ * PBKDF2_SHA256_Keyed(Pctx, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA256() does, where
+ * ${Pctx} is the result of HMAC_SHA256_Init(Pctx, passwd, passwdlen) with no
+ * data added yet.  This lets several computations with the same password
+ * share the work of keying HMAC.  ${Pctx} is not modified.
+ */
+void
+PBKDF2_SHA256_Keyed(const HMAC_SHA256_CTX * Pctx, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
+{
+
+	pbkdf2_blocks(Pctx, salt, saltlen, c, buf, dkLen, 0,
+	    (dkLen + 31) / 32);
+}
+
+/**
+ * pbkdf2_shared_run(P):
+ * Compute chunks of the output blocks in ${P} which have not yet been claimed
+ * by another thread, until there are none left.
+ */
+static void
+pbkdf2_shared_run(struct pbkdf2_shared * P)
+{
+	size_t i0, i1;
+
+	for (;;) {
+		/* Claim the next chunk. */
+		pthread_mutex_lock(&P->mtx);
+		i0 = P->next;
+		if (i0 < P->nblocks)
+			P->next += P->chunk;
+		pthread_mutex_unlock(&P->mtx);
+
+		/* Are we done? */
+		if (i0 >= P->nblocks)
+			break;
+
+		/* Compute it. */
+		i1 = (P->nblocks - i0 < P->chunk) ? P->nblocks : i0 + P->chunk;
+		pbkdf2_blocks(P->Pctx, P->salt, P->saltlen, P->c, P->buf,
+		    P->dkLen, i0, i1);
+	}
+}
+
+/**
+ * pbkdf2_shared_thread(cookie):
+ * Worker thread for PBKDF2_SHA256_threads().
+ */
+static void *
+pbkdf2_shared_thread(void * cookie)
+{
+
+	pbkdf2_shared_run(cookie);
+	return (NULL);
+}
+
+/**
+ * PBKDF2_SHA256_threads(passwd, passwdlen, salt, saltlen, c, buf, dkLen,
+ *     nthreads):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA256() does, sharing
+ * the output blocks out among up to ${nthreads} threads; each thread hashes
+ * a whole vector of blocks at a time if the CPU has SIMD code for it.  The
+ * output is the same as PBKDF2_SHA256()'s.  If threads can't be started, the
+ * work is done in this thread.
+ */
+void
+PBKDF2_SHA256_threads(const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t c, uint8_t * buf,
+    size_t dkLen, uint32_t nthreads)
+{
+	HMAC_SHA256_CTX Pctx;
+	struct pbkdf2_shared P;
+	pthread_t * threads;
+	size_t nchunks;
+	uint32_t nspawned;
+	uint32_t i;
+
+	/* Key HMAC with the password. */
+	HMAC_SHA256_Init(&Pctx, passwd, passwdlen);
+
+	/*
+	 * Share out LANES blocks at a time, so that vectors are full; or
+	 * single blocks if they are hashed one at a time anyway.  There is
+	 * no point in having more threads than chunks.
+	 */
+	P.nblocks = (dkLen + 31) / 32;
+	P.chunk = (lanes_impl() == LANES_SCALAR) ? 1 : LANES;
+	nchunks = (P.nblocks + P.chunk - 1) / P.chunk;
+	if (nthreads > nchunks)
+		nthreads = (uint32_t)nchunks;
+
+	/* Do it all here if we have only one thread. */
+	if ((nthreads <= 1) || pthread_mutex_init(&P.mtx, NULL)) {
+		PBKDF2_SHA256_Keyed(&Pctx, salt, saltlen, c, buf, dkLen);
+		goto done;
+	}
+	P.Pctx = &Pctx;
+	P.salt = salt;
+	P.saltlen = saltlen;
+	P.c = c;
+	P.buf = buf;
+	P.dkLen = dkLen;
+	P.next = 0;
+
+	/* Start helper threads, as many as we can; this thread helps too. */
+	nspawned = 0;
+	if ((threads = malloc((nthreads - 1) * sizeof(pthread_t))) != NULL) {
+		for (; nspawned < nthreads - 1; nspawned++) {
+			if (pthread_create(&threads[nspawned], NULL,
+			    pbkdf2_shared_thread, &P))
+				break;
+		}
+	}
+	pbkdf2_shared_run(&P);
+
+	/* Wait for the helpers to finish. */
+	for (i = 0; i < nspawned; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	pthread_mutex_destroy(&P.mtx);
+
+done:
+	/* Clean Pctx, since we never called _Final on it. */
+	memset(&Pctx, 0, sizeof(HMAC_SHA256_CTX));
 }
@@ -0,0 +1,98 @@
+#include "scrypt_platform.h"
+
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_ARM_SHA256
+#include <arm_neon.h>
+
+#include "sha256_arm.h"
+
+/*
+ * This code is only built when the compiler already targets CPUs with the
+ * SHA256 instructions (see config.h); even so, the function is only called
+ * once cpusupport_arm_sha256() agrees that this CPU has them.
+ */
+
+/* SHA256 round constants. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * Four rounds, with message words W[4t .. 4t + 3] in ${msg}.  SHA256H and
+ * SHA256H2 update the ABCD and EFGH halves of the state; each needs the
+ * other half from before the rounds.
+ */
+#define RND4(msg, t) do {						\
+	WK = vaddq_u32(msg, vld1q_u32(&Krnd[(t) * 4]));			\
+	ABCD_prev = ABCD;						\
+	ABCD = vsha256hq_u32(ABCD, EFGH, WK);				\
+	EFGH = vsha256h2q_u32(EFGH, ABCD_prev, WK);			\
+} while (0)
+
+/* Turn W[i .. i + 3] in ${w0} into W[i + 16 .. i + 19]. */
+#define MSCH4(w0, w1, w2, w3)						\
+	w0 = vsha256su1q_u32(vsha256su0q_u32(w0, w1), w2, w3)
+
+/**
+ * SHA256_Transform_arm(state, block):
+ * Compress the 64-byte ${block} into the SHA256 ${state}, using the ARMv8
+ * cryptography extensions.
+ */
+void
+SHA256_Transform_arm(uint32_t state[8], const uint8_t block[64])
+{
+	uint32x4_t ABCD, EFGH, ABCD_orig, EFGH_orig, ABCD_prev;
+	uint32x4_t W0, W1, W2, W3, WK;
+
+	/* Load the state. */
+	ABCD = ABCD_orig = vld1q_u32(&state[0]);
+	EFGH = EFGH_orig = vld1q_u32(&state[4]);
+
+	/* Load the message, which is big-endian. */
+	W0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[0])));
+	W1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[16])));
+	W2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[32])));
+	W3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[48])));
+
+	/* 64 rounds, expanding the message four words at a time. */
+	RND4(W0, 0);	MSCH4(W0, W1, W2, W3);
+	RND4(W1, 1);	MSCH4(W1, W2, W3, W0);
+	RND4(W2, 2);	MSCH4(W2, W3, W0, W1);
+	RND4(W3, 3);	MSCH4(W3, W0, W1, W2);
+	RND4(W0, 4);	MSCH4(W0, W1, W2, W3);
+	RND4(W1, 5);	MSCH4(W1, W2, W3, W0);
+	RND4(W2, 6);	MSCH4(W2, W3, W0, W1);
+	RND4(W3, 7);	MSCH4(W3, W0, W1, W2);
+	RND4(W0, 8);	MSCH4(W0, W1, W2, W3);
+	RND4(W1, 9);	MSCH4(W1, W2, W3, W0);
+	RND4(W2, 10);	MSCH4(W2, W3, W0, W1);
+	RND4(W3, 11);	MSCH4(W3, W0, W1, W2);
+	RND4(W0, 12);
+	RND4(W1, 13);
+	RND4(W2, 14);
+	RND4(W3, 15);
+
+	/* Add the old state and store the new one. */
+	vst1q_u32(&state[0], vaddq_u32(ABCD, ABCD_orig));
+	vst1q_u32(&state[4], vaddq_u32(EFGH, EFGH_orig));
+}
+
+#endif /* CPUSUPPORT_ARM_SHA256 */
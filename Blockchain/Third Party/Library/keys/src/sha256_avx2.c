@@ -0,0 +1,109 @@
+#include "scrypt_platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_AVX2
+#include <immintrin.h>
+
+#include "sysendian.h"
+
+#include "sha256_avx2.h"
+
+/*
+ * This file is compiled for whatever the rest of the build targets, so the
+ * function which uses AVX2 is marked with a target attribute and must only
+ * be called once cpusupport_x86_avx2() says the CPU can run it.
+ */
+
+/* SHA256 round constants. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* Operations on 8 lanes at once, and the functions SHA256 is built from. */
+#define ADD(x, y)	_mm256_add_epi32(x, y)
+#define AND(x, y)	_mm256_and_si256(x, y)
+#define OR(x, y)	_mm256_or_si256(x, y)
+#define XOR(x, y)	_mm256_xor_si256(x, y)
+#define SHR(x, n)	_mm256_srli_epi32(x, n)
+#define ROTR(x, n)	OR(SHR(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define Ch(x, y, z)	XOR(AND(x, XOR(y, z)), z)
+#define Maj(x, y, z)	OR(AND(x, y), AND(z, OR(x, y)))
+#define S0(x)		XOR(XOR(ROTR(x, 2), ROTR(x, 13)), ROTR(x, 22))
+#define S1(x)		XOR(XOR(ROTR(x, 6), ROTR(x, 11)), ROTR(x, 25))
+#define s0(x)		XOR(XOR(ROTR(x, 7), ROTR(x, 18)), SHR(x, 3))
+#define s1(x)		XOR(XOR(ROTR(x, 17), ROTR(x, 19)), SHR(x, 10))
+
+/**
+ * SHA256_Compress8_avx2(S, stride, blocks):
+ * Compress the 64-byte blocks blocks[0 .. 7] into 8 SHA256 states which
+ * are interleaved in ${S}: word w of the state for blocks[l] is at
+ * S[w * stride + l].
+ */
+__attribute__((target("avx2")))
+void
+SHA256_Compress8_avx2(uint32_t * S, size_t stride,
+    const uint8_t * const * blocks)
+{
+	__m256i W[64];
+	__m256i H[8];
+	__m256i a, b, c, d, e, f, g, h;
+	__m256i T1, T2;
+	int t;
+
+	/* Load the message, one word from each block per vector. */
+	for (t = 0; t < 16; t++)
+		W[t] = _mm256_set_epi32(
+		    be32dec(&blocks[7][t * 4]), be32dec(&blocks[6][t * 4]),
+		    be32dec(&blocks[5][t * 4]), be32dec(&blocks[4][t * 4]),
+		    be32dec(&blocks[3][t * 4]), be32dec(&blocks[2][t * 4]),
+		    be32dec(&blocks[1][t * 4]), be32dec(&blocks[0][t * 4]));
+
+	/* Expand it. */
+	for (t = 16; t < 64; t++)
+		W[t] = ADD(ADD(s1(W[t - 2]), W[t - 7]),
+		    ADD(s0(W[t - 15]), W[t - 16]));
+
+	/* Load the states. */
+	for (t = 0; t < 8; t++)
+		H[t] = _mm256_loadu_si256((__m256i *)&S[t * stride]);
+	a = H[0]; b = H[1]; c = H[2]; d = H[3];
+	e = H[4]; f = H[5]; g = H[6]; h = H[7];
+
+	/* 64 rounds. */
+	for (t = 0; t < 64; t++) {
+		T1 = ADD(ADD(h, S1(e)), ADD(Ch(e, f, g),
+		    ADD(_mm256_set1_epi32((int)Krnd[t]), W[t])));
+		T2 = ADD(S0(a), Maj(a, b, c));
+		h = g; g = f; f = e; e = ADD(d, T1);
+		d = c; c = b; b = a; a = ADD(T1, T2);
+	}
+
+	/* Add the old states and store the new ones. */
+	H[0] = ADD(H[0], a); H[1] = ADD(H[1], b);
+	H[2] = ADD(H[2], c); H[3] = ADD(H[3], d);
+	H[4] = ADD(H[4], e); H[5] = ADD(H[5], f);
+	H[6] = ADD(H[6], g); H[7] = ADD(H[7], h);
+	for (t = 0; t < 8; t++)
+		_mm256_storeu_si256((__m256i *)&S[t * stride], H[t]);
+}
+
+#endif /* CPUSUPPORT_X86_AVX2 */
@@ -0,0 +1,130 @@
+#include "scrypt_platform.h"
+
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_SHANI
+#include <immintrin.h>
+
+#include "sha256_shani.h"
+
+/*
+ * This file is compiled for whatever the rest of the build targets, so the
+ * function which uses the SHA extensions is marked with a target attribute
+ * and must only be called once cpusupport_x86_shani() says the CPU can run
+ * it.  Every CPU with the SHA extensions also has SSE4.1, which we use to
+ * shuffle the state into the order the instructions want.
+ */
+
+/* SHA256 round constants. */
+static const uint32_t Krnd[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * Four rounds, with message words W[4t .. 4t + 3] in ${msg}.  SHA256RNDS2
+ * does two rounds on the state held as ABEF and CDGH, taking W + K from the
+ * low half of its third operand.
+ */
+#define RND4(msg, t) do {						\
+	MSG = _mm_add_epi32(msg,					\
+	    _mm_loadu_si128((const __m128i *)&Krnd[(t) * 4]));		\
+	CDGH = _mm_sha256rnds2_epu32(CDGH, ABEF, MSG);			\
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);				\
+	ABEF = _mm_sha256rnds2_epu32(ABEF, CDGH, MSG);			\
+} while (0)
+
+/*
+ * Message schedule: given W[i .. i + 3] in ${w0} and W[i + 4 .. i + 7] in
+ * ${w1}, MSG1 adds s0(W[i + 1 .. i + 4]) into ${w0}; once ${w0} holds that,
+ * and ${w2}, ${w3} hold W[i + 8 .. i + 15], MSG2 turns ${w0} into
+ * W[i + 16 .. i + 19].
+ */
+#define MSG1(w0, w1)	w0 = _mm_sha256msg1_epu32(w0, w1)
+#define MSG2(w0, w2, w3)						\
+	w0 = _mm_sha256msg2_epu32(					\
+	    _mm_add_epi32(w0, _mm_alignr_epi8(w3, w2, 4)), w3)
+
+/**
+ * SHA256_Transform_shani(state, block):
+ * Compress the 64-byte ${block} into the SHA256 ${state}, using the x86
+ * SHA extensions.
+ */
+__attribute__((target("sha,sse4.1")))
+void
+SHA256_Transform_shani(uint32_t state[8], const uint8_t block[64])
+{
+	const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+	    0x0405060700010203ULL);
+	__m128i ABEF, CDGH, ABEF_orig, CDGH_orig;
+	__m128i MSG, TMP;
+	__m128i W0, W1, W2, W3;
+
+	/* Load the state as ABCD and EFGH, and rearrange it. */
+	TMP = _mm_loadu_si128((const __m128i *)&state[0]);
+	CDGH = _mm_loadu_si128((const __m128i *)&state[4]);
+	TMP = _mm_shuffle_epi32(TMP, 0xb1);		/* CDAB */
+	CDGH = _mm_shuffle_epi32(CDGH, 0x1b);		/* EFGH */
+	ABEF = _mm_alignr_epi8(TMP, CDGH, 8);		/* ABEF */
+	CDGH = _mm_blend_epi16(CDGH, TMP, 0xf0);	/* CDGH */
+	ABEF_orig = ABEF;
+	CDGH_orig = CDGH;
+
+	/* Load the message, which is big-endian. */
+	W0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[0]),
+	    BSWAP);
+	W1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[16]),
+	    BSWAP);
+	W2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[32]),
+	    BSWAP);
+	W3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&block[48]),
+	    BSWAP);
+
+	/* 64 rounds, expanding the message four words at a time. */
+	RND4(W0, 0);
+	RND4(W1, 1);	MSG1(W0, W1);
+	RND4(W2, 2);	MSG1(W1, W2);
+	RND4(W3, 3);	MSG2(W0, W2, W3);	MSG1(W2, W3);
+	RND4(W0, 4);	MSG2(W1, W3, W0);	MSG1(W3, W0);
+	RND4(W1, 5);	MSG2(W2, W0, W1);	MSG1(W0, W1);
+	RND4(W2, 6);	MSG2(W3, W1, W2);	MSG1(W1, W2);
+	RND4(W3, 7);	MSG2(W0, W2, W3);	MSG1(W2, W3);
+	RND4(W0, 8);	MSG2(W1, W3, W0);	MSG1(W3, W0);
+	RND4(W1, 9);	MSG2(W2, W0, W1);	MSG1(W0, W1);
+	RND4(W2, 10);	MSG2(W3, W1, W2);	MSG1(W1, W2);
+	RND4(W3, 11);	MSG2(W0, W2, W3);	MSG1(W2, W3);
+	RND4(W0, 12);	MSG2(W1, W3, W0);	MSG1(W3, W0);
+	RND4(W1, 13);	MSG2(W2, W0, W1);
+	RND4(W2, 14);	MSG2(W3, W1, W2);
+	RND4(W3, 15);
+
+	/* Add the old state. */
+	ABEF = _mm_add_epi32(ABEF, ABEF_orig);
+	CDGH = _mm_add_epi32(CDGH, CDGH_orig);
+
+	/* Put it back in order and store it. */
+	TMP = _mm_shuffle_epi32(ABEF, 0x1b);		/* FEBA */
+	CDGH = _mm_shuffle_epi32(CDGH, 0xb1);		/* DCHG */
+	ABEF = _mm_blend_epi16(TMP, CDGH, 0xf0);	/* DCBA */
+	CDGH = _mm_alignr_epi8(CDGH, TMP, 8);		/* HGFE */
+	_mm_storeu_si128((__m128i *)&state[0], ABEF);
+	_mm_storeu_si128((__m128i *)&state[4], CDGH);
+}
+
+#endif /* CPUSUPPORT_X86_SHANI */
@@ -0,0 +1,729 @@
+#include "scrypt_platform.h"
+
+#include <sys/types.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpusupport.h"
+#include "sha512_arm.h"
+#include "sha512_avx2.h"
+#include "sysendian.h"
+
+#include "sha512.h"
+
+/*
+ * This follows sha256.c closely: a portable compression function, which is
+ * replaced by the CPU's own SHA512 instructions where it has them, and
+ * multi-buffer SIMD code which computes the blocks of PBKDF2 output side by
+ * side on CPUs without them.  There is no SSE2 version of the latter: with
+ * only two 64-bit lanes and no rotate instruction, it loses to scalar code.
+ */
+
+/* Number of independent SHA512 computations done side by side. */
+#define LANES	4
+
+/* Ways of compressing LANES blocks at once; see lanes_impl(). */
+#define LANES_SCALAR	0
+#define LANES_AVX2	1
+
+/* Ways of compressing a single block; see transform_impl(). */
+#define TRANSFORM_GENERIC	0
+#define TRANSFORM_ARM		1
+
+/*
+ * Encode a length len/8 vector of (uint64_t) into a length len vector of
+ * (unsigned char) in big-endian form.  Assumes len is a multiple of 8.
+ */
+static void
+be64enc_vect(unsigned char * dst, const uint64_t * src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len / 8; i++)
+		be64enc(dst + i * 8, src[i]);
+}
+
+/* SHA512 round constants. */
+static const uint64_t Krnd[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/* Elementary functions used by SHA512 */
+#define Ch(x, y, z)	((x & (y ^ z)) ^ z)
+#define Maj(x, y, z)	((x & (y | z)) | (y & z))
+#define SHR(x, n)	(x >> n)
+#define ROTR(x, n)	((x >> n) | (x << (64 - n)))
+#define S0(x)		(ROTR(x, 28) ^ ROTR(x, 34) ^ ROTR(x, 39))
+#define S1(x)		(ROTR(x, 14) ^ ROTR(x, 18) ^ ROTR(x, 41))
+#define s0(x)		(ROTR(x, 1) ^ ROTR(x, 8) ^ SHR(x, 7))
+#define s1(x)		(ROTR(x, 19) ^ ROTR(x, 61) ^ SHR(x, 6))
+
+/* SHA512 round function */
+#define RND(a, b, c, d, e, f, g, h, k)			\
+	h += S1(e) + Ch(e, f, g) + k;			\
+	d += h;						\
+	h += S0(a) + Maj(a, b, c);
+
+/* Adjusted round function for rotating state */
+#define RNDr(S, W, i, ii)			\
+	RND(S[(64 - i) % 8], S[(65 - i) % 8],	\
+	    S[(66 - i) % 8], S[(67 - i) % 8],	\
+	    S[(68 - i) % 8], S[(69 - i) % 8],	\
+	    S[(70 - i) % 8], S[(71 - i) % 8],	\
+	    W[i + ii] + Krnd[i + ii])
+
+/* Message schedule computation */
+#define MSCH(W, ii, i)				\
+	W[i + ii + 16] = s1(W[i + ii + 14]) + W[i + ii + 9] +	\
+	    s0(W[i + ii + 1]) + W[i + ii]
+
+/**
+ * SHA512_Transform_generic(state, block, W, S):
+ * Compress the 128-byte ${block} into the SHA512 ${state}, using ${W} and
+ * ${S} as scratch space.  This is the portable C code which is used when
+ * the CPU has no SHA512 instructions.
+ */
+static void
+SHA512_Transform_generic(uint64_t state[8], const uint8_t block[128],
+    uint64_t W[80], uint64_t S[8])
+{
+	int i;
+
+	/* 1. Prepare the first part of the message schedule W. */
+	for (i = 0; i < 16; i++)
+		W[i] = be64dec(&block[i * 8]);
+
+	/* 2. Initialize working variables. */
+	memcpy(S, state, 64);
+
+	/* 3. Mix. */
+	for (i = 0; i < 80; i += 16) {
+		RNDr(S, W, 0, i);
+		RNDr(S, W, 1, i);
+		RNDr(S, W, 2, i);
+		RNDr(S, W, 3, i);
+		RNDr(S, W, 4, i);
+		RNDr(S, W, 5, i);
+		RNDr(S, W, 6, i);
+		RNDr(S, W, 7, i);
+		RNDr(S, W, 8, i);
+		RNDr(S, W, 9, i);
+		RNDr(S, W, 10, i);
+		RNDr(S, W, 11, i);
+		RNDr(S, W, 12, i);
+		RNDr(S, W, 13, i);
+		RNDr(S, W, 14, i);
+		RNDr(S, W, 15, i);
+
+		if (i == 64)
+			break;
+		MSCH(W, 0, i);
+		MSCH(W, 1, i);
+		MSCH(W, 2, i);
+		MSCH(W, 3, i);
+		MSCH(W, 4, i);
+		MSCH(W, 5, i);
+		MSCH(W, 6, i);
+		MSCH(W, 7, i);
+		MSCH(W, 8, i);
+		MSCH(W, 9, i);
+		MSCH(W, 10, i);
+		MSCH(W, 11, i);
+		MSCH(W, 12, i);
+		MSCH(W, 13, i);
+		MSCH(W, 14, i);
+		MSCH(W, 15, i);
+	}
+
+	/* 4. Mix local working variables into global state. */
+	for (i = 0; i < 8; i++)
+		state[i] += S[i];
+}
+
+/* Magic initialization constants. */
+static const uint64_t initial_state[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+#ifdef CPUSUPPORT_ARM_SHA512
+/**
+ * transform_ok(func):
+ * Return non-zero if ${func} compresses a test block into the initial SHA512
+ * state the same way SHA512_Transform_generic() does.  Code using hardware
+ * instructions is only trusted once it has passed this.
+ */
+static int
+transform_ok(void (* func)(uint64_t[8], const uint8_t[128]))
+{
+	uint64_t W[80], S[8];
+	uint64_t state[2][8];
+	uint8_t block[128];
+	int i;
+
+	/* Something which isn't too regular. */
+	for (i = 0; i < 128; i++)
+		block[i] = (uint8_t)(i * 37 + 11);
+
+	/* Compress it both ways and compare. */
+	memcpy(state[0], initial_state, 64);
+	memcpy(state[1], initial_state, 64);
+	SHA512_Transform_generic(state[0], block, W, S);
+	func(state[1], block);
+	return (memcmp(state[0], state[1], 64) == 0);
+}
+#endif
+
+/* The way of compressing one block picked by selecttransform(). */
+static int transform = TRANSFORM_GENERIC;
+static pthread_once_t transform_once = PTHREAD_ONCE_INIT;
+
+/**
+ * selecttransform(void):
+ * Pick the fastest way to compress one block which works on this CPU.
+ */
+static void
+selecttransform(void)
+{
+
+	/* Use SHA512 instructions if the CPU has them and they work. */
+#ifdef CPUSUPPORT_ARM_SHA512
+	if (cpusupport_arm_sha512() && transform_ok(SHA512_Transform_arm))
+		transform = TRANSFORM_ARM;
+#endif
+}
+
+/**
+ * transform_impl(void):
+ * Return the TRANSFORM_* value for the fastest way to compress one block on
+ * this CPU.
+ */
+static int
+transform_impl(void)
+{
+
+	/* Pick the implementation the first time through. */
+	if (pthread_once(&transform_once, selecttransform))
+		return (TRANSFORM_GENERIC);
+
+	return (transform);
+}
+
+/**
+ * SHA512_Transform(state, block, W, S):
+ * Compress the 128-byte ${block} into the SHA512 ${state}, in whichever way
+ * is fastest on this CPU.  ${W} and ${S} are scratch space for the portable
+ * code, which the caller should clean once it is done.
+ */
+static void
+SHA512_Transform(uint64_t state[8], const uint8_t block[128],
+    uint64_t W[80], uint64_t S[8])
+{
+
+	switch (transform_impl()) {
+#ifdef CPUSUPPORT_ARM_SHA512
+	case TRANSFORM_ARM:
+		SHA512_Transform_arm(state, block);
+		break;
+#endif
+	default:
+		SHA512_Transform_generic(state, block, W, S);
+		break;
+	}
+}
+
+static const uint8_t PAD[128] = { 0x80 };
+
+/* Add padding and terminating bit-count. */
+static void
+SHA512_Pad(SHA512_CTX * ctx, uint64_t tmp64[88])
+{
+	size_t r;
+
+	/* Figure out how many bytes we have buffered. */
+	r = (ctx->count[0] >> 3) & 0x7f;
+
+	/* Pad to 112 mod 128, transforming if we finish a block en route. */
+	if (r < 112) {
+		/* Pad to 112 mod 128. */
+		memcpy(&ctx->buf[r], PAD, 112 - r);
+	} else {
+		/* Finish the current block and mix. */
+		memcpy(&ctx->buf[r], PAD, 128 - r);
+		SHA512_Transform(ctx->state, ctx->buf, &tmp64[0], &tmp64[80]);
+
+		/* The start of the final block is all zeroes. */
+		memset(&ctx->buf[0], 0, 112);
+	}
+
+	/* Add the terminating bit-count. */
+	be64enc(&ctx->buf[112], ctx->count[1]);
+	be64enc(&ctx->buf[120], ctx->count[0]);
+
+	/* Mix in the final block. */
+	SHA512_Transform(ctx->state, ctx->buf, &tmp64[0], &tmp64[80]);
+}
+
+/**
+ * SHA512_Init(ctx):
+ * Initialize the SHA512 context ${ctx}.
+ */
+void
+SHA512_Init(SHA512_CTX * ctx)
+{
+
+	/* Zero bits processed so far. */
+	ctx->count[0] = ctx->count[1] = 0;
+
+	/* Initialize state. */
+	memcpy(ctx->state, initial_state, sizeof(initial_state));
+}
+
+/**
+ * SHA512_Update(ctx, in, len):
+ * Input ${len} bytes from ${in} into the SHA512 context ${ctx}.
+ */
+void
+SHA512_Update(SHA512_CTX * ctx, const void * in, size_t len)
+{
+	uint64_t tmp64[88];
+	uint64_t bitlen;
+	size_t r;
+	const uint8_t * src = in;
+
+	/* Return immediately if we have nothing to do. */
+	if (len == 0)
+		return;
+
+	/* Number of bytes left in the buffer from previous updates. */
+	r = (ctx->count[0] >> 3) & 0x7f;
+
+	/* Update number of bits. */
+	bitlen = (uint64_t)(len) << 3;
+	if ((ctx->count[0] += bitlen) < bitlen)
+		ctx->count[1]++;
+	ctx->count[1] += (uint64_t)(len) >> 61;
+
+	/* Handle the case where we don't need to perform any transforms. */
+	if (len < 128 - r) {
+		memcpy(&ctx->buf[r], src, len);
+		return;
+	}
+
+	/* Finish the current block. */
+	memcpy(&ctx->buf[r], src, 128 - r);
+	SHA512_Transform(ctx->state, ctx->buf, &tmp64[0], &tmp64[80]);
+	src += 128 - r;
+	len -= 128 - r;
+
+	/* Perform complete blocks. */
+	while (len >= 128) {
+		SHA512_Transform(ctx->state, src, &tmp64[0], &tmp64[80]);
+		src += 128;
+		len -= 128;
+	}
+
+	/* Copy left over data into buffer. */
+	memcpy(ctx->buf, src, len);
+
+	/* Clean the stack. */
+	memset(tmp64, 0, sizeof(tmp64));
+}
+
+/**
+ * SHA512_Final(digest, ctx):
+ * Output the SHA512 hash of the data input to the context ${ctx} into the
+ * buffer ${digest}, and clear the context state.
+ */
+void
+SHA512_Final(unsigned char digest[64], SHA512_CTX * ctx)
+{
+	uint64_t tmp64[88];
+
+	/* Add padding. */
+	SHA512_Pad(ctx, tmp64);
+
+	/* Write the hash. */
+	be64enc_vect(digest, ctx->state, 64);
+
+	/* Clear the context state, and the stack. */
+	memset(ctx, 0, sizeof(SHA512_CTX));
+	memset(tmp64, 0, sizeof(tmp64));
+}
+
+/* Initialize an HMAC-SHA512 operation with the given key. */
+void
+HMAC_SHA512_Init(HMAC_SHA512_CTX * ctx, const void * _K, size_t Klen)
+{
+	unsigned char pad[128];
+	unsigned char khash[64];
+	const unsigned char * K = _K;
+	size_t i;
+
+	/* If Klen > 128, the key is really SHA512(K). */
+	if (Klen > 128) {
+		SHA512_Init(&ctx->ictx);
+		SHA512_Update(&ctx->ictx, K, Klen);
+		SHA512_Final(khash, &ctx->ictx);
+		K = khash;
+		Klen = 64;
+	}
+
+	/* Inner SHA512 operation is SHA512(K xor [block of 0x36] || data). */
+	SHA512_Init(&ctx->ictx);
+	memset(pad, 0x36, 128);
+	for (i = 0; i < Klen; i++)
+		pad[i] ^= K[i];
+	SHA512_Update(&ctx->ictx, pad, 128);
+
+	/* Outer SHA512 operation is SHA512(K xor [block of 0x5c] || hash). */
+	SHA512_Init(&ctx->octx);
+	memset(pad, 0x5c, 128);
+	for (i = 0; i < Klen; i++)
+		pad[i] ^= K[i];
+	SHA512_Update(&ctx->octx, pad, 128);
+
+	/* Clean the stack. */
+	memset(khash, 0, 64);
+	memset(pad, 0, 128);
+}
+
+/* Add bytes to the HMAC-SHA512 operation. */
+void
+HMAC_SHA512_Update(HMAC_SHA512_CTX * ctx, const void * in, size_t len)
+{
+
+	/* Feed data to the inner SHA512 operation. */
+	SHA512_Update(&ctx->ictx, in, len);
+}
+
+/* Finish an HMAC-SHA512 operation. */
+void
+HMAC_SHA512_Final(unsigned char digest[64], HMAC_SHA512_CTX * ctx)
+{
+	unsigned char ihash[64];
+
+	/* Finish the inner SHA512 operation. */
+	SHA512_Final(ihash, &ctx->ictx);
+
+	/* Feed the inner hash to the outer SHA512 operation. */
+	SHA512_Update(&ctx->octx, ihash, 64);
+
+	/* Finish the outer SHA512 operation. */
+	SHA512_Final(digest, &ctx->octx);
+
+	/* Clean the stack. */
+	memset(ihash, 0, 64);
+}
+
+/* The way of compressing LANES blocks at once picked by selectlanes(). */
+static int lanes = LANES_SCALAR;
+static pthread_once_t lanes_once = PTHREAD_ONCE_INIT;
+
+/**
+ * selectlanes(void):
+ * Pick the fastest way to compress LANES blocks at once on this CPU.
+ */
+static void
+selectlanes(void)
+{
+
+	/* Use SIMD code if we can... */
+	if (cpusupport_x86_avx2())
+		lanes = LANES_AVX2;
+
+	/* ... unless the CPU has SHA512 instructions, which beat it. */
+	if (transform_impl() != TRANSFORM_GENERIC)
+		lanes = LANES_SCALAR;
+}
+
+/**
+ * lanes_impl(void):
+ * Return the LANES_* value for the fastest way to compress LANES blocks at
+ * once on this CPU.
+ */
+static int
+lanes_impl(void)
+{
+
+	/* Pick the implementation the first time through. */
+	if (pthread_once(&lanes_once, selectlanes))
+		return (LANES_SCALAR);
+
+	return (lanes);
+}
+
+/**
+ * lanes_compress(S, blocks, n):
+ * For each l < ${n}, compress the 128-byte block blocks[l] into the SHA512
+ * state held in column l of ${S}.
+ */
+static void
+lanes_compress(uint64_t S[8][LANES], const uint8_t * const * blocks,
+    size_t n)
+{
+	const uint8_t * b[LANES];
+	uint64_t state[8];
+	uint64_t tmp64[88];
+	size_t l;
+	int w;
+
+	/* SIMD code always does whole vectors: give unused lanes a block. */
+	for (l = 0; l < LANES; l++)
+		b[l] = blocks[(l < n) ? l : 0];
+
+	/* A single block is faster on its own than in a vector of junk. */
+	switch ((n > 1) ? lanes_impl() : LANES_SCALAR) {
+#ifdef CPUSUPPORT_X86_AVX2
+	case LANES_AVX2:
+		SHA512_Compress4_avx2(&S[0][0], LANES, b);
+		break;
+#endif
+	default:
+		for (l = 0; l < n; l++) {
+			for (w = 0; w < 8; w++)
+				state[w] = S[w][l];
+			SHA512_Transform(state, b[l], &tmp64[0], &tmp64[80]);
+			for (w = 0; w < 8; w++)
+				S[w][l] = state[w];
+		}
+		memset(state, 0, 64);
+		memset(tmp64, 0, sizeof(tmp64));
+		break;
+	}
+}
+
+/**
+ * lanes_set(S, state):
+ * Set every column of ${S} to ${state}.
+ */
+static void
+lanes_set(uint64_t S[8][LANES], const uint64_t state[8])
+{
+	size_t l;
+	int w;
+
+	for (w = 0; w < 8; w++) {
+		for (l = 0; l < LANES; l++)
+			S[w][l] = state[w];
+	}
+}
+
+/**
+ * lanes_next(S, state, blk, n):
+ * For each l < ${n}, replace the hash in column l of ${S} with the hash of
+ * it under ${state}: it is written into the first 64 bytes of blk[l], whose
+ * last 64 bytes must already hold the padding, and compressed.
+ */
+static void
+lanes_next(uint64_t S[8][LANES], const uint64_t state[8],
+    uint8_t blk[LANES][128], size_t n)
+{
+	const uint8_t * blocks[LANES];
+	size_t l;
+	int w;
+
+	for (l = 0; l < n; l++) {
+		for (w = 0; w < 8; w++)
+			be64enc(&blk[l][w * 8], S[w][l]);
+		blocks[l] = blk[l];
+	}
+	lanes_set(S, state);
+	lanes_compress(S, blocks, n);
+}
+
+/**
+ * pad192(blk):
+ * Fill in the last 64 bytes of each of the LANES blocks ${blk} with the
+ * SHA512 padding for a 192-byte message: one block of HMAC key, then the
+ * 64-byte hash in the first half of the block.
+ */
+static void
+pad192(uint8_t blk[LANES][128])
+{
+	size_t l;
+
+	for (l = 0; l < LANES; l++) {
+		memset(&blk[l][64], 0, 64);
+		blk[l][64] = 0x80;
+		be64enc(&blk[l][120], 1536);
+	}
+}
+
+/**
+ * PBKDF2_SHA512(passwd, passwdlen, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) using HMAC-SHA512 as the PRF, and
+ * write the output to buf.  The value dkLen must be at most 64 * (2^32 - 1).
+ */
+void
+PBKDF2_SHA512(const uint8_t * passwd, size_t passwdlen, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
+{
+	HMAC_SHA512_CTX Pctx;
+
+	/* Key HMAC with the password, then do the work. */
+	HMAC_SHA512_Init(&Pctx, passwd, passwdlen);
+	PBKDF2_SHA512_Keyed(&Pctx, salt, saltlen, c, buf, dkLen);
+
+	/* Clean Pctx, since we never called _Final on it. */
+	memset(&Pctx, 0, sizeof(HMAC_SHA512_CTX));
+}
+
+/**
+ * PBKDF2_SHA512_Keyed(Pctx, salt, saltlen, c, buf, dkLen):
+ * Compute PBKDF2(passwd, salt, c, dkLen) as PBKDF2_SHA512() does, where
+ * ${Pctx} is the result of HMAC_SHA512_Init(Pctx, passwd, passwdlen) with no
+ * data added yet.  ${Pctx} is not modified.
+ */
+void
+PBKDF2_SHA512_Keyed(const HMAC_SHA512_CTX * Pctx, const uint8_t * salt,
+    size_t saltlen, uint64_t c, uint8_t * buf, size_t dkLen)
+{
+	uint64_t istate[8], ostate[8], sstate[8];
+	uint64_t S[8][LANES], T[8][LANES];
+	uint8_t ublk[LANES][256];
+	uint8_t iblk[LANES][128], oblk[LANES][128];
+	const uint8_t * blocks[LANES];
+	uint8_t U[64];
+	uint64_t tmp64[88];
+	size_t tail, ulen;
+	size_t i, l, n;
+	size_t clen;
+	uint64_t j;
+	int w;
+
+	/* Keyed states, after the ipad and opad blocks. */
+	for (w = 0; w < 8; w++) {
+		istate[w] = Pctx->ictx.state[w];
+		ostate[w] = Pctx->octx.state[w];
+	}
+
+	/* Every U_1 starts with the salt; hash its whole blocks once. */
+	memcpy(sstate, istate, 64);
+	for (tail = saltlen; tail >= 128; tail -= 128)
+		SHA512_Transform(sstate, &salt[saltlen - tail],
+		    &tmp64[0], &tmp64[80]);
+
+	/*
+	 * What is left of S || INT(i), with its padding, takes one block, or
+	 * two if the padding doesn't fit; only INT(i) differs between blocks.
+	 */
+	ulen = (tail + 4 + 17 > 128) ? 256 : 128;
+	for (l = 0; l < LANES; l++) {
+		memset(ublk[l], 0, ulen);
+		if (tail > 0)
+			memcpy(ublk[l], &salt[saltlen - tail], tail);
+		ublk[l][tail + 4] = 0x80;
+		be64enc(&ublk[l][ulen - 8], ((uint64_t)saltlen + 132) * 8);
+	}
+
+	/*
+	 * U_j = PRF(P, U_{j-1}) for j >= 2 is always the SHA512 compression
+	 * of one block after the ipad block, then of one block after the opad
+	 * block, and each of those blocks is a 64-byte hash followed by the
+	 * same padding; so is the block in the outer hash of U_1.
+	 */
+	pad192(iblk);
+	pad192(oblk);
+
+	/* Iterate through the blocks, up to LANES at a time. */
+	for (i = 0; i * 64 < dkLen; i += n) {
+		n = (dkLen - i * 64 + 63) / 64;
+		if (n > LANES)
+			n = LANES;
+
+		/* Compute U_1 = PRF(P, S || INT(i)). */
+		for (l = 0; l < n; l++) {
+			be32enc(&ublk[l][tail], (uint32_t)(i + l + 1));
+			blocks[l] = ublk[l];
+		}
+		lanes_set(S, sstate);
+		lanes_compress(S, blocks, n);
+		if (ulen == 256) {
+			for (l = 0; l < n; l++)
+				blocks[l] = &ublk[l][128];
+			lanes_compress(S, blocks, n);
+		}
+		lanes_next(S, ostate, oblk, n);
+
+		/* T_i = U_1 ... */
+		memcpy(T, S, sizeof(T));
+
+		for (j = 2; j <= c; j++) {
+			/* Compute U_j. */
+			lanes_next(S, istate, iblk, n);
+			lanes_next(S, ostate, oblk, n);
+
+			/* ... xor U_j ... */
+			for (w = 0; w < 8; w++) {
+				for (l = 0; l < n; l++)
+					T[w][l] ^= S[w][l];
+			}
+		}
+
+		/* Copy as many bytes as necessary into buf. */
+		for (l = 0; l < n; l++) {
+			for (w = 0; w < 8; w++)
+				be64enc(&U[w * 8], T[w][l]);
+			clen = dkLen - (i + l) * 64;
+			if (clen > 64)
+				clen = 64;
+			memcpy(&buf[(i + l) * 64], U, clen);
+		}
+	}
+
+	/* Clean the stack. */
+	memset(istate, 0, 64);
+	memset(ostate, 0, 64);
+	memset(sstate, 0, 64);
+	memset(S, 0, sizeof(S));
+	memset(T, 0, sizeof(T));
+	memset(ublk, 0, sizeof(ublk));
+	memset(iblk, 0, sizeof(iblk));
+	memset(oblk, 0, sizeof(oblk));
+	memset(U, 0, 64);
+	memset(tmp64, 0, sizeof(tmp64));
+}
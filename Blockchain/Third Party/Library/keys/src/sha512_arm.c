@@ -0,0 +1,166 @@
+#include "scrypt_platform.h"
+
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_ARM_SHA512
+#include <arm_neon.h>
+
+#include "sha512_arm.h"
+
+/*
+ * This code is only built when the compiler already targets CPUs with the
+ * ARMv8.2 SHA512 instructions (see config.h); even so, the function is only
+ * called once cpusupport_arm_sha512() agrees that this CPU has them.
+ */
+
+/* SHA512 round constants. */
+static const uint64_t Krnd[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/*
+ * Two rounds, with message words W[2t], W[2t + 1] in ${msg}.  The state is
+ * held in pairs AB, CD, EF, GH: SHA512H gives the new EF less the old CD,
+ * and SHA512H2 turns that into the new AB, while the old AB and EF become
+ * CD and GH.
+ */
+#define RND2(msg, t) do {						\
+	T0 = vaddq_u64(msg, vld1q_u64(&Krnd[(t) * 2]));			\
+	T0 = vaddq_u64(vextq_u64(T0, T0, 1), GH);			\
+	T0 = vsha512hq_u64(T0, vextq_u64(EF, GH, 1),			\
+	    vextq_u64(CD, EF, 1));					\
+	T1 = vaddq_u64(CD, T0);						\
+	GH = EF;							\
+	EF = T1;							\
+	T1 = vsha512h2q_u64(T0, CD, AB);				\
+	CD = AB;							\
+	AB = T1;							\
+} while (0)
+
+/*
+ * Turn W[2i], W[2i + 1] in ${w0} into W[2i + 16], W[2i + 17], given the
+ * pairs following it in ${w1}, ${w4}, ${w5} and ${w7}.
+ */
+#define MSCH2(w0, w1, w4, w5, w7)					\
+	w0 = vsha512su1q_u64(vsha512su0q_u64(w0, w1), w7,		\
+	    vextq_u64(w4, w5, 1))
+
+/**
+ * SHA512_Transform_arm(state, block):
+ * Compress the 128-byte ${block} into the SHA512 ${state}, using the ARMv8.2
+ * SHA512 instructions.
+ */
+void
+SHA512_Transform_arm(uint64_t state[8], const uint8_t block[128])
+{
+	uint64x2_t AB, CD, EF, GH, AB_orig, CD_orig, EF_orig, GH_orig;
+	uint64x2_t W0, W1, W2, W3, W4, W5, W6, W7;
+	uint64x2_t T0, T1;
+
+	/* Load the state. */
+	AB = AB_orig = vld1q_u64(&state[0]);
+	CD = CD_orig = vld1q_u64(&state[2]);
+	EF = EF_orig = vld1q_u64(&state[4]);
+	GH = GH_orig = vld1q_u64(&state[6]);
+
+	/* Load the message, which is big-endian. */
+	W0 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[0])));
+	W1 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[16])));
+	W2 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[32])));
+	W3 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[48])));
+	W4 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[64])));
+	W5 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[80])));
+	W6 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[96])));
+	W7 = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(&block[112])));
+
+	/* 80 rounds, expanding the message two words at a time. */
+	RND2(W0, 0);	MSCH2(W0, W1, W4, W5, W7);
+	RND2(W1, 1);	MSCH2(W1, W2, W5, W6, W0);
+	RND2(W2, 2);	MSCH2(W2, W3, W6, W7, W1);
+	RND2(W3, 3);	MSCH2(W3, W4, W7, W0, W2);
+	RND2(W4, 4);	MSCH2(W4, W5, W0, W1, W3);
+	RND2(W5, 5);	MSCH2(W5, W6, W1, W2, W4);
+	RND2(W6, 6);	MSCH2(W6, W7, W2, W3, W5);
+	RND2(W7, 7);	MSCH2(W7, W0, W3, W4, W6);
+	RND2(W0, 8);	MSCH2(W0, W1, W4, W5, W7);
+	RND2(W1, 9);	MSCH2(W1, W2, W5, W6, W0);
+	RND2(W2, 10);	MSCH2(W2, W3, W6, W7, W1);
+	RND2(W3, 11);	MSCH2(W3, W4, W7, W0, W2);
+	RND2(W4, 12);	MSCH2(W4, W5, W0, W1, W3);
+	RND2(W5, 13);	MSCH2(W5, W6, W1, W2, W4);
+	RND2(W6, 14);	MSCH2(W6, W7, W2, W3, W5);
+	RND2(W7, 15);	MSCH2(W7, W0, W3, W4, W6);
+	RND2(W0, 16);	MSCH2(W0, W1, W4, W5, W7);
+	RND2(W1, 17);	MSCH2(W1, W2, W5, W6, W0);
+	RND2(W2, 18);	MSCH2(W2, W3, W6, W7, W1);
+	RND2(W3, 19);	MSCH2(W3, W4, W7, W0, W2);
+	RND2(W4, 20);	MSCH2(W4, W5, W0, W1, W3);
+	RND2(W5, 21);	MSCH2(W5, W6, W1, W2, W4);
+	RND2(W6, 22);	MSCH2(W6, W7, W2, W3, W5);
+	RND2(W7, 23);	MSCH2(W7, W0, W3, W4, W6);
+	RND2(W0, 24);	MSCH2(W0, W1, W4, W5, W7);
+	RND2(W1, 25);	MSCH2(W1, W2, W5, W6, W0);
+	RND2(W2, 26);	MSCH2(W2, W3, W6, W7, W1);
+	RND2(W3, 27);	MSCH2(W3, W4, W7, W0, W2);
+	RND2(W4, 28);	MSCH2(W4, W5, W0, W1, W3);
+	RND2(W5, 29);	MSCH2(W5, W6, W1, W2, W4);
+	RND2(W6, 30);	MSCH2(W6, W7, W2, W3, W5);
+	RND2(W7, 31);	MSCH2(W7, W0, W3, W4, W6);
+	RND2(W0, 32);
+	RND2(W1, 33);
+	RND2(W2, 34);
+	RND2(W3, 35);
+	RND2(W4, 36);
+	RND2(W5, 37);
+	RND2(W6, 38);
+	RND2(W7, 39);
+
+	/* Add the old state and store the new one. */
+	vst1q_u64(&state[0], vaddq_u64(AB, AB_orig));
+	vst1q_u64(&state[2], vaddq_u64(CD, CD_orig));
+	vst1q_u64(&state[4], vaddq_u64(EF, EF_orig));
+	vst1q_u64(&state[6], vaddq_u64(GH, GH_orig));
+}
+
+#endif /* CPUSUPPORT_ARM_SHA512 */
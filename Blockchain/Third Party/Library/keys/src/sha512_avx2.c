@@ -0,0 +1,133 @@
+#include "scrypt_platform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpusupport.h"
+
+#ifdef CPUSUPPORT_X86_AVX2
+#include <immintrin.h>
+
+#include "sysendian.h"
+
+#include "sha512_avx2.h"
+
+/*
+ * This file is compiled for whatever the rest of the build targets, so the
+ * function which uses AVX2 is marked with a target attribute and must only
+ * be called once cpusupport_x86_avx2() says the CPU can run it.
+ */
+
+/* SHA512 round constants. */
+static const uint64_t Krnd[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/* Operations on 4 lanes at once, and the functions SHA512 is built from. */
+#define ADD(x, y)	_mm256_add_epi64(x, y)
+#define AND(x, y)	_mm256_and_si256(x, y)
+#define OR(x, y)	_mm256_or_si256(x, y)
+#define XOR(x, y)	_mm256_xor_si256(x, y)
+#define SHR(x, n)	_mm256_srli_epi64(x, n)
+#define ROTR(x, n)	OR(SHR(x, n), _mm256_slli_epi64(x, 64 - (n)))
+#define Ch(x, y, z)	XOR(AND(x, XOR(y, z)), z)
+#define Maj(x, y, z)	OR(AND(x, y), AND(z, OR(x, y)))
+#define S0(x)		XOR(XOR(ROTR(x, 28), ROTR(x, 34)), ROTR(x, 39))
+#define S1(x)		XOR(XOR(ROTR(x, 14), ROTR(x, 18)), ROTR(x, 41))
+#define s0(x)		XOR(XOR(ROTR(x, 1), ROTR(x, 8)), SHR(x, 7))
+#define s1(x)		XOR(XOR(ROTR(x, 19), ROTR(x, 61)), SHR(x, 6))
+
+/**
+ * SHA512_Compress4_avx2(S, stride, blocks):
+ * Compress the 128-byte blocks blocks[0 .. 3] into 4 SHA512 states which
+ * are interleaved in ${S}: word w of the state for blocks[l] is at
+ * S[w * stride + l].
+ */
+__attribute__((target("avx2")))
+void
+SHA512_Compress4_avx2(uint64_t * S, size_t stride,
+    const uint8_t * const * blocks)
+{
+	__m256i W[80];
+	__m256i H[8];
+	__m256i a, b, c, d, e, f, g, h;
+	__m256i T1, T2;
+	int t;
+
+	/* Load the message, one word from each block per vector. */
+	for (t = 0; t < 16; t++)
+		W[t] = _mm256_set_epi64x(
+		    (long long)be64dec(&blocks[3][t * 8]),
+		    (long long)be64dec(&blocks[2][t * 8]),
+		    (long long)be64dec(&blocks[1][t * 8]),
+		    (long long)be64dec(&blocks[0][t * 8]));
+
+	/* Expand it. */
+	for (t = 16; t < 80; t++)
+		W[t] = ADD(ADD(s1(W[t - 2]), W[t - 7]),
+		    ADD(s0(W[t - 15]), W[t - 16]));
+
+	/* Load the states. */
+	for (t = 0; t < 8; t++)
+		H[t] = _mm256_loadu_si256((__m256i *)&S[t * stride]);
+	a = H[0]; b = H[1]; c = H[2]; d = H[3];
+	e = H[4]; f = H[5]; g = H[6]; h = H[7];
+
+	/* 80 rounds. */
+	for (t = 0; t < 80; t++) {
+		T1 = ADD(ADD(h, S1(e)), ADD(Ch(e, f, g),
+		    ADD(_mm256_set1_epi64x((long long)Krnd[t]), W[t])));
+		T2 = ADD(S0(a), Maj(a, b, c));
+		h = g; g = f; f = e; e = ADD(d, T1);
+		d = c; c = b; b = a; a = ADD(T1, T2);
+	}
+
+	/* Add the old states and store the new ones. */
+	H[0] = ADD(H[0], a); H[1] = ADD(H[1], b);
+	H[2] = ADD(H[2], c); H[3] = ADD(H[3], d);
+	H[4] = ADD(H[4], e); H[5] = ADD(H[5], f);
+	H[6] = ADD(H[6], g); H[7] = ADD(H[7], h);
+	for (t = 0; t < 8; t++)
+		_mm256_storeu_si256((__m256i *)&S[t * stride], H[t]);
+}
+
+#endif /* CPUSUPPORT_X86_AVX2 */
@@ -48,7 +48,7 @@ final class SecondPasswordPrompter: SecondPasswordPromptable {
     }
 
     private func promptForSecondPassword(type: PasswordScreenType) -> AnyPublisher<String, SecondPasswordError> {
-        Deferred { [secondPasswordPrompterHelper, secondPasswordStore] in
+        Deferred { [secondPasswordPrompterHelper, secondPasswordStore, walletManager] in
             Future { promise in
                 secondPasswordPrompterHelper
                     .showPasswordScreen(
@@ -58,6 +58,8 @@ final class SecondPasswordPrompter: SecondPasswordPromptable {
                             promise(.success(secondPassword))
                         },
                         dismissHandler: {
+                            // Don't leave a key derivation for the abandoned unlock running
+                            walletManager.wallet.cancelScrypt()
                             promise(.failure(.userDismissed))
                         }
                     )
@@ -0,0 +1,54 @@
+// Copyright © Blockchain Luxembourg S.A. All rights reserved.
+
+import JavaScriptCore
+import XCTest
+
+@testable import Blockchain
+
+class KeyDerivationBridgeTests: XCTestCase {
+
+    private var wallet: Wallet!
+    private var context: JSContext!
+
+    override func setUp() {
+        super.setUp()
+        wallet = Wallet()
+        context = wallet.loadContextIfNeeded()
+    }
+
+    override func tearDown() {
+        wallet = nil
+        context = nil
+        super.tearDown()
+    }
+
+    /// Evaluates `script` and returns the hex encoding of the Uint8Array it produces
+    private func hex(_ script: String) -> String? {
+        let value = context.evaluateScript(
+            "Array.prototype.map.call(\(script), function (b) { return ('0' + b.toString(16)).slice(-2); }).join('')"
+        )
+        return value?.toString()
+    }
+
+    /// Builds `text` as a view which starts part way into its buffer, as small Buffers do
+    private func subarray(_ text: String) -> String {
+        "new Uint8Array(Array.prototype.map.call('xx\(text)', function (c) { return c.charCodeAt(0); })).subarray(2)"
+    }
+
+    /// RFC 6070 PBKDF2-HMAC-SHA1 vector, with the inputs passed as subarrays
+    func testSJCLPBKDF2ReadsSubarrays() {
+        XCTAssertEqual(
+            hex("objc_sjcl_misc_pbkdf2(\(subarray("password")), \(subarray("salt")), 1, 20)"),
+            "0c60c80f961f0e71f3a9b524af6012062fe037a6"
+        )
+    }
+
+    /// PBKDF2-HMAC-SHA512 vector, with the inputs passed as subarrays
+    func testPBKDF2SyncReadsSubarrays() {
+        XCTAssertEqual(
+            hex("objc_pbkdf2_sync(\(subarray("password")), \(subarray("salt")), 1, 64)"),
+            "867f70cf1ade02cff3752599a3a53dc4af34c7a669815ae5d513554e1c8cf252"
+                + "c02d470a285a0501bad999bfe943c08f050235d7d68b1da55e63f73b60a57fce"
+        )
+    }
+}